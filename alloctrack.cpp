@@ -0,0 +1,231 @@
+#include "alloctrack.h"
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <new>
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#define ALLOCTRACK_BACKTRACE 1
+#endif
+
+const int SITE_DEPTH = 6;
+const int MAX_SITES = 256;
+
+struct AllocationSite {
+    void* frames[SITE_DEPTH];
+    int depth;
+    unsigned long long count;
+    unsigned long long bytes;
+};
+
+// Plain counters: each thread only ever touches its own
+static thread_local unsigned long long allocationCount = 0;
+static thread_local unsigned long long allocatedBytes = 0;
+static thread_local bool attributing = false;     // inside a steady-state period
+static thread_local bool walkingStack = false;
+
+static bool attributionEnabled = false;
+static std::mutex siteMutex;
+static AllocationSite sites[MAX_SITES];
+static int siteCount = 0;
+static unsigned long long unrecordedSites = 0;   // allocations after the table filled
+
+#ifdef ALLOCTRACK_BACKTRACE
+// Not inlined, so the first two frames are always this function and
+// operator new itself
+__attribute__((noinline)) static void recordSite(size_t size) {
+    walkingStack = true;
+    void* frames[SITE_DEPTH + 2];
+    int depth = backtrace(frames, SITE_DEPTH + 2) - 2;
+    walkingStack = false;
+    if (depth <= 0) return;
+
+    std::lock_guard<std::mutex> lock(siteMutex);
+    for (int i = 0; i < siteCount; i++) {
+        AllocationSite& site = sites[i];
+        if (site.depth != depth) continue;
+        int f = 0;
+        while (f < depth && site.frames[f] == frames[f + 2]) f++;
+        if (f == depth) {
+            site.count++;
+            site.bytes += size;
+            return;
+        }
+    }
+    if (siteCount == MAX_SITES) {
+        unrecordedSites++;
+        return;
+    }
+    AllocationSite& site = sites[siteCount++];
+    for (int f = 0; f < depth; f++) site.frames[f] = frames[f + 2];
+    site.depth = depth;
+    site.count = 1;
+    site.bytes = size;
+}
+#endif
+
+static void* allocate(size_t size) {
+    allocationCount++;
+    allocatedBytes += size;
+#ifdef ALLOCTRACK_BACKTRACE
+    if (attributing && !walkingStack) recordSite(size);
+#endif
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) {
+    void* p = allocate(size);
+    while (!p) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+        p = malloc(size ? size : 1);
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    free(p);
+}
+
+unsigned long long threadAllocations() {
+    return allocationCount;
+}
+
+unsigned long long threadAllocatedBytes() {
+    return allocatedBytes;
+}
+
+void beginAllocationPeriod(AllocationPeriod& period) {
+    period.startCount = allocationCount;
+    period.startBytes = allocatedBytes;
+    period.sharedCount = period.sharedBytes = 0;
+    attributing = attributionEnabled && period.periods >= period.warmup;
+}
+
+unsigned long long endAllocationPeriod(AllocationPeriod& period) {
+    attributing = false;
+    unsigned long long count = allocationCount - period.startCount + period.sharedCount;
+    if (period.periods >= period.warmup) period.steadyPeriods++;
+    if (period.periods >= period.warmup && count > 0) {
+        if (period.steadyAllocating == 0) period.firstAllocating = period.periods;
+        period.steadyAllocating++;
+        period.allocations += count;
+        period.bytes += allocatedBytes - period.startBytes + period.sharedBytes;
+        if (count > period.worst) period.worst = count;
+    }
+    period.periods++;
+    return count;
+}
+
+void beginAllocationShare(AllocationShare& share, const AllocationPeriod& period) {
+    share.startCount = allocationCount;
+    share.startBytes = allocatedBytes;
+    attributing = attributionEnabled && period.periods >= period.warmup;
+}
+
+void endAllocationShare(AllocationShare& share) {
+    attributing = false;
+    share.count = allocationCount - share.startCount;
+    share.bytes = allocatedBytes - share.startBytes;
+}
+
+void addAllocationShare(AllocationPeriod& period, const AllocationShare& share) {
+    period.sharedCount += share.count;
+    period.sharedBytes += share.bytes;
+}
+
+void allowAllocations(AllocationPeriod& period, unsigned periods) {
+    unsigned until = period.periods + periods + 1;
+    if (until > period.warmup) period.warmup = until;
+}
+
+bool setAllocationAttribution(bool enabled) {
+#ifdef ALLOCTRACK_BACKTRACE
+    if (enabled) {
+        // The first backtrace() loads the unwinder; do it outside any period
+        void* frames[1];
+        backtrace(frames, 1);
+    }
+    attributionEnabled = enabled;
+    return true;
+#else
+    attributionEnabled = false;
+    return !enabled;
+#endif
+}
+
+void reportAllocationPeriod(const AllocationPeriod& period) {
+    if (period.periods == 0) return;
+    if (period.steadyPeriods == 0) {
+        std::cerr << "allocations per " << period.name << ": still warming up after " << period.periods << std::endl;
+        return;
+    }
+    std::cerr << "allocations per " << period.name << ": " << period.steadyAllocating << " of " << period.steadyPeriods
+              << " steady-state " << period.name << "s allocated";
+    if (period.steadyAllocating > 0) {
+        std::cerr << " (first was #" << period.firstAllocating << ", " << period.allocations << " allocations, "
+                  << period.bytes << " bytes, at most " << period.worst << " in one)";
+    }
+    std::cerr << std::endl;
+}
+
+void reportAllocationSites(int maxSites) {
+    std::lock_guard<std::mutex> lock(siteMutex);
+    if (siteCount == 0) return;
+
+    // Most frequent first; the table is small, so selection sort will do
+    for (int i = 0; i < siteCount && i < maxSites; i++) {
+        int best = i;
+        for (int j = i + 1; j < siteCount; j++) {
+            if (sites[j].count > sites[best].count) best = j;
+        }
+        AllocationSite top = sites[best];
+        sites[best] = sites[i];
+        sites[i] = top;
+    }
+
+    std::cerr << "steady-state allocation sites:" << std::endl;
+    for (int i = 0; i < siteCount && i < maxSites; i++) {
+        std::cerr << "  " << sites[i].count << " allocations, " << sites[i].bytes << " bytes from:" << std::endl;
+#ifdef ALLOCTRACK_BACKTRACE
+        backtrace_symbols_fd(sites[i].frames, sites[i].depth, 2);
+#endif
+    }
+    if (unrecordedSites > 0) {
+        std::cerr << "  " << unrecordedSites << " more allocations from sites past the first " << MAX_SITES << std::endl;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef ALLOCTRACK_H
+#define ALLOCTRACK_H
+
+// Heap allocation tracking. alloctrack.cpp replaces the global operator
+// new and delete, so every C++ heap allocation in the program is counted
+// per thread. Periods (a frame, a tick) are measured on the thread that
+// runs them, plus whatever helper threads report as shares of them; once a
+// period is past its warm-up, any allocation in it is a steady-state
+// allocation. With attribution on, the call stacks of those
+// allocations are collected and printed with the report.
+
+struct AllocationPeriod {
+    const char* name;
+    unsigned warmup;                  // periods before this one may still allocate
+    unsigned periods;
+    unsigned steadyPeriods;
+    unsigned steadyAllocating;        // steady-state periods that allocated
+    unsigned firstAllocating;         // index of the first of them
+    unsigned long long allocations;   // in steady-state periods
+    unsigned long long bytes;
+    unsigned long long worst;         // most allocations in one period
+    unsigned long long startCount;
+    unsigned long long startBytes;
+    unsigned long long sharedCount;   // added by helper threads during the open period
+    unsigned long long sharedBytes;
+
+    AllocationPeriod(const char* name, unsigned warmup)
+        : name(name), warmup(warmup), periods(0), steadyPeriods(0), steadyAllocating(0), firstAllocating(0),
+          allocations(0), bytes(0), worst(0), startCount(0), startBytes(0), sharedCount(0), sharedBytes(0) {}
+};
+
+// A helper thread's part of a period opened on another thread
+struct AllocationShare {
+    unsigned long long startCount;
+    unsigned long long startBytes;
+    unsigned long long count;
+    unsigned long long bytes;
+
+    AllocationShare() : startCount(0), startBytes(0), count(0), bytes(0) {}
+};
+
+// Allocations and bytes requested by the calling thread so far
+unsigned long long threadAllocations();
+unsigned long long threadAllocatedBytes();
+
+void beginAllocationPeriod(AllocationPeriod& period);
+// Returns the number of allocations made during the period
+unsigned long long endAllocationPeriod(AllocationPeriod& period);
+
+// Count what the calling helper thread allocates towards an open period.
+// begin and end run on the helper around its job; once the period's own
+// thread has waited for the job, it adds the share before ending the
+// period.
+void beginAllocationShare(AllocationShare& share, const AllocationPeriod& period);
+void endAllocationShare(AllocationShare& share);
+void addAllocationShare(AllocationPeriod& period, const AllocationShare& share);
+
+// Let the current and the next `periods` periods allocate, after a change
+// that refills caches (a quality step, a backend switch)
+void allowAllocations(AllocationPeriod& period, unsigned periods);
+
+// Collect call stacks of steady-state allocations. Only available where
+// the C library can walk the stack (glibc); elsewhere it stays off.
+bool setAllocationAttribution(bool enabled);
+
+// One line per period to stderr, then the most frequent call sites
+void reportAllocationPeriod(const AllocationPeriod& period);
+void reportAllocationSites(int maxSites);
+
+#endif
@@ -0,0 +1,73 @@
+#include "arena.h"
+#include <cstdlib>
+#include <cstdint>
+
+static unsigned char* chunkData(ArenaChunk* chunk) {
+    return reinterpret_cast<unsigned char*>(chunk) + sizeof(ArenaChunk);
+}
+
+static ArenaChunk* newChunk(Arena& arena, size_t capacity) {
+    ArenaChunk* chunk = static_cast<ArenaChunk*>(malloc(sizeof(ArenaChunk) + capacity));
+    if (!chunk) abort();
+    chunk->next = 0;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    arena.heapChunks++;
+    return chunk;
+}
+
+void arenaInit(Arena& arena, const char* name, size_t chunkSize) {
+    arenaRelease(arena);
+    arena.name = name;
+    arena.chunkSize = chunkSize;
+    arena.first = arena.current = newChunk(arena, chunkSize);
+}
+
+void* arenaAlloc(Arena& arena, size_t bytes, size_t align) {
+    if (!arena.current) arena.first = arena.current = newChunk(arena, arena.chunkSize);
+
+    for (;;) {
+        ArenaChunk* chunk = arena.current;
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunkData(chunk));
+        size_t offset = ((base + chunk->used + align - 1) & ~(uintptr_t)(align - 1)) - base;
+        if (offset + bytes <= chunk->capacity) {
+            arena.used += offset + bytes - chunk->used;
+            chunk->used = offset + bytes;
+            if (arena.used > arena.highWater) arena.highWater = arena.used;
+            arena.allocations++;
+            return chunkData(chunk) + offset;
+        }
+
+        // Move on to the next kept chunk, or take a new one big enough
+        if (!chunk->next || chunk->next->capacity < bytes + align) {
+            size_t capacity = bytes + align > arena.chunkSize ? bytes + align : arena.chunkSize;
+            ArenaChunk* fresh = newChunk(arena, capacity);
+            fresh->next = chunk->next;
+            chunk->next = fresh;
+        }
+        arena.current = chunk->next;
+        arena.current->used = 0;
+    }
+}
+
+// Later chunks are marked empty as allocation reaches them, which keeps
+// the reset itself constant time
+void arenaReset(Arena& arena) {
+    arena.current = arena.first;
+    if (arena.first) arena.first->used = 0;
+    arena.used = 0;
+    arena.allocations = 0;
+    arena.resets++;
+}
+
+void arenaRelease(Arena& arena) {
+    ArenaChunk* chunk = arena.first;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena.first = arena.current = 0;
+    arena.used = 0;
+    arena.allocations = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+
+// Bump allocator for data that lives exactly as long as a chapter (or the
+// whole session). Allocation is a pointer bump, freeing is resetting the
+// arena in one step. Memory comes in chunks from the heap; chunks are kept
+// across resets, so once an arena has seen its largest chapter it never
+// touches the heap again.
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t capacity;
+    size_t used;
+};
+
+struct Arena {
+    const char* name;
+    ArenaChunk* first;
+    ArenaChunk* current;
+    size_t chunkSize;
+    size_t used;                  // bytes handed out since the last reset
+    size_t highWater;
+    unsigned allocations;         // since the last reset
+    unsigned resets;
+    unsigned heapChunks;          // chunks ever taken from the heap
+
+    Arena() : name(""), first(0), current(0), chunkSize(0), used(0), highWater(0),
+              allocations(0), resets(0), heapChunks(0) {}
+};
+
+void arenaInit(Arena& arena, const char* name, size_t chunkSize);
+void* arenaAlloc(Arena& arena, size_t bytes, size_t align);
+void arenaReset(Arena& arena);
+void arenaRelease(Arena& arena);
+
+#endif
@@ -0,0 +1,259 @@
+#include "audio.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t AUDIO_RING_SIZE = 256;           // power of two
+const float SOUND_AMPLITUDE = 9000.0f;        // leaves headroom for a few voices at once
+const float TWO_PI = 6.2831853f;
+const int WAV_HEADER_SIZE = 44;
+
+struct AudioCommand {
+    int effect;
+    float volume;
+    Clock::time_point queuedAt;
+};
+
+// Single producer (game thread), single consumer (mixer thread)
+struct AudioRing {
+    AudioCommand commands[AUDIO_RING_SIZE];
+    std::atomic<size_t> head;                 // next slot to write, owned by the producer
+    std::atomic<size_t> tail;                 // next slot to read, owned by the consumer
+
+    AudioRing() : head(0), tail(0) {}
+};
+
+struct Voice {
+    int effect;                               // -1 when free
+    int position;
+    float volume;
+};
+
+// A sweep from startHz to endHz; effects are up to three notes in a row
+struct ToneNote {
+    float startHz, endHz;
+    int ms;                                   // 0 ends the effect
+};
+
+const ToneNote SOUND_NOTES[SOUND_EFFECTS][3] = {
+    {{440, 880, 120}},                                          // jump: a rising chirp
+    {{180, 90, 90}},                                            // landing: a low thump
+    {{660, 660, 70}, {880, 880, 110}},                          // combo
+    {{784, 784, 80}, {988, 988, 80}, {1319, 1319, 160}},        // exploration bonus
+    {{523, 523, 100}, {659, 659, 100}, {784, 784, 250}},        // chapter complete
+    {{392, 370, 200}, {330, 311, 200}, {262, 196, 450}}         // game over
+};
+
+static AudioRing ring;
+static std::vector<short> samples[SOUND_EFFECTS];
+static Voice voices[AUDIO_VOICES];
+static int sinkKind = AUDIO_SINK_NULL;
+static FILE* output = 0;
+static unsigned long long framesWritten = 0;
+static std::thread mixer;
+static bool running = false;
+static std::atomic<bool> stopping(false);
+static AudioStats stats = AudioStats();
+
+// Sine notes with a 5 ms attack and a quadratic decay, so nothing clicks
+static void synthesize(std::vector<short>& out, const ToneNote* notes) {
+    out.clear();
+    const int attack = AUDIO_SAMPLE_RATE / 200;
+    for (int n = 0; n < 3 && notes[n].ms > 0; n++) {
+        int frames = notes[n].ms * AUDIO_SAMPLE_RATE / 1000;
+        float phase = 0;
+        for (int i = 0; i < frames; i++) {
+            float t = (float)i / frames;
+            float envelope = (1 - t) * (1 - t);
+            if (i < attack) envelope *= (float)i / attack;
+            out.push_back((short)(sinf(phase) * envelope * SOUND_AMPLITUDE));
+
+            phase += TWO_PI * (notes[n].startHz + (notes[n].endHz - notes[n].startHz) * t) / AUDIO_SAMPLE_RATE;
+            if (phase > TWO_PI) phase -= TWO_PI;
+        }
+    }
+}
+
+static void putLittleEndian(unsigned char* out, unsigned value, int bytes) {
+    for (int i = 0; i < bytes; i++) out[i] = (unsigned char)(value >> (8 * i));
+}
+
+// Mono 16-bit PCM; the sizes are filled in once the length is known
+static void writeWavHeader(FILE* file, unsigned long long frames) {
+    unsigned dataBytes = (unsigned)(frames * 2);
+    unsigned char header[WAV_HEADER_SIZE] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+                                             'f', 'm', 't', ' ', 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             'd', 'a', 't', 'a', 0, 0, 0, 0};
+    putLittleEndian(header + 4, WAV_HEADER_SIZE - 8 + dataBytes, 4);
+    putLittleEndian(header + 16, 16, 4);                        // fmt chunk size
+    putLittleEndian(header + 20, 1, 2);                         // PCM
+    putLittleEndian(header + 22, 1, 2);                         // channels
+    putLittleEndian(header + 24, AUDIO_SAMPLE_RATE, 4);
+    putLittleEndian(header + 28, AUDIO_SAMPLE_RATE * 2, 4);     // bytes per second
+    putLittleEndian(header + 32, 2, 2);                         // bytes per frame
+    putLittleEndian(header + 34, 16, 2);                        // bits per sample
+    putLittleEndian(header + 40, dataBytes, 4);
+    fwrite(header, 1, sizeof(header), file);
+}
+
+// A free voice, or else the one that has played longest
+static void startVoice(int effect, float volume) {
+    int chosen = 0;
+    for (int i = 0; i < AUDIO_VOICES; i++) {
+        if (voices[i].effect < 0) {
+            chosen = i;
+            break;
+        }
+        if (voices[i].position > voices[chosen].position) chosen = i;
+    }
+    if (voices[chosen].effect >= 0) stats.stolen++;
+
+    voices[chosen].effect = effect;
+    voices[chosen].position = 0;
+    voices[chosen].volume = volume;
+    stats.played++;
+}
+
+static bool voicesPlaying() {
+    for (int i = 0; i < AUDIO_VOICES; i++) {
+        if (voices[i].effect >= 0) return true;
+    }
+    return false;
+}
+
+static void mixVoices(short* out) {
+    int mix[AUDIO_BUFFER_FRAMES] = {0};
+    for (int i = 0; i < AUDIO_VOICES; i++) {
+        Voice& voice = voices[i];
+        if (voice.effect < 0) continue;
+
+        const std::vector<short>& sound = samples[voice.effect];
+        int count = std::min(AUDIO_BUFFER_FRAMES, (int)sound.size() - voice.position);
+        const short* in = &sound[voice.position];
+        for (int k = 0; k < count; k++) {
+            mix[k] += (int)(in[k] * voice.volume);
+        }
+        voice.position += count;
+        if (voice.position >= (int)sound.size()) voice.effect = -1;
+    }
+
+    for (int k = 0; k < AUDIO_BUFFER_FRAMES; k++) {
+        out[k] = (short)std::max(-32768, std::min(32767, mix[k]));
+    }
+}
+
+// Each buffer is due when the sink finishes playing the one before it. The
+// mixer sleeps until then, so it is never more than one buffer ahead; a
+// buffer ready after its due time means the sink ran dry, and it restarts
+// from that buffer.
+static void mixerLoop() {
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>((double)AUDIO_BUFFER_FRAMES / AUDIO_SAMPLE_RATE));
+    Clock::time_point queuedAt[AUDIO_RING_SIZE];
+    short buffer[AUDIO_BUFFER_FRAMES];
+    Clock::time_point due = Clock::now() + period;
+
+    for (;;) {
+        bool finishing = stopping.load(std::memory_order_acquire);
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        size_t head = ring.head.load(std::memory_order_acquire);
+
+        int started = 0;
+        while (tail != head) {
+            const AudioCommand& command = ring.commands[tail & (AUDIO_RING_SIZE - 1)];
+            startVoice(command.effect, command.volume);
+            queuedAt[started++] = command.queuedAt;
+            tail++;
+        }
+        ring.tail.store(tail, std::memory_order_release);
+
+        if (finishing && started == 0 && !voicesPlaying()) break;
+
+        Clock::time_point mixStart = Clock::now();
+        mixVoices(buffer);
+        if (sinkKind == AUDIO_SINK_FILE) {
+            fwrite(buffer, sizeof(short), AUDIO_BUFFER_FRAMES, output);
+            framesWritten += AUDIO_BUFFER_FRAMES;
+        }
+        Clock::time_point ready = Clock::now();
+        stats.mixMs += std::chrono::duration<double, std::milli>(ready - mixStart).count();
+        stats.buffers++;
+
+        if (ready > due) {
+            stats.underruns++;
+            due = ready;
+        }
+        for (int i = 0; i < started; i++) {
+            double ms = std::chrono::duration<double, std::milli>(due - queuedAt[i]).count();
+            stats.latencyMs += ms;
+            stats.worstLatencyMs = std::max(stats.worstLatencyMs, ms);
+        }
+
+        std::this_thread::sleep_until(due);
+        due += period;
+    }
+}
+
+bool audioStart(int sink, const char* path) {
+    if (running) return true;
+    if (sink == AUDIO_SINK_FILE) {
+        output = fopen(path, "wb");
+        if (!output) return false;
+        writeWavHeader(output, 0);
+    }
+    sinkKind = sink;
+    framesWritten = 0;
+
+    for (int i = 0; i < SOUND_EFFECTS; i++) synthesize(samples[i], SOUND_NOTES[i]);
+    for (int i = 0; i < AUDIO_VOICES; i++) voices[i].effect = -1;
+    stats = AudioStats();
+    stopping.store(false);
+    mixer = std::thread(mixerLoop);
+    running = true;
+    return true;
+}
+
+bool audioEnabled() {
+    return running;
+}
+
+void playSound(int effect, float volume) {
+    if (!running) return;
+
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == AUDIO_RING_SIZE) {
+        stats.dropped++;
+        return;
+    }
+
+    AudioCommand& command = ring.commands[head & (AUDIO_RING_SIZE - 1)];
+    command.effect = effect;
+    command.volume = volume;
+    command.queuedAt = Clock::now();
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void audioStop() {
+    if (!running) return;
+    stopping.store(true, std::memory_order_release);
+    mixer.join();
+    running = false;
+
+    if (output) {
+        fseek(output, 0, SEEK_SET);
+        writeWavHeader(output, framesWritten);
+        fclose(output);
+        output = 0;
+    }
+}
+
+AudioStats audioStats() {
+    return stats;
+}
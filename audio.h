@@ -0,0 +1,49 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+// Sound effects. The game thread pushes play commands into a lock-free
+// single-producer ring and never waits; a mixer thread drains it, mixes
+// the samples of every playing voice into small fixed buffers and hands
+// each buffer to a sink that consumes it in real time, like a sound card
+// with one buffer queued ahead. A full ring drops commands (and counts
+// them); a buffer mixed after the sink ran dry counts as an underrun.
+
+enum SoundEffect {
+    SOUND_JUMP = 0,
+    SOUND_LANDING,
+    SOUND_COMBO,                  // combo milestones
+    SOUND_EXPLORATION_BONUS,
+    SOUND_LEVEL_COMPLETE,
+    SOUND_GAME_OVER,
+    SOUND_EFFECTS
+};
+
+enum AudioSink {
+    AUDIO_SINK_NULL = 0,          // mix and keep time, but output nothing
+    AUDIO_SINK_FILE               // also write the mix to a WAV file
+};
+
+const int AUDIO_SAMPLE_RATE = 22050;  // mono, 16-bit
+const int AUDIO_BUFFER_FRAMES = 256;  // about 11.6 ms per buffer
+const int AUDIO_VOICES = 16;          // sounds playing at once; the oldest is cut off for a new one
+
+struct AudioStats {
+    unsigned long long played;
+    unsigned long long dropped;       // ring full
+    unsigned long long stolen;        // voices cut off early
+    unsigned long long buffers;
+    unsigned long long underruns;
+    double latencyMs;                 // from playSound() until the sink starts playing it, summed
+    double worstLatencyMs;
+    double mixMs;                     // summed over the buffers
+};
+
+// Synthesizes the samples, then starts the mixer. path is the WAV file
+// for AUDIO_SINK_FILE.
+bool audioStart(int sink, const char* path);
+bool audioEnabled();
+void playSound(int effect, float volume = 1.0f);
+void audioStop();                     // lets playing sounds finish, then joins the mixer
+AudioStats audioStats();              // final once audioStop() has returned
+
+#endif
@@ -0,0 +1,144 @@
+#include "drawlist.h"
+
+void reserveDrawList(DrawList& list, size_t items, size_t vertices, size_t sprites, size_t instances) {
+    list.items.reserve(items);
+    list.vertices.reserve(vertices);
+    list.sprites.reserve(sprites);
+    list.instances.reserve(instances);
+}
+
+void beginDrawList(DrawList& list, const Mat4& view) {
+    list.view = view;
+    list.items.clear();
+    list.vertices.clear();
+    list.sprites.clear();
+    list.instances.clear();
+}
+
+static DrawItem& addItem(DrawList& list, int shape, const Mat4& model, const float color[4], int flags) {
+    DrawItem item;
+    item.modelView = mat4Multiply(list.view, model);
+    for (int i = 0; i < 4; i++) item.color[i] = color ? color[i] : 1.0f;
+    item.shape = shape;
+    item.flags = flags;
+    item.size = item.size2 = 0;
+    item.slices = item.stacks = 0;
+    item.mode = GL_TRIANGLES;
+    item.texture = 0;
+    item.mesh = 0;
+    item.table = 0;
+    item.first = item.count = 0;
+    list.items.push_back(item);
+    return list.items.back();
+}
+
+void drawListSphere(DrawList& list, const Mat4& model, const float color[4], float radius, int slices, int stacks,
+                    int flags) {
+    DrawItem& item = addItem(list, DRAW_SPHERE, model, color, flags);
+    item.size = radius;
+    item.slices = slices;
+    item.stacks = stacks;
+}
+
+void drawListCube(DrawList& list, const Mat4& model, const float color[4], float size, int flags) {
+    DrawItem& item = addItem(list, DRAW_CUBE, model, color, flags);
+    item.size = size;
+}
+
+void drawListTorus(DrawList& list, const Mat4& model, const float color[4], float innerRadius, float outerRadius,
+                   int sides, int rings, int flags) {
+    DrawItem& item = addItem(list, DRAW_TORUS, model, color, flags);
+    item.size = innerRadius;
+    item.size2 = outerRadius;
+    item.slices = sides;
+    item.stacks = rings;
+}
+
+void drawListVertices(DrawList& list, const Mat4& model, GLenum mode, const MeshVertex* table, int count, float size,
+                      int flags) {
+    if (count <= 0) return;
+    DrawItem& item = addItem(list, DRAW_VERTICES, model, 0, flags);
+    item.mode = mode;
+    item.size = size;
+    item.table = table;
+    item.count = count;
+}
+
+MeshVertex* drawListStream(DrawList& list, const Mat4& model, GLenum mode, int count, float size, int flags) {
+    size_t first = list.vertices.size();
+    list.vertices.resize(first + count);
+    if (count > 0) {
+        DrawItem& item = addItem(list, DRAW_VERTICES, model, 0, flags);
+        item.mode = mode;
+        item.size = size;
+        item.first = (int)first;
+        item.count = count;
+    }
+    return list.vertices.data() + first;
+}
+
+SpriteVertex* drawListSprites(DrawList& list, const Mat4& model, GLuint texture, const float color[4], int count,
+                              int flags) {
+    size_t first = list.sprites.size();
+    list.sprites.resize(first + count);
+    if (count > 0) {
+        DrawItem& item = addItem(list, DRAW_SPRITES, model, color, flags);
+        item.texture = texture;
+        item.first = (int)first;
+        item.count = count;
+    }
+    return list.sprites.data() + first;
+}
+
+MeshInstance* drawListInstances(DrawList& list, int mesh, int count, int flags) {
+    size_t first = list.instances.size();
+    list.instances.resize(first + count);
+    if (count > 0) {
+        DrawItem& item = addItem(list, DRAW_INSTANCES, mat4Identity(), 0, flags);
+        item.mesh = mesh;
+        item.first = (int)first;
+        item.count = count;
+    }
+    return list.instances.data() + first;
+}
+
+void submitDrawList(const DrawList& list) {
+    bool blend = false;
+    for (size_t i = 0; i < list.items.size(); i++) {
+        const DrawItem& item = list.items[i];
+        bool itemBlend = (item.flags & DRAW_BLEND) != 0;
+        if (itemBlend != blend) {
+            if (itemBlend) rEnable(GL_BLEND);
+            else rDisable(GL_BLEND);
+            blend = itemBlend;
+        }
+
+        rLoadMatrix(item.modelView);
+        rColor4f(item.color[0], item.color[1], item.color[2], item.color[3]);
+        switch (item.shape) {
+            case DRAW_SPHERE:
+                rSolidSphere(item.size, item.slices, item.stacks);
+                break;
+            case DRAW_CUBE:
+                rSolidCube(item.size);
+                break;
+            case DRAW_TORUS:
+                rSolidTorus(item.size, item.size2, item.slices, item.stacks);
+                break;
+            case DRAW_VERTICES:
+                if (item.size > 0 && item.mode == GL_POINTS) rPointSize(item.size);
+                if (item.size > 0 && item.mode == GL_LINES) rLineWidth(item.size);
+                rDrawVertices(item.mode, item.table ? item.table : &list.vertices[item.first], item.count);
+                break;
+            case DRAW_SPRITES:
+                rDrawSprites(item.texture, &list.sprites[item.first], item.count);
+                break;
+            case DRAW_INSTANCES:
+                rDrawInstances(item.mesh, &list.instances[item.first], item.count);
+                break;
+        }
+    }
+
+    if (blend) rDisable(GL_BLEND);
+    rLoadMatrix(list.view);
+}
@@ -0,0 +1,81 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include "renderer.h"
+#include <vector>
+
+// What one subsystem wants drawn this frame, recorded without touching the
+// renderer and replayed on the GL thread later. Recording only reads game
+// state and writes the list, so the lists of different subsystems can be
+// built on different threads; replaying issues the renderer calls in the
+// order they were recorded.
+
+enum DrawShape {
+    DRAW_SPHERE = 0,
+    DRAW_CUBE,
+    DRAW_TORUS,
+    DRAW_VERTICES,            // a vertex table, or a run of the list's own vertices
+    DRAW_SPRITES,             // a run of the list's sprite vertices
+    DRAW_INSTANCES            // a stored mesh at each of a run of the list's instances
+};
+
+enum DrawFlags {
+    DRAW_BLEND = 1            // GL_BLEND on while drawing the item
+};
+
+struct DrawItem {
+    Mat4 modelView;
+    float color[4];
+    int shape;
+    int flags;
+    float size, size2;        // sphere radius, cube size, torus inner and outer radius, point size or line width
+    int slices, stacks;       // sphere slices and stacks, torus sides and rings
+    GLenum mode;              // vertices: the primitive
+    GLuint texture;           // sprites
+    int mesh;                 // instances
+    const MeshVertex* table;  // vertices: 0 for the list's own
+    int first, count;
+};
+
+struct DrawList {
+    Mat4 view;
+    std::vector<DrawItem> items;
+    std::vector<MeshVertex> vertices;
+    std::vector<SpriteVertex> sprites;
+    std::vector<MeshInstance> instances;
+    double buildMs;           // time the last build took, on whichever thread ran it
+
+    DrawList() : buildMs(0) {}
+};
+
+// Room for this many of each, so recording stays within it
+void reserveDrawList(DrawList& list, size_t items, size_t vertices, size_t sprites, size_t instances);
+
+// Empty the list; items are placed by model matrices relative to view
+void beginDrawList(DrawList& list, const Mat4& view);
+
+void drawListSphere(DrawList& list, const Mat4& model, const float color[4], float radius, int slices, int stacks,
+                    int flags = 0);
+void drawListCube(DrawList& list, const Mat4& model, const float color[4], float size, int flags = 0);
+void drawListTorus(DrawList& list, const Mat4& model, const float color[4], float innerRadius, float outerRadius,
+                   int sides, int rings, int flags = 0);
+
+// A vertex table that outlives the replay. size is the point size or line
+// width for GL_POINTS or GL_LINES, 0 to leave it.
+void drawListVertices(DrawList& list, const Mat4& model, GLenum mode, const MeshVertex* table, int count, float size,
+                      int flags = 0);
+
+// Room for count vertices of the list's own, to be filled in before the
+// next call on the list
+MeshVertex* drawListStream(DrawList& list, const Mat4& model, GLenum mode, int count, float size, int flags = 0);
+SpriteVertex* drawListSprites(DrawList& list, const Mat4& model, GLuint texture, const float color[4], int count,
+                              int flags = 0);
+
+// Room for count instances of a stored mesh, placed relative to the view
+MeshInstance* drawListInstances(DrawList& list, int mesh, int count, int flags = 0);
+
+// Replay on the GL thread. Blending is expected off and left off; the
+// modelview matrix is left at the list's view.
+void submitDrawList(const DrawList& list);
+
+#endif
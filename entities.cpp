@@ -0,0 +1,118 @@
+#include "entities.h"
+
+unsigned columnHeapAllocations = 0;
+
+EntityDesc::EntityDesc(float x, float y, float z) : kind(0) {
+    position.x = x;
+    position.y = y;
+    position.z = z;
+    velocity.vx = velocity.vy = velocity.vz = 0;
+    spin.angle = spin.speed = 0;
+    extent.width = extent.depth = 0;
+    extent.scale = 1.0f;
+    glow.brightness = 1.0f;
+    glow.pulse = 0;
+    glow.life = glow.maxLife = 0;
+}
+
+// Column layout of every archetype
+void initEntityStore(EntityStore& store) {
+    store.tables[ARCH_PLANET].components = COMPONENT_POSITION | COMPONENT_SPIN | COMPONENT_EXTENT | COMPONENT_KIND;
+    store.tables[ARCH_ROSE].components = COMPONENT_POSITION | COMPONENT_SPIN | COMPONENT_EXTENT;
+    store.tables[ARCH_FOX].components = COMPONENT_POSITION | COMPONENT_SPIN;
+    store.tables[ARCH_SHOOTING_STAR].components = COMPONENT_POSITION | COMPONENT_VELOCITY | COMPONENT_GLOW;
+    store.tables[ARCH_ROSE_PETAL].components = COMPONENT_POSITION | COMPONENT_VELOCITY | COMPONENT_SPIN | COMPONENT_EXTENT;
+    store.tables[ARCH_STARDUST].components = COMPONENT_POSITION | COMPONENT_VELOCITY | COMPONENT_GLOW;
+}
+
+void clearTable(ArchetypeTable& table) {
+    table.position.clear();
+    table.velocity.clear();
+    table.spin.clear();
+    table.extent.clear();
+    table.glow.clear();
+    table.kind.clear();
+}
+
+void bindTable(ArchetypeTable& table, Arena* arena) {
+    table.position.bind(arena);
+    table.velocity.bind(arena);
+    table.spin.bind(arena);
+    table.extent.bind(arena);
+    table.glow.bind(arena);
+    table.kind.bind(arena);
+}
+
+void swapTables(ArchetypeTable& a, ArchetypeTable& b) {
+    a.position.swap(b.position);
+    a.velocity.swap(b.velocity);
+    a.spin.swap(b.spin);
+    a.extent.swap(b.extent);
+    a.glow.swap(b.glow);
+    a.kind.swap(b.kind);
+}
+
+void reserveTable(ArchetypeTable& table, size_t rows) {
+    table.position.reserve(rows);
+    if (table.components & COMPONENT_VELOCITY) table.velocity.reserve(rows);
+    if (table.components & COMPONENT_SPIN) table.spin.reserve(rows);
+    if (table.components & COMPONENT_EXTENT) table.extent.reserve(rows);
+    if (table.components & COMPONENT_GLOW) table.glow.reserve(rows);
+    if (table.components & COMPONENT_KIND) table.kind.reserve(rows);
+}
+
+size_t tableRowBytes(const ArchetypeTable& table) {
+    size_t bytes = sizeof(Position);
+    if (table.components & COMPONENT_VELOCITY) bytes += sizeof(Velocity);
+    if (table.components & COMPONENT_SPIN) bytes += sizeof(Spin);
+    if (table.components & COMPONENT_EXTENT) bytes += sizeof(Extent);
+    if (table.components & COMPONENT_GLOW) bytes += sizeof(Glow);
+    if (table.components & COMPONENT_KIND) bytes += sizeof(int);
+    return bytes;
+}
+
+// Append a row and return its index
+size_t spawnEntity(ArchetypeTable& table, const EntityDesc& desc) {
+    table.position.push_back(desc.position);
+    if (table.components & COMPONENT_VELOCITY) table.velocity.push_back(desc.velocity);
+    if (table.components & COMPONENT_SPIN) table.spin.push_back(desc.spin);
+    if (table.components & COMPONENT_EXTENT) table.extent.push_back(desc.extent);
+    if (table.components & COMPONENT_GLOW) table.glow.push_back(desc.glow);
+    if (table.components & COMPONENT_KIND) table.kind.push_back(desc.kind);
+    return table.position.size() - 1;
+}
+
+// Advance position by velocity and angle by spin for the first `rows` rows
+void integrateMotion(ArchetypeTable& table, size_t rows) {
+    if (rows > table.size()) rows = table.size();
+
+    if (table.components & COMPONENT_VELOCITY) {
+        Position* p = table.position.empty() ? 0 : &table.position[0];
+        const Velocity* v = table.velocity.empty() ? 0 : &table.velocity[0];
+        for (size_t i = 0; i < rows; i++) {
+            p[i].x += v[i].vx;
+            p[i].y += v[i].vy;
+            p[i].z += v[i].vz;
+        }
+    }
+
+    if (table.components & COMPONENT_SPIN) {
+        Spin* s = table.spin.empty() ? 0 : &table.spin[0];
+        for (size_t i = 0; i < rows; i++) {
+            s[i].angle += s[i].speed;
+        }
+    }
+}
+
+// For tables kept sorted by height (planets): index of the first row with
+// position.y >= y, so culling can start there instead of at row 0
+size_t firstRowAbove(const ArchetypeTable& table, float y) {
+    size_t lo = 0;
+    size_t hi = table.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (table.position[mid].y < y) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
@@ -0,0 +1,170 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include "arena.h"
+
+// Entity kinds, one archetype table each
+enum Archetype {
+    ARCH_PLANET = 0,
+    ARCH_ROSE,
+    ARCH_FOX,
+    ARCH_SHOOTING_STAR,
+    ARCH_ROSE_PETAL,
+    ARCH_STARDUST,
+    ARCH_COUNT
+};
+
+// Component bits describing which columns a table carries
+enum ComponentBits {
+    COMPONENT_POSITION = 1 << 0,
+    COMPONENT_VELOCITY = 1 << 1,
+    COMPONENT_SPIN     = 1 << 2,
+    COMPONENT_EXTENT   = 1 << 3,
+    COMPONENT_GLOW     = 1 << 4,
+    COMPONENT_KIND     = 1 << 5
+};
+
+struct Position {
+    float x, y, z;
+};
+
+struct Velocity {
+    float vx, vy, vz;
+};
+
+// Rotation in degrees and how much it advances per tick
+struct Spin {
+    float angle;
+    float speed;
+};
+
+// Footprint for planets, uniform scale for roses and petals
+struct Extent {
+    float width;
+    float depth;
+    float scale;
+};
+
+// Brightness and lifetime for stars and particles
+struct Glow {
+    float brightness;
+    float pulse;
+    float life;
+    float maxLife;
+};
+
+// Heap allocations made by columns that are not backed by an arena
+extern unsigned columnHeapAllocations;
+
+// Growable array of plain component values. Storage comes from the table's
+// arena when it has one (and is then dropped, not freed, when the arena is
+// reset), otherwise from the heap.
+template <typename T> struct Column {
+    T* rows;
+    size_t count;
+    size_t capacity;
+    Arena* arena;
+
+    Column() : rows(0), count(0), capacity(0), arena(0) {}
+    ~Column() { if (!arena) free(rows); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) { return rows[i]; }
+    const T& operator[](size_t i) const { return rows[i]; }
+
+    void clear() { count = 0; }
+    void reserve(size_t n) { if (n > capacity) grow(n); }
+    void resize(size_t n) { reserve(n); count = n; }
+    void push_back(const T& v) {
+        if (count == capacity) grow(capacity ? capacity * 2 : 16);
+        rows[count++] = v;
+    }
+
+    // Switch storage; existing rows are forgotten, not copied
+    void bind(Arena* newArena) {
+        if (!arena) free(rows);
+        rows = 0;
+        count = capacity = 0;
+        arena = newArena;
+    }
+
+    // Exchange storage (and the arena it came from) with another column
+    void swap(Column& other) {
+        T* r = rows; rows = other.rows; other.rows = r;
+        size_t n = count; count = other.count; other.count = n;
+        n = capacity; capacity = other.capacity; other.capacity = n;
+        Arena* a = arena; arena = other.arena; other.arena = a;
+    }
+
+    void grow(size_t n) {
+        T* fresh;
+        if (arena) {
+            fresh = static_cast<T*>(arenaAlloc(*arena, n * sizeof(T), alignof(T)));
+        } else {
+            fresh = static_cast<T*>(malloc(n * sizeof(T)));
+            columnHeapAllocations++;
+        }
+        if (count > 0) memcpy(fresh, rows, count * sizeof(T));
+        if (!arena) free(rows);
+        rows = fresh;
+        capacity = n;
+    }
+
+private:
+    Column(const Column&);
+    Column& operator=(const Column&);
+};
+
+// Structure-of-arrays storage for one archetype. Columns that are not in
+// `components` stay empty; the rest always have size() rows.
+struct ArchetypeTable {
+    unsigned components;
+    Column<Position> position;
+    Column<Velocity> velocity;
+    Column<Spin> spin;
+    Column<Extent> extent;
+    Column<Glow> glow;
+    Column<int> kind;          // render kind within the archetype, e.g. planet type
+
+    ArchetypeTable() : components(COMPONENT_POSITION) {}
+
+    size_t size() const { return position.size(); }
+};
+
+// All planets, decorations and particles of the scene
+struct EntityStore {
+    ArchetypeTable tables[ARCH_COUNT];
+};
+
+// Component values for a new row; fields for absent columns are ignored
+struct EntityDesc {
+    Position position;
+    Velocity velocity;
+    Spin spin;
+    Extent extent;
+    Glow glow;
+    int kind;
+
+    EntityDesc(float x, float y, float z);
+};
+
+void initEntityStore(EntityStore& store);
+void clearTable(ArchetypeTable& table);
+// Move a table's storage to an arena. Call again after resetting the arena.
+void bindTable(ArchetypeTable& table, Arena* arena);
+// Exchange the rows of two tables with the same components in O(1)
+void swapTables(ArchetypeTable& a, ArchetypeTable& b);
+void reserveTable(ArchetypeTable& table, size_t rows);
+// Bytes of one row across the table's columns
+size_t tableRowBytes(const ArchetypeTable& table);
+size_t spawnEntity(ArchetypeTable& table, const EntityDesc& desc);
+
+// Systems shared by every archetype
+void integrateMotion(ArchetypeTable& table, size_t rows);
+size_t firstRowAbove(const ArchetypeTable& table, float y);
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef GEOMETRY_TABLES_H
+#define GEOMETRY_TABLES_H
+
+#include "renderer.h"
+#include <cassert>
+#include <cmath>
+
+// Vertex tables for static shapes, generated at compile time so drawing them
+// needs no trig at runtime. The formulas (including the 3.14159f constants)
+// mirror the immediate-mode code they replaced.
+
+const int DOME_SLICES = 12;
+const int DOME_SEGMENTS = 8;
+constexpr float DOME_RADIUS = 4.5f;
+const int DOME_VERTEX_COUNT = DOME_SLICES * DOME_SEGMENTS * 3;
+
+const int PETAL_SEGMENTS = 8;
+const int PETAL_VERTEX_COUNT = PETAL_SEGMENTS * 3;
+
+const int AURA_SPARKS = 8;
+
+constexpr double CT_PI = 3.14159265358979323846;
+
+// Taylor series sine, accurate to well below float precision after range reduction
+constexpr double ctSin(double x) {
+    while (x > CT_PI) x -= 2 * CT_PI;
+    while (x < -CT_PI) x += 2 * CT_PI;
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double ctCos(double x) {
+    return ctSin(x + CT_PI / 2);
+}
+
+constexpr double ctAbs(double x) {
+    return x < 0 ? -x : x;
+}
+
+struct GlassDomeTable {
+    MeshVertex vertices[DOME_VERTEX_COUNT];
+};
+
+struct RosePetalTable {
+    MeshVertex vertices[PETAL_VERTEX_COUNT];
+};
+
+// Per-spark phase terms of the starlight aura, combined each frame with the
+// sine/cosine of the shared time term via the angle-addition formulas
+struct AuraPhaseTable {
+    float sinPhase[AURA_SPARKS], cosPhase[AURA_SPARKS];             // i * 0.785
+    float sinPhaseStretch[AURA_SPARKS], cosPhaseStretch[AURA_SPARKS]; // 1.1 * i * 0.785
+    float sinRadiusPhase[AURA_SPARKS], cosRadiusPhase[AURA_SPARKS];   // i
+};
+
+constexpr MeshVertex ctVertex(double x, double y, double z, double nx, double ny, double nz,
+                              float r, float g, float b, float a) {
+    return MeshVertex{(float)x, (float)y, (float)z, (float)nx, (float)ny, (float)nz, r, g, b, a};
+}
+
+// Glass dome: 12 fans of 8 triangles rotated about y. The per-slice rotation
+// is baked into positions and into the (0, 0, 1) immediate-mode normal.
+constexpr GlassDomeTable makeGlassDomeTable() {
+    GlassDomeTable t{};
+    int v = 0;
+    for (int i = 0; i < DOME_SLICES; i++) {
+        double rot = i * 30 * CT_PI / 180.0;
+        double c = ctCos(rot);
+        double s = ctSin(rot);
+        for (int j = 0; j < DOME_SEGMENTS; j++) {
+            double angle1 = (float)(j * 3.14159f / 16.0f);
+            double angle2 = (float)((j + 1) * 3.14159f / 16.0f);
+            double px[3] = {0, DOME_RADIUS * ctSin(angle1), DOME_RADIUS * ctSin(angle2)};
+            double py[3] = {DOME_RADIUS, DOME_RADIUS * ctCos(angle1), DOME_RADIUS * ctCos(angle2)};
+            for (int k = 0; k < 3; k++) {
+                t.vertices[v++] = ctVertex(px[k] * c, py[k], -px[k] * s, s, 0, c, 0.9f, 0.95f, 1.0f, 0.3f);
+            }
+        }
+    }
+    return t;
+}
+
+// Rose petal: 8-triangle elliptical fan in the xy plane
+constexpr RosePetalTable makeRosePetalTable() {
+    RosePetalTable t{};
+    int v = 0;
+    for (int j = 0; j < PETAL_SEGMENTS; j++) {
+        double angle = (float)(j * 3.14159f / 4.0f);
+        double next = (float)(angle + 0.785f);
+        t.vertices[v++] = ctVertex(0, 0, 0, 0, 0, 1, 0.9f, 0.4f, 0.5f, 0.7f);
+        t.vertices[v++] = ctVertex(ctSin(angle) * 3, ctCos(angle) * 2, 0, 0, 0, 1, 0.9f, 0.4f, 0.5f, 0.7f);
+        t.vertices[v++] = ctVertex(ctSin(next) * 3, ctCos(next) * 2, 0, 0, 0, 1, 0.9f, 0.4f, 0.5f, 0.7f);
+    }
+    return t;
+}
+
+constexpr AuraPhaseTable makeAuraPhaseTable() {
+    AuraPhaseTable t{};
+    for (int i = 0; i < AURA_SPARKS; i++) {
+        double phase = (float)(i * 0.785f);
+        t.sinPhase[i] = (float)ctSin(phase);
+        t.cosPhase[i] = (float)ctCos(phase);
+        t.sinPhaseStretch[i] = (float)ctSin(phase * 1.1);
+        t.cosPhaseStretch[i] = (float)ctCos(phase * 1.1);
+        t.sinRadiusPhase[i] = (float)ctSin(i);
+        t.cosRadiusPhase[i] = (float)ctCos(i);
+    }
+    return t;
+}
+
+constexpr GlassDomeTable GLASS_DOME_TABLE = makeGlassDomeTable();
+constexpr RosePetalTable ROSE_PETAL_TABLE = makeRosePetalTable();
+constexpr AuraPhaseTable AURA_PHASE_TABLE = makeAuraPhaseTable();
+
+// Compile-time spot checks against closed-form values
+static_assert(ctAbs(ctSin(CT_PI / 6) - 0.5) < 1e-12, "ctSin inaccurate");
+static_assert(ctAbs(ctCos(CT_PI / 3) - 0.5) < 1e-12, "ctCos inaccurate");
+static_assert(ctAbs(ctSin(7.5) - 0.9379999767747389) < 1e-12, "ctSin range reduction broken");
+static_assert(ctAbs(GLASS_DOME_TABLE.vertices[0].y - DOME_RADIUS) < 1e-6, "dome apex misplaced");
+static_assert(ctAbs(GLASS_DOME_TABLE.vertices[DOME_SEGMENTS * 3 - 1].x - DOME_RADIUS) < 1e-4, "dome rim misplaced");
+static_assert(ctAbs(GLASS_DOME_TABLE.vertices[DOME_SEGMENTS * 3 + 2].z + DOME_RADIUS * 0.5 * ctSin(3.14159f / 16.0f)) < 1e-5,
+              "dome slice rotation wrong");
+static_assert(ctAbs(ROSE_PETAL_TABLE.vertices[1].y - 2.0) < 1e-6, "petal tip misplaced");
+static_assert(ctAbs(AURA_PHASE_TABLE.cosRadiusPhase[0] - 1.0) < 1e-6, "aura phase table wrong");
+
+// Compare every table entry with the runtime trig the tables replaced.
+// Called from debug builds only, so release builds pay nothing.
+inline void verifyGeometryTables() {
+    const float tolerance = 1e-4f;
+
+    int v = 0;
+    for (int i = 0; i < DOME_SLICES; i++) {
+        float rot = i * 30 * 3.14159265f / 180.0f;
+        for (int j = 0; j < DOME_SEGMENTS; j++) {
+            float angle1 = j * 3.14159f / 16.0f;
+            float angle2 = (j + 1) * 3.14159f / 16.0f;
+            float px[3] = {0, DOME_RADIUS * std::sin(angle1), DOME_RADIUS * std::sin(angle2)};
+            float py[3] = {DOME_RADIUS, DOME_RADIUS * std::cos(angle1), DOME_RADIUS * std::cos(angle2)};
+            for (int k = 0; k < 3; k++, v++) {
+                const MeshVertex& t = GLASS_DOME_TABLE.vertices[v];
+                assert(std::fabs(t.x - px[k] * std::cos(rot)) < tolerance);
+                assert(std::fabs(t.y - py[k]) < tolerance);
+                assert(std::fabs(t.z + px[k] * std::sin(rot)) < tolerance);
+                assert(std::fabs(t.nx - std::sin(rot)) < tolerance && std::fabs(t.nz - std::cos(rot)) < tolerance);
+            }
+        }
+    }
+
+    v = 0;
+    for (int j = 0; j < PETAL_SEGMENTS; j++) {
+        float angle = j * 3.14159f / 4.0f;
+        float px[3] = {0, std::sin(angle) * 3, std::sin(angle + 0.785f) * 3};
+        float py[3] = {0, std::cos(angle) * 2, std::cos(angle + 0.785f) * 2};
+        for (int k = 0; k < 3; k++, v++) {
+            assert(std::fabs(ROSE_PETAL_TABLE.vertices[v].x - px[k]) < tolerance);
+            assert(std::fabs(ROSE_PETAL_TABLE.vertices[v].y - py[k]) < tolerance);
+        }
+    }
+
+    // Aura positions at a few sample times, table form against direct trig
+    for (int s = 0; s < 16; s++) {
+        float time = s * 0.37f;
+        float sinT = std::sin(time * 1.2f), cosT = std::cos(time * 1.2f);
+        float sinTs = std::sin(time * 1.2f * 1.1f), cosTs = std::cos(time * 1.2f * 1.1f);
+        float sinR = std::sin(time * 2), cosR = std::cos(time * 2);
+        for (int i = 0; i < AURA_SPARKS; i++) {
+            float angle = time * 1.2f + i * 0.785f;
+            float radius = 10 + std::sin(time * 2 + i) * 2;
+            float tableRadius = 10 + (sinR * AURA_PHASE_TABLE.cosRadiusPhase[i] + cosR * AURA_PHASE_TABLE.sinRadiusPhase[i]) * 2;
+            float tableSin = sinT * AURA_PHASE_TABLE.cosPhase[i] + cosT * AURA_PHASE_TABLE.sinPhase[i];
+            float tableCos = cosT * AURA_PHASE_TABLE.cosPhase[i] - sinT * AURA_PHASE_TABLE.sinPhase[i];
+            float tableCosStretch = cosTs * AURA_PHASE_TABLE.cosPhaseStretch[i] - sinTs * AURA_PHASE_TABLE.sinPhaseStretch[i];
+            assert(std::fabs(tableRadius - radius) < 1e-3f);
+            assert(std::fabs(tableSin - std::sin(angle)) < tolerance);
+            assert(std::fabs(tableCos - std::cos(angle)) < tolerance);
+            assert(std::fabs(tableCosStretch - std::cos(angle * 1.1f)) < tolerance);
+        }
+    }
+}
+
+#endif
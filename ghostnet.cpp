@@ -0,0 +1,404 @@
+#include "ghostnet.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+static const SocketHandle NO_SOCKET = INVALID_SOCKET;
+#define closeSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+typedef int SocketHandle;
+static const SocketHandle NO_SOCKET = -1;
+#define closeSocket close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Quantization steps: 1/16 unit for positions, 1 degree, 1/64 unit of bob
+static const float FIELD_SCALE[GHOST_FIELDS] = {16.0f, 16.0f, 16.0f, 1.0f, 64.0f};
+
+static const unsigned char FLAG_ON_GROUND = 1;
+static const unsigned char FLAG_ALIVE = 2;
+static const size_t VARINT_MAX_BYTES = 5;       // enough for any 32-bit value
+
+static void writeVarint(std::vector<unsigned char>& out, unsigned value) {
+    while (value >= 0x80) {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static bool readVarint(const unsigned char* data, size_t size, size_t& at, unsigned& value) {
+    value = 0;
+    for (int shift = 0; shift < 7 * (int)VARINT_MAX_BYTES; shift += 7) {
+        if (at >= size) return false;
+        unsigned char b = data[at++];
+        value |= (unsigned)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static unsigned zigzag(int v) {
+    return ((unsigned)v << 1) ^ (unsigned)(v >> 31);
+}
+
+static int unzigzag(unsigned v) {
+    return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+static void quantize(const GhostState& s, int fields[GHOST_FIELDS]) {
+    float values[GHOST_FIELDS] = {s.x, s.y, s.z, s.rotation, s.bobOffset};
+    for (int f = 0; f < GHOST_FIELDS; f++) {
+        fields[f] = (int)lroundf(values[f] * FIELD_SCALE[f]);
+    }
+}
+
+static void dequantize(const int fields[GHOST_FIELDS], GhostState& s) {
+    s.x = fields[0] / FIELD_SCALE[0];
+    s.y = fields[1] / FIELD_SCALE[1];
+    s.z = fields[2] / FIELD_SCALE[2];
+    s.rotation = fields[3] / FIELD_SCALE[3];
+    s.bobOffset = fields[4] / FIELD_SCALE[4];
+}
+
+void encodeGhostFrame(GhostDeltaState& previous, const GhostFrame& frame, std::vector<unsigned char>& out) {
+    static std::vector<unsigned char> body;
+    body.clear();
+
+    int count = frame.count < GHOST_MAX_PLAYERS ? frame.count : GHOST_MAX_PLAYERS;
+    writeVarint(body, frame.tick);
+    for (int i = 0; i < 4; i++) body.push_back((unsigned char)(frame.sendMicros >> (i * 8)));
+    writeVarint(body, count);
+
+    for (int p = 0; p < count; p++) {
+        const GhostState& s = frame.players[p];
+        body.push_back((s.onGround ? FLAG_ON_GROUND : 0) | (s.alive ? FLAG_ALIVE : 0));
+
+        // Players new since the last tick are sent against zero
+        int fields[GHOST_FIELDS];
+        quantize(s, fields);
+        for (int f = 0; f < GHOST_FIELDS; f++) {
+            int base = p < previous.count ? previous.fields[p][f] : 0;
+            writeVarint(body, zigzag(fields[f] - base));
+            previous.fields[p][f] = fields[f];
+        }
+    }
+    previous.count = count;
+
+    writeVarint(out, (unsigned)body.size());
+    out.insert(out.end(), body.begin(), body.end());
+}
+
+bool decodeGhostFrame(GhostDeltaState& previous, const unsigned char* data, size_t size, GhostFrame& frame) {
+    size_t at = 0;
+    unsigned count = 0;
+    if (!readVarint(data, size, at, frame.tick)) return false;
+    if (at + 4 > size) return false;
+    frame.sendMicros = 0;
+    for (int i = 0; i < 4; i++) frame.sendMicros |= (unsigned)data[at++] << (i * 8);
+    if (!readVarint(data, size, at, count) || count > (unsigned)GHOST_MAX_PLAYERS) return false;
+
+    for (unsigned p = 0; p < count; p++) {
+        if (at >= size) return false;
+        unsigned char flags = data[at++];
+        int fields[GHOST_FIELDS];
+        for (int f = 0; f < GHOST_FIELDS; f++) {
+            unsigned delta;
+            if (!readVarint(data, size, at, delta)) return false;
+            int base = (int)p < previous.count ? previous.fields[p][f] : 0;
+            fields[f] = base + unzigzag(delta);
+            previous.fields[p][f] = fields[f];
+        }
+
+        GhostState& s = frame.players[p];
+        dequantize(fields, s);
+        s.onGround = (flags & FLAG_ON_GROUND) != 0;
+        s.alive = (flags & FLAG_ALIVE) != 0;
+    }
+    previous.count = count;
+    frame.count = count;
+    return true;
+}
+
+void pushGhostFrame(GhostJitterBuffer& buffer, const GhostFrame& frame) {
+    if (buffer.count > 0) {
+        const GhostFrame& newest = buffer.frames[(buffer.head + buffer.count - 1) % GHOST_BUFFER_FRAMES];
+        if (frame.tick <= newest.tick) {
+            // The sender restarted its game: start playback over
+            buffer.count = 0;
+            buffer.playing = false;
+        }
+    }
+    if (buffer.count == GHOST_BUFFER_FRAMES) {
+        buffer.head = (buffer.head + 1) % GHOST_BUFFER_FRAMES;
+        buffer.count--;
+    }
+    buffer.frames[(buffer.head + buffer.count) % GHOST_BUFFER_FRAMES] = frame;
+    buffer.count++;
+}
+
+static float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+bool sampleGhosts(GhostJitterBuffer& buffer, double elapsedTicks, GhostFrame& out) {
+    if (buffer.count == 0) return false;
+
+    const GhostFrame& oldest = buffer.frames[buffer.head];
+    const GhostFrame& newest = buffer.frames[(buffer.head + buffer.count - 1) % GHOST_BUFFER_FRAMES];
+    double target = (double)newest.tick - GHOST_JITTER_TICKS;
+
+    if (!buffer.playing) {
+        buffer.playbackTick = target;
+        buffer.playing = true;
+    } else {
+        buffer.playbackTick += elapsedTicks;
+        if (buffer.playbackTick > newest.tick) {
+            buffer.playbackTick = newest.tick;
+            buffer.underruns++;
+        } else if (buffer.playbackTick < target - GHOST_JITTER_TICKS * 2) {
+            buffer.playbackTick = target;
+            buffer.skips++;
+        }
+    }
+    if (buffer.playbackTick < oldest.tick) buffer.playbackTick = oldest.tick;
+
+    // Bracketing frames; ticks can have gaps if the sender stalled
+    int a = 0;
+    while (a + 1 < buffer.count &&
+           buffer.frames[(buffer.head + a + 1) % GHOST_BUFFER_FRAMES].tick <= buffer.playbackTick) {
+        a++;
+    }
+    const GhostFrame& from = buffer.frames[(buffer.head + a) % GHOST_BUFFER_FRAMES];
+    const GhostFrame& to = buffer.frames[(buffer.head + (a + 1 < buffer.count ? a + 1 : a)) % GHOST_BUFFER_FRAMES];
+    float t = to.tick > from.tick ? (float)((buffer.playbackTick - from.tick) / (to.tick - from.tick)) : 0.0f;
+
+    out.tick = from.tick;
+    out.sendMicros = from.sendMicros;
+    out.count = from.count < to.count ? from.count : to.count;
+    for (int p = 0; p < out.count; p++) {
+        const GhostState& s0 = from.players[p];
+        const GhostState& s1 = to.players[p];
+        GhostState& s = out.players[p];
+        s = s0;
+        // Screen wrap jumps across the level; snap instead of sliding through it
+        if (fabsf(s1.x - s0.x) < 100) s.x = lerp(s0.x, s1.x, t);
+        s.y = lerp(s0.y, s1.y, t);
+        s.z = lerp(s0.z, s1.z, t);
+        s.rotation = lerp(s0.rotation, s1.rotation, t);
+        s.bobOffset = lerp(s0.bobOffset, s1.bobOffset, t);
+    }
+    return true;
+}
+
+static bool startSockets() {
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) return false;
+        started = true;
+    }
+#endif
+    return true;
+}
+
+static void setNonBlocking(SocketHandle s) {
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(s, FIONBIO, &on);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+static void setNoDelay(SocketHandle s) {
+    int on = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+}
+
+static bool wouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+static sockaddr_in loopbackAddress(int port) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+bool ghostListen(GhostLink& link, int port) {
+    if (!startSockets()) return false;
+    SocketHandle s = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NO_SOCKET) return false;
+
+    int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+    sockaddr_in address = loopbackAddress(port);
+    if (bind(s, (const sockaddr*)&address, sizeof(address)) != 0 || listen(s, 1) != 0) {
+        closeSocket(s);
+        return false;
+    }
+    setNonBlocking(s);
+    link.listenSocket = (long long)s;
+    return true;
+}
+
+bool ghostConnect(GhostLink& link, int port) {
+    if (!startSockets()) return false;
+    SocketHandle s = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (s == NO_SOCKET) return false;
+
+    sockaddr_in address = loopbackAddress(port);
+    if (connect(s, (const sockaddr*)&address, sizeof(address)) != 0) {
+        closeSocket(s);
+        return false;
+    }
+    setNonBlocking(s);
+    setNoDelay(s);
+    link.socket = (long long)s;
+    link.deltaState = GhostDeltaState();
+    link.outbox.reserve(GHOST_MAX_PACKET_BYTES);
+    link.outbox.clear();
+    link.outboxSent = 0;
+    return true;
+}
+
+bool ghostConnected(const GhostLink& link) {
+    return link.socket != -1;
+}
+
+static void dropConnection(GhostLink& link) {
+    if (link.socket != -1) closeSocket((SocketHandle)link.socket);
+    link.socket = -1;
+    link.inbox.clear();
+    link.outbox.clear();
+    link.outboxSent = 0;
+    link.deltaState = GhostDeltaState();
+}
+
+void ghostClose(GhostLink& link) {
+    dropConnection(link);
+    if (link.listenSocket != -1) closeSocket((SocketHandle)link.listenSocket);
+    link.listenSocket = -1;
+}
+
+// Hand the socket as much of the outbox as it takes without blocking.
+// Returns false if the connection was lost.
+static bool flushOutbox(GhostLink& link) {
+    while (link.outboxSent < link.outbox.size()) {
+        int n = send((SocketHandle)link.socket, (const char*)&link.outbox[link.outboxSent],
+                     (int)(link.outbox.size() - link.outboxSent), MSG_NOSIGNAL);
+        if (n > 0) {
+            link.outboxSent += n;
+            continue;
+        }
+        if (n < 0 && wouldBlock()) return true;
+        std::cerr << "ghost: connection lost" << std::endl;
+        dropConnection(link);
+        return false;
+    }
+    return true;
+}
+
+void ghostSend(GhostLink& link, const GhostFrame& frame) {
+    if (link.socket == -1) return;
+    if (!flushOutbox(link)) return;
+    if (link.outboxSent < link.outbox.size()) {
+        link.dropped++;
+        return;
+    }
+
+    link.outbox.clear();
+    link.outboxSent = 0;
+    encodeGhostFrame(link.deltaState, frame, link.outbox);
+    link.bytes += link.outbox.size();
+    link.packets++;
+    flushOutbox(link);
+}
+
+int ghostReceive(GhostLink& link, GhostJitterBuffer& buffer, void (*onFrame)(const GhostFrame& frame)) {
+    if (link.socket == -1 && link.listenSocket != -1) {
+        SocketHandle s = accept((SocketHandle)link.listenSocket, NULL, NULL);
+        if (s == NO_SOCKET) return 0;
+        setNonBlocking(s);
+        setNoDelay(s);
+        link.socket = (long long)s;
+        link.deltaState = GhostDeltaState();
+        std::cerr << "ghost: sender connected" << std::endl;
+    }
+    if (link.socket == -1) return 0;
+
+    char chunk[4096];
+    for (;;) {
+        int n = recv((SocketHandle)link.socket, chunk, sizeof(chunk), 0);
+        if (n > 0) {
+            link.inbox.insert(link.inbox.end(), chunk, chunk + n);
+            continue;
+        }
+        if (n < 0 && wouldBlock()) break;
+        std::cerr << "ghost: sender disconnected" << std::endl;
+        dropConnection(link);
+        return 0;
+    }
+
+    static GhostFrame frame;
+    int frames = 0;
+    size_t at = 0;
+    while (at < link.inbox.size()) {
+        size_t start = at;
+        unsigned length;
+        // A length prefix that runs out of bytes waits for more; one that
+        // does not end within VARINT_MAX_BYTES, or announces more than any
+        // sender writes, would stall the stream and is a protocol error
+        bool prefix = readVarint(&link.inbox[0], link.inbox.size(), at, length);
+        bool malformed = prefix ? length > GHOST_MAX_PACKET_BYTES : link.inbox.size() - start >= VARINT_MAX_BYTES;
+        if (!malformed && (!prefix || at + length > link.inbox.size())) {
+            at = start;
+            break;
+        }
+        if (malformed || !decodeGhostFrame(link.deltaState, &link.inbox[at], length, frame)) {
+            std::cerr << "ghost: malformed packet, dropping connection" << std::endl;
+            dropConnection(link);
+            return frames;
+        }
+        at += length;
+        link.bytes += at - start;
+        link.packets++;
+        pushGhostFrame(buffer, frame);
+        if (onFrame) onFrame(frame);
+        frames++;
+    }
+    link.inbox.erase(link.inbox.begin(), link.inbox.begin() + at);
+    return frames;
+}
+
+unsigned ghostClockMicros() {
+    // steady_clock is CLOCK_MONOTONIC / QueryPerformanceCounter, both shared
+    // by every process on the machine
+    return (unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
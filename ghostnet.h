@@ -0,0 +1,105 @@
+#ifndef GHOSTNET_H
+#define GHOSTNET_H
+
+#include <vector>
+#include <cstddef>
+
+// Ghost racing over a loopback TCP connection. One instance streams the
+// state of its princes every tick; the other buffers the stream and draws
+// them as ghosts a few ticks behind, interpolating between ticks.
+
+const int GHOST_MAX_PLAYERS = 512;   // every prince the game allows (MAX_PLAYERS)
+const int GHOST_BUFFER_FRAMES = 32;
+const int GHOST_JITTER_TICKS = 3;     // playback delay behind the newest tick received
+const int GHOST_FIELDS = 5;           // quantized x, y, z, rotation, bob
+
+// Longest packet: length, tick, send time and count, then a flags byte and
+// five-byte varints for every field of every player
+const size_t GHOST_MAX_PACKET_BYTES = 16 + GHOST_MAX_PLAYERS * (1 + GHOST_FIELDS * 5);
+
+// What a ghost needs to be drawn
+struct GhostState {
+    float x, y, z;
+    float rotation;
+    float bobOffset;
+    bool onGround;
+    bool alive;
+};
+
+// All ghosts of one tick, stamped by the sender
+struct GhostFrame {
+    unsigned tick;
+    unsigned sendMicros;              // sender's monotonic clock, wraps every ~71 minutes
+    int count;
+    GhostState players[GHOST_MAX_PLAYERS];
+};
+
+// Quantized fields of the previous tick on either end. Every packet is a
+// delta against the one before it, which TCP delivers in order.
+struct GhostDeltaState {
+    int count;
+    int fields[GHOST_MAX_PLAYERS][GHOST_FIELDS];
+
+    GhostDeltaState() : count(0) {}
+};
+
+// Wire format, one length-prefixed packet per tick:
+//   varint length, varint tick, u32 send time,
+//   varint count, then per player a flags byte and zigzag varint deltas
+void encodeGhostFrame(GhostDeltaState& previous, const GhostFrame& frame, std::vector<unsigned char>& out);
+bool decodeGhostFrame(GhostDeltaState& previous, const unsigned char* data, size_t size, GhostFrame& frame);
+
+// Received frames waiting to be played back
+struct GhostJitterBuffer {
+    GhostFrame frames[GHOST_BUFFER_FRAMES];
+    int head;                         // oldest frame
+    int count;
+    double playbackTick;              // fractional tick currently shown
+    bool playing;
+    int underruns;                    // playback caught up with the newest frame
+    int skips;                        // playback fell too far behind and jumped ahead
+
+    GhostJitterBuffer() : head(0), count(0), playbackTick(0), playing(false), underruns(0), skips(0) {}
+};
+
+void pushGhostFrame(GhostJitterBuffer& buffer, const GhostFrame& frame);
+
+// Advance playback by elapsedTicks and interpolate the ghosts at the new
+// position. Returns false until the first frame has arrived.
+bool sampleGhosts(GhostJitterBuffer& buffer, double elapsedTicks, GhostFrame& out);
+
+// One end of the loopback connection
+struct GhostLink {
+    long long listenSocket;
+    long long socket;
+    std::vector<unsigned char> inbox;     // received bytes not yet decoded
+    std::vector<unsigned char> outbox;    // one packet, sized for the longest
+    size_t outboxSent;                    // bytes of it the socket has taken so far
+    GhostDeltaState deltaState;
+    unsigned long long bytes;             // payload bytes sent or received
+    unsigned long long packets;
+    unsigned long long dropped;           // ticks the sender skipped while the receiver lagged
+
+    GhostLink() : listenSocket(-1), socket(-1), outboxSent(0), bytes(0), packets(0), dropped(0) {}
+};
+
+bool ghostListen(GhostLink& link, int port);
+bool ghostConnect(GhostLink& link, int port);
+bool ghostConnected(const GhostLink& link);
+void ghostClose(GhostLink& link);
+
+// Sender: encode and send one tick without blocking. While the previous
+// packet is still waiting in the outbox the tick is dropped (and counted);
+// the next one is encoded against the last one sent. Drops the connection
+// on error.
+void ghostSend(GhostLink& link, const GhostFrame& frame);
+
+// Receiver: accept a pending connection, drain the socket without blocking
+// and push every complete packet into the buffer. Calls onFrame for each
+// one so the caller can measure latency. Returns the number of frames.
+int ghostReceive(GhostLink& link, GhostJitterBuffer& buffer, void (*onFrame)(const GhostFrame& frame));
+
+// Microseconds on a clock shared by processes on the same machine
+unsigned ghostClockMicros();
+
+#endif
@@ -0,0 +1,332 @@
+#include "levelgen.h"
+#include <cmath>
+
+const float UNREACHED = 1e30f;
+const int REPAIR_PASSES = 64;
+const int CHAPTER_ATTEMPTS = 8;
+
+// Same generator as gameRand(), on a caller-owned state
+static int nextRand(unsigned& state) {
+    state = state * 1103515245u + 12345u;
+    return (int)((state >> 16) & 0x7fff);
+}
+
+void buildJumpArc(const LevelRules& rules, JumpArc& arc) {
+    float y = 0;
+    float vy = rules.jumpForce;
+    float z = 1.0f;
+
+    arc.height[0] = 0;
+    arc.vy[0] = vy;
+    arc.zRemaining[0] = 1.0f;
+    arc.apex = 0;
+    arc.apexTick = 0;
+
+    int ticks = rules.maxAirTicks < JUMP_ARC_MAX_TICKS ? rules.maxAirTicks : JUMP_ARC_MAX_TICKS;
+    for (int t = 1; t <= ticks; t++) {
+        // stepPlayer(): lighter gravity on the way up, then move
+        vy -= vy > 0 ? rules.gravity * 0.85f : rules.gravity;
+        y += vy;
+        z *= 0.98f;
+
+        arc.height[t] = y;
+        arc.vy[t] = vy;
+        arc.zRemaining[t] = z;
+        if (y > arc.apex) {
+            arc.apex = y;
+            arc.apexTick = t;
+        }
+    }
+    arc.ticks = ticks;
+
+    // Past the apex heights only fall, so the ticks below a height are a
+    // run to the end that starts earlier the higher the height
+    int first = ticks + 1;
+    for (int i = 0; i < JUMP_LANDING_HEIGHTS; i++) {
+        float top = i - JUMP_LANDING_BELOW + 20;
+        while (first - 1 > arc.apexTick && arc.height[first - 1] < top) first--;
+        arc.landing[i] = (short)first;
+    }
+}
+
+unsigned chapterSeed(unsigned levelSeed, int level) {
+    unsigned h = levelSeed ^ ((unsigned)level * 0x9e3779b9u);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+int chapterPlanetCount(const LevelRules& rules, int level) {
+    return rules.planetsPerLevel * level + 2;
+}
+
+void generateChapter(const LevelRules& rules, unsigned seed, int level, PlanetSpec* planets) {
+    int totalPlanets = rules.planetsPerLevel * level;
+    unsigned state = seed;
+
+    PlanetSpec first = {0, 50, 0, 120, 60, 0};
+    planets[0] = first;
+
+    for (int i = 0; i < totalPlanets; i++) {
+        PlanetSpec& p = planets[i + 1];
+        p.x = (nextRand(state) % 300) - 150;
+        p.y = 100 + i * 70;
+        p.z = (nextRand(state) % (int)(rules.zRange * 1.5f)) - (rules.zRange * 0.75f);
+
+        p.width = 50 + nextRand(state) % 40;
+        p.depth = 35 + nextRand(state) % 25;
+
+        p.type = 0;
+        if (i % 12 == 3) p.type = 1;
+        else if (i % 15 == 7) p.type = 2;
+        else if (i % 18 == 11) p.type = 3;
+
+        if (i >= rules.planetsPerLevel) {
+            int levelNum = (i / rules.planetsPerLevel) + 1;
+            p.width -= levelNum * 1.5f;
+            p.depth -= levelNum * 1.0f;
+            p.y += levelNum * 4;
+
+            if (p.width < 25) p.width = 25;
+            if (p.depth < 20) p.depth = 20;
+        }
+    }
+
+    PlanetSpec last = {0, 100.0f + totalPlanets * 70, 0, 180, 90, 4};
+    planets[totalPlanets + 1] = last;
+}
+
+// First tick on the way down at which a player who jumped from height 0
+// is inside the landing band of a planet dy higher, or -1 if none within
+// the air time. The band matches resolvePlanetCollisions().
+static int landingTick(const JumpArc& arc, float dy) {
+    if (dy > arc.apex + 10) return -1;
+
+    // The first tick below the top of the band is no earlier than the
+    // table's for the next whole height; past the table, bisect for it
+    int lo;
+    int i = (int)floorf(dy) + JUMP_LANDING_BELOW + 1;
+    if (i >= 0 && i < JUMP_LANDING_HEIGHTS) {
+        lo = arc.landing[i];
+        while (lo <= arc.ticks && arc.height[lo] >= dy + 20) lo++;
+    } else {
+        lo = arc.apexTick + 1;
+        int hi = arc.ticks + 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (arc.height[mid] < dy + 20) hi = mid;
+            else lo = mid + 1;
+        }
+    }
+    if (lo > arc.ticks || arc.height[lo] <= dy - 10) return -1;
+    return lo;
+}
+
+// The jump against one chapter's scroll speed. With h' = height[t] -
+// scroll * t, the camera after tick t is
+// max(fromCamera, from.y - lead + max h') + scroll * t, so the running max
+// and min of h' in lead[] and fall[] make each jump O(1). Falling out
+// under a camera the jump itself dragged up does not depend on the planets
+// and is folded into lostTick.
+struct ScrollArc {
+    float scroll;
+    float lead[JUMP_ARC_MAX_TICKS + 1];
+    float fall[JUMP_ARC_MAX_TICKS + 1];
+    int lostTick;
+};
+
+static void buildScrollArc(const LevelRules& rules, const JumpArc& arc, int level, ScrollArc& out) {
+    out.scroll = rules.baseScrollSpeed + (level - 1) * rules.scrollPerLevel;
+    out.lead[0] = out.fall[0] = arc.height[0];
+    out.lostTick = arc.ticks;
+
+    // Landings are only checked up to lostTick, which only needs the
+    // tables up to the tick before it
+    for (int t = 1; t <= arc.ticks; t++) {
+        float h = arc.height[t] - out.scroll * t;
+        out.lead[t] = out.lead[t - 1] > h ? out.lead[t - 1] : h;
+        out.fall[t] = out.fall[t - 1] < h ? out.fall[t - 1] : h;
+        if (h < out.lead[t] - rules.cameraLead - 50) {
+            out.lostTick = t;
+            break;
+        }
+    }
+}
+
+// Camera height when a player who arrived on planet `from` with the camera
+// at fromCamera lands on planet `to`, or UNREACHED if the jump fails: too
+// far sideways, too long in the air, or the camera overtakes the player.
+static float jumpCamera(const LevelRules& rules, const JumpArc& arc, const ScrollArc& scroll,
+                        const PlanetSpec& from, const PlanetSpec& to, float fromCamera) {
+    int t = landingTick(arc, to.y - from.y);
+    if (t < 0 || t > scroll.lostTick) return UNREACHED;
+
+    float reach = rules.moveSpeed * rules.jumpBoost + rules.moveSpeed * (t - 1);
+    if (fabs(to.x - from.x) > reach + from.width / 2 + to.width / 2 + rules.landingMargin) return UNREACHED;
+    if (fabs(to.z - from.z) * arc.zRemaining[t] > from.depth / 2 + to.depth / 2 + rules.landingMargin) return UNREACHED;
+
+    // Falls 50 below a camera that was scrolling on its own
+    if (fromCamera - 50 > from.y + scroll.fall[t - 1]) return UNREACHED;
+
+    float pushed = from.y - rules.cameraLead + scroll.lead[t - 1];
+    float camera = (fromCamera > pushed ? fromCamera : pushed) + scroll.scroll * t;
+    if (to.y - rules.cameraLead > camera) camera = to.y - rules.cameraLead;
+    if (to.y < camera) return UNREACHED;
+    return camera;
+}
+
+const int NOT_QUEUED = -1;
+const int SEARCHED = -2;
+
+// The search's queue is a binary min-heap on camera height; slot[] tracks
+// each planet's place in it, so a planet reached lower moves up in place
+static void heapUp(const ChapterScratch& s, int pos) {
+    int planet = s.heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (s.camera[s.heap[parent]] <= s.camera[planet]) break;
+        s.heap[pos] = s.heap[parent];
+        s.slot[s.heap[pos]] = pos;
+        pos = parent;
+    }
+    s.heap[pos] = planet;
+    s.slot[planet] = pos;
+}
+
+static int heapPop(const ChapterScratch& s, int& size) {
+    int top = s.heap[0];
+    s.slot[top] = SEARCHED;
+    if (--size == 0) return top;
+
+    int planet = s.heap[size];
+    int pos = 0;
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= size) break;
+        if (child + 1 < size && s.camera[s.heap[child + 1]] < s.camera[s.heap[child]]) child++;
+        if (s.camera[s.heap[child]] >= s.camera[planet]) break;
+        s.heap[pos] = s.heap[child];
+        s.slot[s.heap[pos]] = pos;
+        pos = child;
+    }
+    s.heap[pos] = planet;
+    s.slot[planet] = pos;
+    return top;
+}
+
+// Lowest camera height at which each planet can be reached, by Dijkstra
+// over the jump graph: the camera never moves down, so arriving with a
+// lower camera is never worse. Stops once the final planet is settled;
+// the rest are only complete when it is unreachable.
+static void solveChapter(const LevelRules& rules, const JumpArc& arc, const ScrollArc& scroll,
+                        const PlanetSpec* planets, int count, const ChapterScratch& s) {
+    for (int i = 0; i < count; i++) {
+        s.camera[i] = UNREACHED;
+        s.slot[i] = NOT_QUEUED;
+    }
+    s.camera[0] = 0;
+    s.heap[0] = 0;
+    s.slot[0] = 0;
+    int queued = 1;
+    int low = 0;
+    float earliest = scroll.scroll * (arc.apexTick + 1);
+
+    while (queued > 0) {
+        int from = heapPop(s, queued);
+        if (from == count - 1) break;
+
+        // Planets are sorted by height and each one searched has a camera
+        // no lower than the last, so the planets within a jump are a window
+        // whose bottom only moves up
+        float camera = s.camera[from];
+        while (low < count && planets[low].y < camera) low++;
+        float top = planets[from].y + arc.apex + 10;
+        for (int to = low; to < count && planets[to].y <= top; to++) {
+            // No jump lands before the apex or leaves the camera lower than
+            // the planet itself does
+            float least = planets[to].y - rules.cameraLead;
+            if (least < camera + earliest) least = camera + earliest;
+            if (s.slot[to] == SEARCHED || s.camera[to] <= least) continue;
+            float c = jumpCamera(rules, arc, scroll, planets[from], planets[to], camera);
+            if (c < s.camera[to]) {
+                s.camera[to] = c;
+                if (s.slot[to] == NOT_QUEUED) s.heap[s.slot[to] = queued++] = to;
+                heapUp(s, s.slot[to]);
+            }
+        }
+    }
+}
+
+bool isChapterSolvable(const LevelRules& rules, const JumpArc& arc, int level,
+                       const PlanetSpec* planets, int count, const ChapterScratch& scratch) {
+    ScrollArc scroll;
+    buildScrollArc(rules, arc, level, scroll);
+
+    solveChapter(rules, arc, scroll, planets, count, scratch);
+    return scratch.camera[count - 1] < UNREACHED;
+}
+
+int repairChapter(const LevelRules& rules, const JumpArc& arc, int level,
+                  PlanetSpec* planets, int count, const ChapterScratch& scratch) {
+    float* camera = scratch.camera;
+    int moved = 0;
+    int lastMoved = -1;
+    ScrollArc scroll;
+    buildScrollArc(rules, arc, level, scroll);
+
+    for (int pass = 0; pass < REPAIR_PASSES; pass++) {
+        solveChapter(rules, arc, scroll, planets, count, scratch);
+        if (camera[count - 1] < UNREACHED) return moved;
+
+        int highest = 0;
+        for (int i = 1; i < count; i++) {
+            if (camera[i] < UNREACHED) highest = i;
+        }
+
+        // Pulling the same planet twice means distance is not the problem
+        int next = highest + 1;
+        if (next == lastMoved) return -1;
+
+        // Bring the next planet down to half the jump's height if it is
+        // out of reach above, which keeps it between its neighbours...
+        PlanetSpec& from = planets[highest];
+        PlanetSpec& to = planets[next];
+        if (to.y - from.y > arc.apex * 0.5f && landingTick(arc, to.y - from.y) < 0) {
+            to.y = from.y + arc.apex * 0.5f;
+        }
+        int t = landingTick(arc, to.y - from.y);
+        if (t < 0) return -1;
+
+        // ...then within half the sideways reach, and level its depth
+        float reach = (rules.moveSpeed * rules.jumpBoost + rules.moveSpeed * (t - 1)) * 0.5f;
+        float dx = to.x - from.x;
+        if (dx > reach) to.x = from.x + reach;
+        if (dx < -reach) to.x = from.x - reach;
+        to.z = from.z;
+
+        moved++;
+        lastMoved = next;
+    }
+    return -1;
+}
+
+ChapterStatus buildChapter(const LevelRules& rules, const JumpArc& arc, unsigned levelSeed, int level,
+                           PlanetSpec* planets, const ChapterScratch& scratch) {
+    int count = chapterPlanetCount(rules, level);
+    unsigned seed = chapterSeed(levelSeed, level);
+
+    for (int attempt = 0; attempt < CHAPTER_ATTEMPTS; attempt++) {
+        generateChapter(rules, seed, level, planets);
+        if (isChapterSolvable(rules, arc, level, planets, count, scratch)) {
+            return attempt == 0 ? CHAPTER_SOLVABLE : CHAPTER_REGENERATED;
+        }
+        if (repairChapter(rules, arc, level, planets, count, scratch) >= 0) {
+            return attempt == 0 ? CHAPTER_REPAIRED : CHAPTER_REGENERATED;
+        }
+        seed = chapterSeed(seed, attempt + 1);
+    }
+    return CHAPTER_UNSOLVABLE;
+}
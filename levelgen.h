@@ -0,0 +1,89 @@
+#ifndef LEVELGEN_H
+#define LEVELGEN_H
+
+// Chapter layout generation and reachability analysis. Everything here is
+// pure (no globals, explicit random state), so the seed validator can run
+// it on many threads at once.
+
+const int JUMP_ARC_MAX_TICKS = 256;
+const int JUMP_LANDING_BELOW = 512;       // landing ticks are tabulated for heights
+const int JUMP_LANDING_HEIGHTS = 1024;    // from this far below the take-off up
+
+// One planet of a generated chapter
+struct PlanetSpec {
+    float x, y, z;
+    float width, depth;
+    int type;
+};
+
+// Game constants the generator and the analysis depend on
+struct LevelRules {
+    int planetsPerLevel;
+    float zRange;
+    float gravity;
+    float jumpForce;
+    float moveSpeed;
+    float jumpBoost;
+    float baseScrollSpeed;
+    float scrollPerLevel;
+    float cameraLead;             // the camera keeps the player at most this far above it
+    float landingMargin;          // collision tolerance around a planet's footprint
+    int maxAirTicks;              // longer than this in the air and the player is lost
+};
+
+// Height and vertical speed after each tick of a jump, from the same
+// per-tick integration the game uses, plus how much of a z offset the
+// auto-adjust leaves after that many ticks
+struct JumpArc {
+    int ticks;
+    int apexTick;
+    float apex;
+    float height[JUMP_ARC_MAX_TICKS + 1];
+    float vy[JUMP_ARC_MAX_TICKS + 1];
+    float zRemaining[JUMP_ARC_MAX_TICKS + 1];
+    short landing[JUMP_LANDING_HEIGHTS];  // first tick past the apex below each whole height + 20
+};
+
+void buildJumpArc(const LevelRules& rules, JumpArc& arc);
+
+// Random stream of one chapter, derived from the session's level seed so
+// every chapter of a seed is fixed regardless of how it was played
+unsigned chapterSeed(unsigned levelSeed, int level);
+int chapterPlanetCount(const LevelRules& rules, int level);
+void generateChapter(const LevelRules& rules, unsigned seed, int level, PlanetSpec* planets);
+
+// Working memory of the reachability analysis, one entry per planet in
+// each array
+struct ChapterScratch {
+    float* camera;                // lowest camera height the planet is reached at
+    int* heap;                    // planets still to search from, lowest camera first
+    int* slot;                    // where each planet is in heap
+};
+
+// Whether the final planet can be reached from the first by a chain of
+// jumps that each land before the camera scroll catches up
+bool isChapterSolvable(const LevelRules& rules, const JumpArc& arc, int level,
+                       const PlanetSpec* planets, int count, const ChapterScratch& scratch);
+
+// Pull planets in above the highest reachable one, sideways or down, until
+// the chapter is solvable. Returns the number of planets moved, or -1 if
+// it gave up.
+int repairChapter(const LevelRules& rules, const JumpArc& arc, int level,
+                  PlanetSpec* planets, int count, const ChapterScratch& scratch);
+
+// How a chapter's final layout came about
+enum ChapterStatus {
+    CHAPTER_SOLVABLE = 0,         // as generated
+    CHAPTER_REPAIRED,             // after pulling some planets in
+    CHAPTER_REGENERATED,          // from a fallback seed of the chapter
+    CHAPTER_UNSOLVABLE,           // nothing worked; the last attempt is kept
+    CHAPTER_STATUSES
+};
+
+// Generate a chapter from the level seed, check it and repair or
+// regenerate it until it is solvable. planets needs chapterPlanetCount()
+// entries.
+ChapterStatus buildChapter(const LevelRules& rules, const JumpArc& arc, unsigned levelSeed, int level,
+                           PlanetSpec* planets, const ChapterScratch& scratch);
+
+#endif
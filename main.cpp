@@ -1,11 +1,31 @@
 #include <GL/glut.h>
 #include <cstdlib>
+#include <cstdio>
 #include <ctime>
 #include <cmath>
 #include <vector>
 #include <string>
-#include <sstream>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include "renderer.h"
+#include "geometry_tables.h"
+#include "entities.h"
+#include "arena.h"
+#include "snapshot.h"
+#include "ghostnet.h"
+#include "telemetry.h"
+#include "audio.h"
+#include "levelgen.h"
+#include "transform.h"
+#include "overdraw.h"
+#include "alloctrack.h"
+#include "worker.h"
+#include "starfield.h"
+#include "drawlist.h"
 
 // Game Constants
 const int WINDOW_WIDTH = 640;
@@ -17,95 +37,134 @@ const float JUMP_BOOST = 1.3f;
 const int PLANETS_PER_LEVEL = 20;
 const int MAX_LEVELS = 5;
 const int POINTS_PER_PLANET = 10;
+const int MAX_PLAYERS = 512;
+const float BOT_JUMP_REACH = 280.0f;   // jump apex is about 300 above the take-off planet
 const int LEVEL_COMPLETION_BONUS = 500;
 const float BASE_SCROLL_SPEED = 1.2f;    // Faster base speed!
 const float SPEED_MULTIPLIER = 0.6f;     // More dramatic speed increases!
 const int PLANETS_FOR_BONUS = 10;
 const int EXPLORATION_BONUS = 50;
+const int COMBO_SOUND_STEP = 5;          // a combo sound every this many landings in a row
 
 // 3D and Space Constants
-const int NUM_STARS = 200;
 const int NUM_SHOOTING_STARS = 8;
 const int NUM_ROSE_PETALS = 15;
 const int NUM_STARDUST = 30;
+const int NEBULA_CLOUDS = 5;
+const float DECORATION_REGION_HEIGHT = 1000.0f;
+const int DECORATION_REGIONS = 3;         // streamed in at once, starting just below the view
+const int ROSES_PER_REGION = 8;
+const int FOXES_PER_REGION = 5;
+const float DECORATION_SPIN = 0.3f;       // degrees per tick for roses and foxes
+const int MAX_DECORATION_MULTIPLIER = 100;
+const int IMPOSTOR_ANGLES = 8;            // views baked per decoration around the vertical axis
+const int IMPOSTOR_CELL = 64;             // atlas cell size in pixels
+const float IMPOSTOR_DISTANCE = 300.0f;   // decorations farther from the camera are drawn as impostors
+const int IMPOSTOR_NEAR_BUDGET = 32;      // real geometry for at most this many decorations of a kind
+const unsigned ALLOCATION_WARMUP_FRAMES = 60;   // frames and ticks that may still fill caches
+const unsigned ALLOCATION_WARMUP_TICKS = 60;
+const float PLANET_SPIN = 0.08f;          // degrees per tick, drawn at a tenth for the body
+const float SCARF_WAVE_SPEED = 7.5f;      // radians of scarf sway per second of game time
 const float CAMERA_DISTANCE = 250.0f;
 const float CAMERA_HEIGHT_OFFSET = 150.0f;
 const float PLATFORM_Z_RANGE = 30.0f;
 
-// Star Structure for background
-struct Star {
-    float x, y, z;
-    float brightness;
-    Star(float _x, float _y, float _z, float _brightness) : x(_x), y(_y), z(_z), brightness(_brightness) {}
+// Quality governor
+const float DEFAULT_FRAME_BUDGET_MS = 16.6f;
+const int GOVERNOR_WINDOW_FRAMES = 30;       // frames averaged per decision
+const float GOVERNOR_RESTORE_RATIO = 0.7f;   // restore only when well under budget
+const int GOVERNOR_CALM_WINDOWS = 3;         // consecutive calm windows before restoring
+const int QUALITY_KNOB_COUNT = 5;
+const int QUALITY_MAX_STEPS = 4;
+
+// Input
+const int INPUT_QUEUE_SIZE = 64;
+const int LATENCY_SAMPLES = 512;
+
+// Arenas
+const size_t LEVEL_ARENA_CHUNK = 64 * 1024;
+const size_t WORLD_ARENA_CHUNK = 64 * 1024;
+
+// Rewind
+const int REWIND_SECONDS = 10;
+const int REWIND_FRAMES = REWIND_SECONDS * 1000 / 16;   // one snapshot per 16 ms tick
+const int REWIND_KEYFRAME_INTERVAL = 60;
+
+// Draw lists
+const int MAX_DRAW_THREADS = 8;
+const int PLANET_TYPES = 5;               // plain, rosy, crate, well, home, as levelgen deals them out
+
+// Quality knobs scaled by the frame-time governor
+enum QualityKnob {
+    KNOB_RENDER_SCALE = 0,
+    KNOB_NEBULA,
+    KNOB_PARTICLES,
+    KNOB_TESSELLATION,
+    KNOB_DRAW_DISTANCE
 };
 
-// Shooting Star Structure for magical effects
-struct ShootingStar {
-    float x, y, z;
-    float vx, vy, vz;
-    float life;
-    float maxLife;
-    ShootingStar(float _x, float _y, float _z) : x(_x), y(_y), z(_z), life(100), maxLife(100) {
-        vx = (rand() % 100 - 50) / 10.0f;
-        vy = -(rand() % 30 + 20) / 5.0f;
-        vz = (rand() % 40 - 20) / 10.0f;
-    }
+// One row per knob: name, number of steps and the value at each step (full quality first)
+struct QualityKnobSteps {
+    const char* name;
+    int steps;
+    float values[QUALITY_MAX_STEPS];
 };
 
-// Rose Petal Structure for romantic atmosphere
-struct RosePetal {
-    float x, y, z;
-    float vx, vy, vz;
-    float rotation;
-    float rotSpeed;
-    float scale;
-    RosePetal(float _x, float _y, float _z) : x(_x), y(_y), z(_z), rotation(0) {
-        vx = (rand() % 20 - 10) / 20.0f;
-        vy = -(rand() % 10 + 5) / 20.0f;
-        vz = (rand() % 20 - 10) / 20.0f;
-        rotSpeed = (rand() % 100 + 50) / 100.0f;
-        scale = 0.5f + (rand() % 50) / 100.0f;
-    }
+const QualityKnobSteps QUALITY_KNOBS[QUALITY_KNOB_COUNT] = {
+    {"render scale percent", 4, {100, 85, 70, 50}},
+    {"nebula puffs", 4, {8, 6, 4, 2}},
+    {"particle percent", 4, {100, 75, 50, 25}},
+    {"tessellation percent", 3, {100, 75, 50}},
+    {"decoration distance", 3, {600, 450, 300}}
 };
 
-// Stardust Structure for magical particles
-struct Stardust {
-    float x, y, z;
-    float vx, vy, vz;
-    float brightness;
-    float pulse;
-    Stardust(float _x, float _y, float _z) : x(_x), y(_y), z(_z), pulse(0) {
-        vx = (rand() % 30 - 15) / 30.0f;
-        vy = -(rand() % 20 + 10) / 30.0f;
-        vz = (rand() % 30 - 15) / 30.0f;
-        brightness = 0.3f + (rand() % 70) / 100.0f;
-    }
+// Current values of the knobs, read by the update and draw code
+struct QualitySettings {
+    int renderScalePercent;       // of the window's size in each direction, for the 3D scene
+    int nebulaPuffs;
+    int particlePercent;
+    int tessellationPercent;
+    float decorationDistance;
+
+    QualitySettings() : renderScalePercent(100), nebulaPuffs(8), particlePercent(100), tessellationPercent(100), decorationDistance(600) {}
 };
 
-// Planet Structure (Little Prince's planets)
-struct Planet {
-    float x, y, z;
-    float width, depth;
-    float rotation;
-    int planetType;  // 0=normal, 1=rose planet, 2=fox planet, 3=king planet, etc.
+// Frame-time governor state. Knobs are degraded round-robin and restored in
+// reverse order, so the history doubles as an undo stack.
+struct QualityGovernor {
+    int knobStep[QUALITY_KNOB_COUNT];
+    std::vector<int> history;
+    int nextKnob;
+    double windowTime;
+    int windowFrames;
+    int calmWindows;
+
+    QualityGovernor() : nextKnob(0), windowTime(0), windowFrames(0), calmWindows(0) {
+        for (int i = 0; i < QUALITY_KNOB_COUNT; i++) knobStep[i] = 0;
+    }
+};
 
-    Planet(float _x, float _y, float _z, float _width, float _depth, int _type = 0)
-        : x(_x), y(_y), z(_z), width(_width), depth(_depth), rotation(0), planetType(_type) {}
+// Game actions bound to keys
+enum InputAction {
+    INPUT_LEFT = 0,
+    INPUT_RIGHT,
+    INPUT_JUMP
 };
 
-// Rose Structure for decoration
-struct Rose {
-    float x, y, z;
-    float scale;
-    float rotation;
-    Rose(float _x, float _y, float _z) : x(_x), y(_y), z(_z), scale(1.0f), rotation(0) {}
+// Press or release, stamped when GLUT delivered it
+struct InputEvent {
+    int action;
+    bool pressed;
+    double time;   // milliseconds on the steady clock, see nowMs()
 };
 
-// Fox Structure for decoration
-struct Fox {
-    float x, y, z;
-    float rotation;
-    Fox(float _x, float _y, float _z) : x(_x), y(_y), z(_z), rotation(0) {}
+// Ring of the most recent latency measurements
+struct LatencySamples {
+    double samples[LATENCY_SAMPLES];
+    int count;
+    int next;
+
+    LatencySamples() : count(0), next(0) {}
 };
 
 // Player Structure (The Little Prince)
@@ -120,43 +179,321 @@ struct Player {
     int comboTimer;
     float rotation;
     float bobOffset;
-    float scarfWave;
     float timeInSpace;
     bool driftingIntoSpace;
+    bool alive;
+    int score;
 
     Player() : x(0), y(0), z(0), vx(0), vy(0), onGround(true), jumpCount(0),
                lastPlanetIndex(0), planetsExplored(0), combo(0), comboTimer(0),
-               rotation(0), bobOffset(0), scarfWave(0), timeInSpace(0), driftingIntoSpace(false) {}
+               rotation(0), bobOffset(0), timeInSpace(0), driftingIntoSpace(false),
+               alive(true), score(0) {}
+};
+
+// What a player wants to do this tick, from the keyboard or a bot
+struct PlayerControls {
+    bool left;
+    bool right;
+    bool jump;
+};
+
+// Animated part groups of the baked character mesh
+enum MeshPartKind {
+    PART_STATIC = 0,
+    PART_HAIR_CURL,
+    PART_SCARF,
+    PART_SCARF_TAIL,
+    PART_AURA
+};
+
+// Contiguous vertex range of one part group
+struct MeshPart {
+    int kind;
+    int index;
+    int first;
+    int count;
+    int node;                 // animated joint in princeRig, -1 for static parts
+    MeshPart(int _kind, int _index, int _first, int _count)
+        : kind(_kind), index(_index), first(_first), count(_count), node(-1) {}
+};
+
+enum ImpostorKind {
+    IMPOSTOR_ROSE = 0,
+    IMPOSTOR_FOX,
+    IMPOSTOR_KINDS
+};
+
+// Decoration views baked into one texture, a row per kind and a column per
+// angle. Each cell is a square centred centerY above the entity's origin.
+struct ImpostorAtlas {
+    GLuint texture;
+    float centerY[IMPOSTOR_KINDS];
+    float halfSize[IMPOSTOR_KINDS];
+    long long sprites;            // drawn as impostors, summed over frames
+    long long meshes;             // drawn as real geometry
+    int frames;
+
+    ImpostorAtlas() : texture(0), sprites(0), meshes(0), frames(0) {
+        centerY[IMPOSTOR_ROSE] = 1.65f;
+        halfSize[IMPOSTOR_ROSE] = 9.5f;
+        centerY[IMPOSTOR_FOX] = 1.0f;
+        halfSize[IMPOSTOR_FOX] = 7.5f;
+    }
+};
+
+// The 3D scene under the game over text. Nothing moves there until a key
+// is pressed, so the scene is drawn once, captured, and idle frames only
+// draw the capture back and redraw the text while the tick loop sleeps.
+struct IdleScreen {
+    GLuint texture;
+    int tick;                     // simulationTick the scene was captured at, -1 for none
+    int width, height;
+    int backend;
+    bool sleeping;                // no tick is scheduled until the next key press
+    long long captures;
+    long long frames;             // drawn from the capture
+
+    IdleScreen() : texture(0), tick(-1), width(0), height(0), backend(-1), sleeping(false), captures(0), frames(0) {}
+};
+
+// A visible decoration and how far it is from the camera
+struct DecorationDraw {
+    float distance;
+    int row;
+};
+
+// Entity state a rig block was posed from; any change re-poses it
+struct RigKey {
+    float x, y, z;
+    float angle;
+    float size;
+    int kind;
+};
+
+// Cached part transforms for the rows of one entity table, a fixed-size
+// block of nodes per row with the entity's root first
+struct EntityRig {
+    TransformTree tree;
+    std::vector<RigKey> keys;
+    int nodesPerEntity;
+    void (*build)(TransformTree& tree, int root);
+    void (*pose)(TransformTree& tree, int root, const RigKey& key);
+};
+
+// The next chapter, built on the chapter worker while the current one is
+// played and swapped in when it is reached. The worker owns everything
+// but the statistics from submitJob() until workerIdle().
+struct ChapterPrefetch {
+    int level;                    // 0 when nothing is prefetched
+    unsigned seed;
+    Arena* arena;                 // the level arena planets are not in
+    ArchetypeTable planets;
+    TransformTree rig;            // planet rig for those rows, ready to swap in
+    std::vector<RigKey> keys;
+    ChapterStatus status;
+    double buildMs;
+
+    int swapped;                  // transitions served by a prefetched chapter
+    int builtInPlace;             // transitions that had to build the chapter themselves
+    double prefetchMs;            // worker time for the swapped chapters
+    double worstSwapUs;
+    double worstBuildUs;
+
+    ChapterPrefetch() : level(0), seed(0), arena(0), status(CHAPTER_SOLVABLE), buildMs(0),
+                        swapped(0), builtInPlace(0), prefetchMs(0), worstSwapUs(0), worstBuildUs(0) {}
+};
+
+// Character baked once into a single vertex array. Animated parts are
+// stored in part space and re-posed into posedVertices each draw.
+struct CharacterMesh {
+    std::vector<MeshVertex> baseVertices;
+    std::vector<MeshVertex> posedVertices;
+    std::vector<MeshPart> parts;
+    int groundedVertexCount;  // cape and aura come after this and are only drawn while jumping
+
+    CharacterMesh() : groundedVertexCount(0) {}
+};
+
+// The scene's subsystems, each recorded into its own draw list and
+// submitted in this order
+enum SceneList {
+    LIST_NEBULA = 0,
+    LIST_STARS,
+    LIST_SHOOTING_STARS,
+    LIST_STARDUST,
+    LIST_ROSE_PETALS,
+    LIST_DECORATIONS,
+    LIST_PLANETS,
+    SCENE_LISTS
+};
+
+// Every frame the helpers and the GL thread each claim the next unbuilt
+// list until none are left; the GL thread then submits them. The helpers
+// own the lists, and the rigs and caches they are built from, from
+// startSceneLists() until finishSceneLists() returns.
+struct SceneLists {
+    DrawList lists[SCENE_LISTS];
+    Mat4 view;                        // the camera's, shared by every list
+    int threads;                      // the GL thread included
+    BackgroundWorker workers[MAX_DRAW_THREADS - 1];
+    AllocationShare shares[MAX_DRAW_THREADS - 1];   // each helper's allocations, counted towards the frame
+    std::atomic<int> nextList;
+
+    // Totals since the last report
+    unsigned frames;
+    double buildMs;                   // summed over the threads
+    double waitMs;                    // GL thread waiting for helpers
+    double submitMs;
+
+    SceneLists() : threads(1), nextList(0), frames(0), buildMs(0), waitMs(0), submitMs(0) {}
+};
+
+// Stored meshes the planets are drawn from, each baked in the frame of the
+// rig node its instances are placed at
+enum PlanetMesh {
+    PLANET_MESH_BODY = 0,             // unit sphere in the type's colour, scaled to the planet
+    PLANET_MESH_ROSE,                 // stem and bloom
+    PLANET_MESH_PETALS,               // the six petals
+    PLANET_MESH_DOME,                 // glass dome and its base ring, blended
+    PLANET_MESH_DECORATION,           // crate or well: a unit cube in its colour
+    PLANET_MESH_HOME_ROSE,            // the home planet's three extra roses,
+    PLANET_MESH_HOME_DOME,            // and their domes, blended
+    PLANET_MESHES
+};
+
+// A planet in view, posed and grouped by type for its type's batches
+struct PlanetInView {
+    const TransformNode* parts;
+    float width;
+};
+
+// Planets are drawn one instanced batch per part and type rather than one
+// draw per part and planet. The meshes are rebaked on the GL thread when
+// the tessellation changes; the ids stay the same.
+struct PlanetBatches {
+    int mesh[PLANET_TYPES][PLANET_MESHES];   // 0 where a type has no such part
+    int tessellation;                        // percent the meshes were baked at, 0 before the first bake
+    std::vector<PlanetInView> inView[PLANET_TYPES];
+
+    // Totals since the last report
+    unsigned frames;
+    unsigned long long planets;
+    unsigned long long draws;
+
+    PlanetBatches() : tessellation(0), frames(0), planets(0), draws(0) {
+        for (int t = 0; t < PLANET_TYPES; t++)
+            for (int m = 0; m < PLANET_MESHES; m++) mesh[t][m] = 0;
+    }
 };
 
 // Game Variables
 bool gameRunning = false;
-Player player;
-std::vector<Planet> planets;
-std::vector<Star> stars;
-std::vector<Rose> roses;
-std::vector<Fox> foxes;
-std::vector<ShootingStar> shootingStars;
-std::vector<RosePetal> rosePetals;
-std::vector<Stardust> stardust;
+Player players[MAX_PLAYERS];
+Player& player = players[0];     // the local player; the camera and HUD follow it
+int playerCount = 1;
+int humanPlayers = 1;            // players 0..humanPlayers-1 use the keyboard, the rest are bots
+int collisionOrder[MAX_PLAYERS];
+bool headless = false;
+int headlessTicks = 60000;
+int validateSeeds = 0;            // check this many level seeds and exit
+int validatorThreads = 0;         // 0: one per core
+int ghostListenPort = 0;          // receive and draw ghosts from another instance
+int ghostSendPort = 0;            // stream this instance's princes to another one
+GhostLink ghostLink;
+GhostJitterBuffer ghostBuffer;
+GhostFrame ghostView;             // interpolated ghosts for the current frame
+static_assert(GHOST_MAX_PLAYERS >= MAX_PLAYERS, "ghost frames must carry every prince");
+bool ghostViewValid = false;
+double lastGhostSampleMs = 0;
+LatencySamples ghostNetworkLatency;   // send to receive
+LatencySamples ghostDisplayLatency;   // send to drawn, including the jitter buffer
+EntityStore world;
+Arena levelArenas[2];             // the current chapter's planets and the next one's, swapping roles
+int activeLevelArena = 0;         // the one planets live in
+Arena worldArena;                 // decorations and particles, reset when the simulation starts
+unsigned entityHeapBaseline = 0;  // heap allocations for entity data when play began
+ArchetypeTable& planets = world.tables[ARCH_PLANET];
+ArchetypeTable& roses = world.tables[ARCH_ROSE];
+ArchetypeTable& foxes = world.tables[ARCH_FOX];
+ArchetypeTable& shootingStars = world.tables[ARCH_SHOOTING_STAR];
+ArchetypeTable& rosePetals = world.tables[ARCH_ROSE_PETAL];
+ArchetypeTable& stardust = world.tables[ARCH_STARDUST];
+StarField starField;
 float cameraY = 0;
-int score = 0;
 int highScore = 0;
 int currentLevel = 1;
 bool leftKey = false;
 bool rightKey = false;
-bool spaceKey = false;
-bool spaceKeyWasPressed = false;
+bool jumpRequested = false;
+InputEvent inputQueue[INPUT_QUEUE_SIZE];
+int inputQueueHead = 0;
+int inputQueueCount = 0;
+double pendingPresentTimes[INPUT_QUEUE_SIZE];   // events consumed but not yet on screen
+int pendingPresentCount = 0;
+LatencySamples inputToSimulation;
+LatencySamples inputToPresent;
 float gameTime = 0;
 float currentScrollSpeed = BASE_SCROLL_SPEED;
 int planetsVisited = 0;
 int totalPlanetsExplored = 0;
 float explorationBoostTimer = 0;
+CharacterMesh princeMesh;
+ImpostorAtlas impostors;
+IdleScreen idleScreen;
+std::vector<DecorationDraw> decorationDraws;     // scratch, reused every frame
+SceneLists sceneLists;
+PlanetBatches planetBatches;
+int drawThreads = 0;              // --draw-threads=<n>, 0: one per core up to one per list
+Position cameraEye = {0, 0, 0};
+int decorationMultiplier = 1;     // --decorations=<n> scales rose and fox counts
+int decorationRegions[DECORATION_REGIONS];     // region held by each slot of rows, -1 for none
+unsigned long long decorationRegionsStreamed = 0;
+TransformTree princeRig;
+ChapterPrefetch nextChapter;
+BackgroundWorker chapterWorker;
+OverdrawProfiler overdraw;        // 'O' or --overdraw shows the heatmap
+AllocationPeriod frameAllocations("frame", ALLOCATION_WARMUP_FRAMES);
+AllocationPeriod tickAllocations("tick", ALLOCATION_WARMUP_TICKS);
+bool checkAllocations = false;    // --check-allocations: fail if steady-state frames or ticks allocate
+int requestedBackend = RENDER_LEGACY;
+int windowWidth = WINDOW_WIDTH;    // as last reshaped
+int windowHeight = WINDOW_HEIGHT;
+bool softwareRun = false;          // --software: draw into memory with the CPU rasterizer, no window
+int rasterThreads = 0;             // 0: try 1, 2, 4... up to one per core
+int softwareFrames = 300;
+std::string frameDumpPath;
+double backendFrameTime = 0;   // accumulated display() milliseconds on the active backend
+int backendFrameCount = 0;
+int scaledFrames = 0;             // of those, drawn at a reduced resolution
+QualitySettings quality;
+QualityGovernor governor;
+float frameBudgetMs = DEFAULT_FRAME_BUDGET_MS;
+int fixedRenderScale = 0;         // --render-scale=<percent>, 0 leaves it to the governor
+GLuint sceneTexture = 0;          // the scene at a reduced resolution, before upscaling
+unsigned int randomState = 1;
+unsigned int levelSeed = 1;    // chapter layouts, fixed for the session
+LevelRules levelRules;
+JumpArc jumpArc;
+int simulationTick = 0;
+RewindBuffer rewindBuffer;
+Snapshot tickState;            // scratch for capturing and restoring ticks
+Snapshot quickSave;
+bool rewindHeld = false;
+double rewindCaptureTime = 0;  // accumulated microseconds spent snapshotting
+int rewindCaptureCount = 0;
+double rewindRestoreTime = 0;
+int rewindRestoreCount = 0;
+std::ofstream stateTrace;
 
 // Function Prototypes
 void init();
 void display();
+void drawScene();
+void drawScaledScene();
+void captureIdleScene();
+bool screenIsIdle();
 void update(int);
+void stepSimulation();
 void keyPressed(unsigned char, int, int);
 void keyReleased(unsigned char, int, int);
 void specialKeyPressed(int, int, int);
@@ -164,908 +501,1667 @@ void specialKeyReleased(int, int, int);
 void reshape(int, int);
 void drawText(float, float, const char*);
 void createPlanets();
-void createStars();
-void createRoses();
-void createFoxes();
+void prefetchChapter(int level);
+void stopChapterWorker();
+void reportPrefetchStats();
+void createDecorations();
+void streamDecorations();
 void createShootingStars();
 void createRosePetals();
 void createStardust();
 void resetGame();
-void advanceToNextLevel();
-void addPoints(int points, float x, float y);
-void updateCombo();
+void advanceToNextLevel(Player& finisher);
+void addPoints(Player& p, int points, float x, float y);
+void updateCombo(Player& p);
 bool isPlanetVisible(int planetIndex);
+void buildPrinceMesh();
+void posePrinceMesh(const Player& p, float scarfWave);
+void drawPrinceCharacter(const Player& p, float scarfWave);
 void drawLittlePrince();
-void drawPlanet(const Planet& planet);
 void drawBackground();
 void setupLighting();
-void drawStars();
-void drawRoses();
-void drawFoxes();
-void drawShootingStars();
-void drawRosePetals();
-void drawStardust();
+void reportBackendFrameTime();
+void applyQualitySettings();
+void governorRecordFrame(double frameMs);
+size_t activeParticles(size_t total);
+void toggleRenderBackend();
+void wakeFromIdle();
+void reportIdleStats();
+void toggleOverdraw();
+void drawOverdrawReport();
+double nowMs();
+void queueInput(int action, bool pressed);
+void consumeInputEvents(bool& leftTapped, bool& rightTapped);
+void recordLatency(LatencySamples& samples, double ms);
+void reportInputLatency();
+void setSceneListThreads(int threads);
+void stopSceneListThreads();
+void reserveSceneLists();
+void startSceneLists(const Mat4& view);
+void finishSceneLists();
+void submitSceneList(int list);
+void reportSceneListStats();
+void bakePlanetMeshes();
+void reportPlanetBatchStats();
 void updateAtmosphericEffects();
 float getCurrentScrollSpeed();
 void checkExplorationBonus();
 void updateSpeedEffects();
+void seedRandom(unsigned int seed);
+int gameRand();
+void saveGameState(Snapshot& out);
+void loadGameState(const Snapshot& in);
+void recordRewindFrame();
+bool rewindOneTick();
+void reportRewindStats();
+void reportTransformStats();
+void buildImpostorAtlas();
+void reportImpostorStats();
+void initSimulation();
+void spawnPlayer(Player& p, int index);
+PlayerControls botControls(const Player& p, int index);
+void stepPlayer(Player& p, const PlayerControls& controls);
+void resolvePlanetCollisions();
+void landOnPlanet(Player& p, size_t planet);
+bool isCountedPlayer(int index);
+void drawGhosts();
+int runHeadless();
+void startGhostLink();
+void sendGhostFrame();
+void receiveGhostFrames();
+void drawRemoteGhosts();
+void reportGhostStats();
+void reportArenaStats();
+void stopTelemetry();
+void stopAudio();
+unsigned entityHeapAllocations();
+void initLevelRules();
+int runSeedValidator();
+int reportAllocations();
+int runSoftware();
 
 // Initialize lighting
 void setupLighting() {
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_COLOR_MATERIAL);
-    glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+    rEnable(GL_LIGHTING);
+    rEnable(GL_LIGHT0);
+    rEnable(GL_COLOR_MATERIAL);
 
     GLfloat ambient[] = {0.2f, 0.2f, 0.3f, 1.0f};
-    glLightfv(GL_LIGHT0, GL_AMBIENT, ambient);
-
     GLfloat diffuse[] = {0.8f, 0.8f, 1.0f, 1.0f};
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse);
-
     GLfloat position[] = {0.0f, 1000.0f, 200.0f, 1.0f};
-    glLightfv(GL_LIGHT0, GL_POSITION, position);
+    rLight(ambient, diffuse, position);
 }
 
-// Create stars for background
-void createStars() {
-    stars.clear();
-    for (int i = 0; i < NUM_STARS; i++) {
-        float x = (rand() % 2000) - 1000;
-        float y = (rand() % 4000) - 500;
-        float z = (rand() % 1000) - 500;
-        float brightness = 0.3f + (rand() % 100) / 100.0f * 0.7f;
-        stars.push_back(Star(x, y, z, brightness));
+// Rows for the roses and foxes of DECORATION_REGIONS regions. What they
+// show is filled in by streamDecorations() as the camera climbs.
+void createDecorations() {
+    int roseCount = ROSES_PER_REGION * decorationMultiplier * DECORATION_REGIONS;
+    clearTable(roses);
+    reserveTable(roses, roseCount);
+    for (int i = 0; i < roseCount; i++) {
+        EntityDesc rose(0, 0, 0);
+        rose.spin.speed = DECORATION_SPIN;
+        spawnEntity(roses, rose);
     }
+
+    int foxCount = FOXES_PER_REGION * decorationMultiplier * DECORATION_REGIONS;
+    clearTable(foxes);
+    reserveTable(foxes, foxCount);
+    for (int i = 0; i < foxCount; i++) {
+        EntityDesc fox(0, 0, 0);
+        fox.spin.speed = DECORATION_SPIN;
+        spawnEntity(foxes, fox);
+    }
+
+    for (int i = 0; i < DECORATION_REGIONS; i++) decorationRegions[i] = -1;
+}
+
+static int regionRand(unsigned& state) {
+    state = state * 1103515245u + 12345u;
+    return (int)((state >> 16) & 0x7fff);
 }
 
-// Create roses for Little Prince decoration
-void createRoses() {
-    roses.clear();
-    for (int i = 0; i < 15; i++) {
-        float x = (rand() % 800) - 400;
-        float y = 200 + (rand() % 2000);
-        float z = (rand() % 200) - 100;
-        roses.push_back(Rose(x, y, z));
+// Place one region's roses and foxes in a slot's rows. Each region of each
+// chapter has its own random stream, so it looks the same every time it
+// is streamed in.
+static void fillDecorationRegion(int slot, int region) {
+    unsigned state = chapterSeed(chapterSeed(levelSeed, currentLevel), region);
+    float bottom = region * DECORATION_REGION_HEIGHT;
+    int height = (int)DECORATION_REGION_HEIGHT;
+
+    int roseRows = ROSES_PER_REGION * decorationMultiplier;
+    for (int i = slot * roseRows; i < (slot + 1) * roseRows; i++) {
+        Position& p = roses.position[i];
+        p.x = (regionRand(state) % 800) - 400;
+        p.y = bottom + (regionRand(state) % height);
+        p.z = (regionRand(state) % 200) - 100;
+        roses.spin[i].angle = 0;
+    }
+
+    int foxRows = FOXES_PER_REGION * decorationMultiplier;
+    for (int i = slot * foxRows; i < (slot + 1) * foxRows; i++) {
+        Position& p = foxes.position[i];
+        p.x = (regionRand(state) % 600) - 300;
+        p.y = bottom + (regionRand(state) % height);
+        p.z = (regionRand(state) % 150) - 75;
+        foxes.spin[i].angle = 0;
     }
+
+    decorationRegions[slot] = region;
+    decorationRegionsStreamed++;
 }
 
-// Create foxes for Little Prince decoration
-void createFoxes() {
-    foxes.clear();
-    for (int i = 0; i < 8; i++) {
-        float x = (rand() % 600) - 300;
-        float y = 150 + (rand() % 1500);
-        float z = (rand() % 150) - 75;
-        foxes.push_back(Fox(x, y, z));
+// Keep the region just below the view and the ones above it in the rows,
+// reusing the slot of a region once the camera has left it behind. Region
+// r always lives in slot r % DECORATION_REGIONS, so only regions that just
+// came into range are filled.
+void streamDecorations() {
+    int first = std::max(0, (int)std::floor((cameraY - 100) / DECORATION_REGION_HEIGHT));
+    for (int region = first; region < first + DECORATION_REGIONS; region++) {
+        int slot = region % DECORATION_REGIONS;
+        if (decorationRegions[slot] != region) fillDecorationRegion(slot, region);
     }
 }
 
 // Create magical shooting stars
 void createShootingStars() {
-    shootingStars.clear();
+    clearTable(shootingStars);
+    reserveTable(shootingStars, NUM_SHOOTING_STARS);
     for (int i = 0; i < NUM_SHOOTING_STARS; i++) {
-        float x = (rand() % 2000) - 1000;
-        float y = (rand() % 3000) + 500;
-        float z = (rand() % 800) - 400;
-        shootingStars.push_back(ShootingStar(x, y, z));
+        float x = (gameRand() % 2000) - 1000;
+        float y = (gameRand() % 3000) + 500;
+        float z = (gameRand() % 800) - 400;
+        EntityDesc star(x, y, z);
+        star.velocity.vx = (gameRand() % 100 - 50) / 10.0f;
+        star.velocity.vy = -(gameRand() % 30 + 20) / 5.0f;
+        star.velocity.vz = (gameRand() % 40 - 20) / 10.0f;
+        star.glow.life = 100;
+        star.glow.maxLife = 100;
+        spawnEntity(shootingStars, star);
     }
 }
 
 // Create floating rose petals
 void createRosePetals() {
-    rosePetals.clear();
+    clearTable(rosePetals);
+    reserveTable(rosePetals, NUM_ROSE_PETALS);
     for (int i = 0; i < NUM_ROSE_PETALS; i++) {
-        float x = (rand() % 1000) - 500;
-        float y = (rand() % 2000) + 200;
-        float z = (rand() % 600) - 300;
-        rosePetals.push_back(RosePetal(x, y, z));
+        float x = (gameRand() % 1000) - 500;
+        float y = (gameRand() % 2000) + 200;
+        float z = (gameRand() % 600) - 300;
+        EntityDesc petal(x, y, z);
+        petal.velocity.vx = (gameRand() % 20 - 10) / 20.0f;
+        petal.velocity.vy = -(gameRand() % 10 + 5) / 20.0f;
+        petal.velocity.vz = (gameRand() % 20 - 10) / 20.0f;
+        petal.spin.speed = (gameRand() % 100 + 50) / 100.0f;
+        petal.extent.scale = 0.5f + (gameRand() % 50) / 100.0f;
+        spawnEntity(rosePetals, petal);
     }
 }
 
 // Create magical stardust particles
 void createStardust() {
-    stardust.clear();
+    clearTable(stardust);
+    reserveTable(stardust, NUM_STARDUST);
     for (int i = 0; i < NUM_STARDUST; i++) {
-        float x = (rand() % 1500) - 750;
-        float y = (rand() % 2500) + 300;
-        float z = (rand() % 700) - 350;
-        stardust.push_back(Stardust(x, y, z));
+        float x = (gameRand() % 1500) - 750;
+        float y = (gameRand() % 2500) + 300;
+        float z = (gameRand() % 700) - 350;
+        EntityDesc dust(x, y, z);
+        dust.velocity.vx = (gameRand() % 30 - 15) / 30.0f;
+        dust.velocity.vy = -(gameRand() % 20 + 10) / 30.0f;
+        dust.velocity.vz = (gameRand() % 30 - 15) / 30.0f;
+        dust.glow.brightness = 0.3f + (gameRand() % 70) / 100.0f;
+        spawnEntity(stardust, dust);
     }
 }
 
-// Draw stars with authentic Little Prince night sky feel
-void drawStars() {
-    glDisable(GL_LIGHTING);
+// Unlit point or line vertex in a flat colour
+static MeshVertex coloredVertex(float x, float y, float z, float r, float g, float b, float a) {
+    MeshVertex v = {x, y, z, 0, 0, 1, r, g, b, a};
+    return v;
+}
 
-    float speedMultiplier = currentScrollSpeed / BASE_SCROLL_SPEED;
-    glPointSize(1.5f + speedMultiplier * 0.3f);
+// How far the scroll speed is towards its maximum, which brightens the sky
+static float skySpeedIntensity() {
+    return currentScrollSpeed / (BASE_SCROLL_SPEED + MAX_LEVELS * SPEED_MULTIPLIER);
+}
+
+// Nebula clouds, each a ring of puffs turning behind the stars
+static void buildNebulaList(DrawList& list) {
+    beginDrawList(list, sceneLists.view);
+
+    float speedIntensity = skySpeedIntensity();
+    const float color[4] = {0.2f + speedIntensity * 0.1f, 0.1f + speedIntensity * 0.05f, 0.3f + speedIntensity * 0.1f, 0.15f};
+    float puffSpacing = 360.0f / quality.nebulaPuffs;
+    for (int i = 0; i < NEBULA_CLOUDS; i++) {
+        Mat4 cloud = mat4Translate(-800 + i * 400, 1500 + sin(gameTime * 0.1f + i) * 200, -900);
+        for (int j = 0; j < quality.nebulaPuffs; j++) {
+            Mat4 puff = mat4Multiply(cloud, mat4Multiply(mat4Rotate(j * puffSpacing + gameTime * 2, 0, 0, 1), mat4Translate(50, 0, 0)));
+            drawListSphere(list, puff, color, 30 + sin(gameTime * 0.3f + i + j) * 10, 8, 8, DRAW_BLEND);
+        }
+    }
+}
 
-    glBegin(GL_POINTS);
+// Stars with authentic Little Prince night sky feel
+static void buildStarList(DrawList& list) {
+    beginDrawList(list, sceneLists.view);
 
-    for (size_t i = 0; i < stars.size(); i++) {
-        float twinkleSpeed = 0.05f + speedMultiplier * 0.1f;
-        float twinkle = 0.7f + 0.3f * sin(gameTime * twinkleSpeed + stars[i].x * 0.005f);
+    // The farthest stars (z = -500) fill the view from about 400 units below
+    // the camera to 350 above it
+    const StarTile* tiles[STAR_TILE_CACHE];
+    int tileCount = gatherStarTiles(starField, cameraY - 450, cameraY + 400, tiles);
 
-        float warmth = 0.1f + (i % 10) * 0.05f;
-        float red = (stars[i].brightness + warmth) * twinkle;
-        float green = (stars[i].brightness + warmth * 0.8f) * twinkle;
-        float blue = (stars[i].brightness + warmth * 0.6f) * twinkle;
+    // Tiles hold each star's resting colour; twinkle it into the list
+    float speedMultiplier = currentScrollSpeed / BASE_SCROLL_SPEED;
+    float twinkleSpeed = 0.05f + speedMultiplier * 0.1f;
+    Mat4 identity = mat4Identity();
+    MeshVertex* twinkled = drawListStream(list, identity, GL_POINTS, tileCount * STARS_PER_TILE, 1.5f + speedMultiplier * 0.3f);
+    for (int t = 0; t < tileCount; t++) {
+        for (int i = 0; i < STARS_PER_TILE; i++) {
+            const MeshVertex& star = tiles[t]->vertices[i];
+            float twinkle = 0.7f + 0.3f * sin(gameTime * twinkleSpeed + star.x * 0.005f);
+            MeshVertex& v = *twinkled++;
+            v = star;
+            v.r = std::min(star.r * twinkle, 1.0f);
+            v.g = std::min(star.g * twinkle, 1.0f);
+            v.b = std::min(star.b * twinkle, 1.0f);
+        }
+    }
+
+    // Special bright stars, the first of each tile
+    MeshVertex* bright = drawListStream(list, identity, GL_POINTS, tileCount, 4.0f);
+    for (int t = 0; t < tileCount; t++) {
+        float specialTwinkle = 0.8f + 0.2f * sin(gameTime * 0.3f + tiles[t]->index * STARS_PER_TILE);
+        MeshVertex& v = bright[t];
+        v = tiles[t]->vertices[0];
+        v.r = 1.0f * specialTwinkle;
+        v.g = 0.95f * specialTwinkle;
+        v.b = 0.8f * specialTwinkle;
+    }
+}
 
-        if (red > 1.0f) red = 1.0f;
-        if (green > 1.0f) green = 1.0f;
-        if (blue > 1.0f) blue = 1.0f;
+// Magical shooting stars: a bright head and a trail fading behind it
+static void buildShootingStarList(DrawList& list) {
+    beginDrawList(list, sceneLists.view);
 
-        glColor3f(red, green, blue);
-        glVertex3f(stars[i].x, stars[i].y, stars[i].z);
+    size_t count = activeParticles(shootingStars.size());
+    int burning = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (shootingStars.glow[i].life > 0) burning++;
     }
 
-    glEnd();
+    Mat4 identity = mat4Identity();
+    MeshVertex* heads = drawListStream(list, identity, GL_POINTS, burning, 4.0f);
+    for (size_t i = 0; i < count; i++) {
+        const Position& p = shootingStars.position[i];
+        const Glow& g = shootingStars.glow[i];
+        if (g.life > 0) *heads++ = coloredVertex(p.x, p.y, p.z, 1.0f, 0.9f, 0.7f, g.life / g.maxLife);
+    }
 
-    // Special bright stars
-    glPointSize(4.0f);
-    glBegin(GL_POINTS);
-    for (size_t i = 0; i < stars.size(); i += 25) {
-        float specialTwinkle = 0.8f + 0.2f * sin(gameTime * 0.3f + i);
-        glColor3f(1.0f * specialTwinkle, 0.95f * specialTwinkle, 0.8f * specialTwinkle);
-        glVertex3f(stars[i].x, stars[i].y, stars[i].z);
+    MeshVertex* trails = drawListStream(list, identity, GL_LINES, burning * 2, 2.0f);
+    for (size_t i = 0; i < count; i++) {
+        const Position& p = shootingStars.position[i];
+        const Velocity& v = shootingStars.velocity[i];
+        const Glow& g = shootingStars.glow[i];
+        if (g.life > 0) {
+            float alpha = g.life / g.maxLife;
+            *trails++ = coloredVertex(p.x, p.y, p.z, 1.0f, 0.8f, 0.5f, alpha * 0.7f);
+            *trails++ = coloredVertex(p.x - v.vx * 15, p.y - v.vy * 15, p.z - v.vz * 15, 1.0f, 0.6f, 0.3f, alpha * 0.3f);
+        }
     }
-    glEnd();
+}
 
-    glEnable(GL_LIGHTING);
+// Floating rose petals
+static void buildRosePetalList(DrawList& list) {
+    beginDrawList(list, sceneLists.view);
+
+    const float glow[4] = {1.0f, 0.8f, 0.8f, 0.3f};
+    size_t count = activeParticles(rosePetals.size());
+    for (size_t i = 0; i < count; i++) {
+        const Position& p = rosePetals.position[i];
+        if (p.y > cameraY - 200 && p.y < cameraY + 800) {
+            float scale = rosePetals.extent[i].scale;
+            Mat4 model = mat4Multiply(mat4Translate(p.x, p.y, p.z), mat4Rotate(rosePetals.spin[i].angle, 1, 1, 0));
+            model = mat4Multiply(model, mat4Scale(scale, scale, scale));
+
+            drawListVertices(list, model, GL_TRIANGLES, ROSE_PETAL_TABLE.vertices, PETAL_VERTEX_COUNT, 0, DRAW_BLEND);
+            drawListSphere(list, model, glow, 2, 6, 6, DRAW_BLEND);
+        }
+    }
 }
 
-// Draw magical shooting stars
-void drawShootingStars() {
-    glDisable(GL_LIGHTING);
+// Magical stardust particles
+static void buildStardustList(DrawList& list) {
+    beginDrawList(list, sceneLists.view);
+
+    size_t count = activeParticles(stardust.size());
+    for (size_t i = 0; i < count; i++) {
+        const Position& p = stardust.position[i];
+        if (p.y > cameraY - 100 && p.y < cameraY + 600) {
+            const Glow& g = stardust.glow[i];
+            float pulse = 0.7f + 0.3f * sin(g.pulse);
+            Mat4 place = mat4Translate(p.x, p.y, p.z);
 
-    for (size_t i = 0; i < shootingStars.size(); i++) {
-        if (shootingStars[i].life > 0) {
-            float alpha = shootingStars[i].life / shootingStars[i].maxLife;
+            const float core[4] = {1.0f, 0.9f, 0.6f, g.brightness * pulse};
+            drawListSphere(list, place, core, 0.8f, 6, 6);
 
-            glColor4f(1.0f, 0.9f, 0.7f, alpha);
-            glPointSize(4.0f);
-            glBegin(GL_POINTS);
-            glVertex3f(shootingStars[i].x, shootingStars[i].y, shootingStars[i].z);
-            glEnd();
+            const float halo[4] = {1.0f, 1.0f, 0.8f, g.brightness * pulse * 0.5f};
+            drawListSphere(list, place, halo, 1.5f, 6, 6);
 
-            glLineWidth(2.0f);
-            glBegin(GL_LINES);
-            glColor4f(1.0f, 0.8f, 0.5f, alpha * 0.7f);
-            glVertex3f(shootingStars[i].x, shootingStars[i].y, shootingStars[i].z);
-            glColor4f(1.0f, 0.6f, 0.3f, alpha * 0.3f);
-            glVertex3f(shootingStars[i].x - shootingStars[i].vx * 15,
-                      shootingStars[i].y - shootingStars[i].vy * 15,
-                      shootingStars[i].z - shootingStars[i].vz * 15);
-            glEnd();
+            const float spark[4] = {1.0f, 1.0f, 0.9f, pulse * 0.6f};
+            for (int j = 0; j < 3; j++) {
+                Mat4 orbit = mat4Multiply(mat4Rotate(g.pulse * 2 + j * 120, 0, 1, 0), mat4Translate(3, 0, 0));
+                drawListSphere(list, mat4Multiply(place, orbit), spark, 0.3f, 4, 4);
+            }
         }
     }
+}
+
+// Node layout of each entity's rig block
+enum RosePart { ROSE_ROOT = 0, ROSE_STEM, ROSE_BLOOM, ROSE_PETAL, ROSE_PARTS = ROSE_PETAL + 8 };
+enum FoxPart { FOX_ROOT = 0, FOX_BODY, FOX_HEAD, FOX_PARTS };
+enum PlanetPart {
+    PLANET_ROOT = 0,                      // stem, bloom and dome are baked in its frame
+    PLANET_BODY,
+    PLANET_PETALS,                        // the bloom, turning with the planet
+    PLANET_DECORATION,                    // crate or well, by planet type
+    PLANET_HOME,                          // home planet: 3 anchors for a domed rose each
+    PLANET_PARTS = PLANET_HOME + 3
+};
 
-    glEnable(GL_LIGHTING);
+static bool sameRigKey(const RigKey& a, const RigKey& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.angle == b.angle && a.size == b.size && a.kind == b.kind;
 }
 
-// Draw floating rose petals
-void drawRosePetals() {
-    glDisable(GL_LIGHTING);
-    glEnable(GL_BLEND);
+// World matrices of one row's parts. The rig is rebuilt when the table
+// changes size, a row is re-posed when its entity moved or turned, and
+// only then are its part matrices re-evaluated.
+static void buildRigRows(const EntityRig& rig, TransformTree& tree, std::vector<RigKey>& keys, size_t rows) {
+    clearTransforms(tree);
+    tree.nodes.reserve(rows * rig.nodesPerEntity);
+    RigKey stale = {0, 0, 0, 0, 0, -1};
+    keys.assign(rows, stale);
+    for (size_t i = 0; i < rows; i++) {
+        rig.build(tree, (int)tree.nodes.size());
+    }
+}
 
-    for (size_t i = 0; i < rosePetals.size(); i++) {
-        if (rosePetals[i].y > cameraY - 200 && rosePetals[i].y < cameraY + 800) {
-            glPushMatrix();
-            glTranslatef(rosePetals[i].x, rosePetals[i].y, rosePetals[i].z);
-            glRotatef(rosePetals[i].rotation, 1, 1, 0);
-            glScalef(rosePetals[i].scale, rosePetals[i].scale, rosePetals[i].scale);
+static const TransformNode* rigNodes(EntityRig& rig, size_t rows, size_t row, const RigKey& key) {
+    if (rig.keys.size() != rows) {
+        buildRigRows(rig, rig.tree, rig.keys, rows);
+    }
 
-            glColor4f(0.9f, 0.4f, 0.5f, 0.7f);
-            glBegin(GL_TRIANGLES);
-            for (int j = 0; j < 8; j++) {
-                float angle = j * 3.14159f / 4.0f;
-                glVertex3f(0, 0, 0);
-                glVertex3f(sin(angle) * 3, cos(angle) * 2, 0);
-                glVertex3f(sin(angle + 0.785f) * 3, cos(angle + 0.785f) * 2, 0);
-            }
-            glEnd();
+    int root = (int)row * rig.nodesPerEntity;
+    if (!sameRigKey(rig.keys[row], key)) {
+        rig.pose(rig.tree, root, key);
+        rig.keys[row] = key;
+    }
+    updateTransforms(rig.tree, root, rig.nodesPerEntity);
+    return &rig.tree.nodes[root];
+}
 
-            glColor4f(1.0f, 0.8f, 0.8f, 0.3f);
-            glutSolidSphere(2, 6, 6);
+// Room for a table of up to `rows` rows, so rebuilding the rig for a
+// bigger chapter stays within it
+static void reserveRig(EntityRig& rig, size_t rows) {
+    rig.tree.nodes.reserve(rows * rig.nodesPerEntity);
+    rig.keys.reserve(rows);
+}
 
-            glPopMatrix();
-        }
+static void buildRoseRig(TransformTree& tree, int root) {
+    addTransform(tree, -1, mat4Identity());
+    addTransform(tree, root, mat4Scale(0.6f, 15, 0.6f));
+    int bloom = addTransform(tree, root, mat4Translate(0, 8, 0));
+    for (int j = 0; j < 8; j++) {
+        addTransform(tree, bloom, mat4Multiply(mat4Rotate(j * 45, 0, 1, 0), mat4Translate(2.2f, 0, 0)));
     }
+}
 
-    glDisable(GL_BLEND);
-    glEnable(GL_LIGHTING);
+static void poseRoseRig(TransformTree& tree, int root, const RigKey& key) {
+    Mat4 place = mat4Multiply(mat4Translate(key.x, key.y, key.z), mat4Rotate(key.angle, 0, 1, 0));
+    setTransform(tree, root, mat4Multiply(place, mat4Scale(key.size, key.size, key.size)));
 }
 
-// Draw magical stardust particles
-void drawStardust() {
-    glDisable(GL_LIGHTING);
+static void buildFoxRig(TransformTree& tree, int root) {
+    addTransform(tree, -1, mat4Identity());
+    addTransform(tree, root, mat4Scale(8, 4, 6));
+    addTransform(tree, root, mat4Multiply(mat4Translate(0, 2, 4), mat4Scale(5, 4, 4)));
+}
 
-    for (size_t i = 0; i < stardust.size(); i++) {
-        if (stardust[i].y > cameraY - 100 && stardust[i].y < cameraY + 600) {
-            float pulse = 0.7f + 0.3f * sin(stardust[i].pulse);
+static void poseFoxRig(TransformTree& tree, int root, const RigKey& key) {
+    setTransform(tree, root, mat4Multiply(mat4Translate(key.x, key.y, key.z), mat4Rotate(key.angle, 0, 1, 0)));
+}
 
-            glPushMatrix();
-            glTranslatef(stardust[i].x, stardust[i].y, stardust[i].z);
+EntityRig roseRig = {TransformTree(), std::vector<RigKey>(), ROSE_PARTS, buildRoseRig, poseRoseRig};
+EntityRig foxRig = {TransformTree(), std::vector<RigKey>(), FOX_PARTS, buildFoxRig, poseFoxRig};
 
-            glColor4f(1.0f, 0.9f, 0.6f, stardust[i].brightness * pulse);
-            glutSolidSphere(0.8f, 6, 6);
+// Rose parts, already placed by its rig
+static void addRoseParts(DrawList& list, const TransformNode* rose) {
+    // Rose stem
+    const float stem[4] = {0.15f, 0.5f, 0.15f, 1.0f};
+    drawListCube(list, rose[ROSE_STEM].world, stem, 1.0f);
 
-            glColor4f(1.0f, 1.0f, 0.8f, stardust[i].brightness * pulse * 0.5f);
-            glutSolidSphere(1.5f, 6, 6);
+    // Rose bloom
+    const float bloom[4] = {0.8f, 0.15f, 0.2f, 1.0f};
+    drawListSphere(list, rose[ROSE_BLOOM].world, bloom, 2.8f, 16, 16);
 
-            for (int j = 0; j < 3; j++) {
-                glPushMatrix();
-                glRotatef(stardust[i].pulse * 2 + j * 120, 0, 1, 0);
-                glTranslatef(3, 0, 0);
-                glColor4f(1.0f, 1.0f, 0.9f, pulse * 0.6f);
-                glutSolidSphere(0.3f, 4, 4);
-                glPopMatrix();
-            }
+    // Rose petals
+    for (int j = 0; j < 8; j++) {
+        const float petal[4] = {0.9f, 0.2f + j * 0.05f, 0.25f + j * 0.02f, 1.0f};
+        drawListSphere(list, rose[ROSE_PETAL + j].world, petal, 1.2f, 8, 8);
+    }
+}
 
-            glPopMatrix();
-        }
+// Fox parts, already placed by its rig
+static void addFoxParts(DrawList& list, const TransformNode* fox) {
+    // Fox body
+    const float body[4] = {0.8f, 0.5f, 0.2f, 1.0f};
+    drawListCube(list, fox[FOX_BODY].world, body, 1.0f);
+
+    // Fox head
+    const float head[4] = {0.9f, 0.6f, 0.3f, 1.0f};
+    drawListCube(list, fox[FOX_HEAD].world, head, 1.0f);
+}
+
+// Camera-facing quad showing the baked view closest to the one the camera
+// has of this decoration, as 6 vertices. right is the camera's horizontal
+// right vector.
+static void appendImpostor(SpriteVertex* out, int kind, float x, float y, float z, float angle, float scale,
+                           float rightX, float rightZ) {
+    // Seen from the camera, the decoration looks like the baked one turned
+    // by its own angle minus the camera's bearing around it
+    float bearing = atan2(cameraEye.x - x, cameraEye.z - z) * 180.0f / 3.14159265f;
+    float step = 360.0f / IMPOSTOR_ANGLES;
+    int cell = (int)floor(fmod(angle - bearing, 360.0f) / step + 0.5f) % IMPOSTOR_ANGLES;
+    if (cell < 0) cell += IMPOSTOR_ANGLES;
+
+    float half = impostors.halfSize[kind] * scale;
+    float cy = y + impostors.centerY[kind] * scale;
+    float u0 = (float)cell / IMPOSTOR_ANGLES;
+    float u1 = (float)(cell + 1) / IMPOSTOR_ANGLES;
+    float v0 = (float)kind / IMPOSTOR_KINDS;
+    float v1 = (float)(kind + 1) / IMPOSTOR_KINDS;
+
+    SpriteVertex corners[4] = {
+        {x - rightX * half, cy - half, z - rightZ * half, u0, v0},
+        {x + rightX * half, cy - half, z + rightZ * half, u1, v0},
+        {x + rightX * half, cy + half, z + rightZ * half, u1, v1},
+        {x - rightX * half, cy + half, z - rightZ * half, u0, v1}
+    };
+    const int order[6] = {0, 1, 2, 0, 2, 3};
+    for (int k = 0; k < 6; k++) {
+        out[k] = corners[order[k]];
     }
+}
 
-    glEnable(GL_LIGHTING);
-}
-
-// Draw authentic Little Prince roses
-void drawRoses() {
-    for (size_t i = 0; i < roses.size(); i++) {
-        if (roses[i].y > cameraY - 100 && roses[i].y < cameraY + 600) {
-            glPushMatrix();
-            glTranslatef(roses[i].x, roses[i].y, roses[i].z);
-            glRotatef(roses[i].rotation, 0, 1, 0);
-            glScalef(roses[i].scale, roses[i].scale, roses[i].scale);
-
-            // Rose stem
-            glColor3f(0.15f, 0.5f, 0.15f);
-            glPushMatrix();
-            glScalef(0.6f, 15, 0.6f);
-            glutSolidCube(1.0f);
-            glPopMatrix();
-
-            // Rose bloom
-            glColor3f(0.8f, 0.15f, 0.2f);
-            glPushMatrix();
-            glTranslatef(0, 8, 0);
-            glutSolidSphere(2.8f, 16, 16);
-            glPopMatrix();
-
-            // Rose petals
-            for (int j = 0; j < 8; j++) {
-                glPushMatrix();
-                glTranslatef(0, 8, 0);
-                glRotatef(j * 45, 0, 1, 0);
-                glTranslatef(2.2f, 0, 0);
-                glColor3f(0.9f, 0.2f + j * 0.05f, 0.25f + j * 0.02f);
-                glutSolidSphere(1.2f, 8, 8);
-                glPopMatrix();
-            }
+// Add the visible rows of a decoration table. The nearest ones within
+// IMPOSTOR_DISTANCE, up to IMPOSTOR_NEAR_BUDGET, get their real geometry;
+// all the others go out as one batch of impostor quads, so the cost of far
+// decorations barely depends on how many there are.
+static void addDecorations(DrawList& list, const ArchetypeTable& table, EntityRig& rig, int kind, bool scaled,
+                           void (*addParts)(DrawList& list, const TransformNode* parts)) {
+    decorationDraws.clear();
+    for (size_t i = 0; i < table.size(); i++) {
+        const Position& p = table.position[i];
+        if (p.y > cameraY - 100 && p.y < cameraY + quality.decorationDistance) {
+            float dx = p.x - cameraEye.x, dy = p.y - cameraEye.y, dz = p.z - cameraEye.z;
+            DecorationDraw d = {(float)sqrt(dx * dx + dy * dy + dz * dz), (int)i};
+            decorationDraws.push_back(d);
+        }
+    }
 
-            glPopMatrix();
-            roses[i].rotation += 0.3f;
+    size_t nearCount = decorationDraws.size();
+    if (impostors.texture) {
+        std::vector<DecorationDraw>::iterator nearEnd = std::partition(decorationDraws.begin(), decorationDraws.end(),
+            [](const DecorationDraw& d) { return d.distance < IMPOSTOR_DISTANCE; });
+        nearCount = nearEnd - decorationDraws.begin();
+        if (nearCount > (size_t)IMPOSTOR_NEAR_BUDGET) {
+            std::nth_element(decorationDraws.begin(), decorationDraws.begin() + IMPOSTOR_NEAR_BUDGET, nearEnd,
+                [](const DecorationDraw& a, const DecorationDraw& b) { return a.distance < b.distance; });
+            nearCount = IMPOSTOR_NEAR_BUDGET;
         }
     }
+
+    for (size_t k = 0; k < nearCount; k++) {
+        int i = decorationDraws[k].row;
+        const Position& p = table.position[i];
+        RigKey key = {p.x, p.y, p.z, table.spin[i].angle, scaled ? table.extent[i].scale : 1, 0};
+        addParts(list, rigNodes(rig, table.size(), i, key));
+    }
+
+    size_t farCount = decorationDraws.size() - nearCount;
+    impostors.meshes += nearCount;
+    impostors.sprites += farCount;
+    if (farCount == 0) return;
+
+    // The camera's right vector, flattened so impostors stay upright
+    float rightX = list.view.m[0], rightZ = list.view.m[8];
+    float length = sqrt(rightX * rightX + rightZ * rightZ);
+    rightX /= length;
+    rightZ /= length;
+
+    const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    SpriteVertex* quads = drawListSprites(list, mat4Identity(), impostors.texture, white, (int)farCount * 6);
+    for (size_t k = nearCount; k < decorationDraws.size(); k++) {
+        int i = decorationDraws[k].row;
+        const Position& p = table.position[i];
+        appendImpostor(quads, kind, p.x, p.y, p.z, table.spin[i].angle, scaled ? table.extent[i].scale : 1, rightX, rightZ);
+        quads += 6;
+    }
+}
+
+// Authentic Little Prince roses, then foxes
+static void buildDecorationList(DrawList& list) {
+    beginDrawList(list, sceneLists.view);
+    addDecorations(list, roses, roseRig, IMPOSTOR_ROSE, true, addRoseParts);
+    addDecorations(list, foxes, foxRig, IMPOSTOR_FOX, false, addFoxParts);
 }
 
-// Draw Little Prince foxes
-void drawFoxes() {
-    for (size_t i = 0; i < foxes.size(); i++) {
-        if (foxes[i].y > cameraY - 100 && foxes[i].y < cameraY + 600) {
-            glPushMatrix();
-            glTranslatef(foxes[i].x, foxes[i].y, foxes[i].z);
-            glRotatef(foxes[i].rotation, 0, 1, 0);
-
-            // Fox body
-            glColor3f(0.8f, 0.5f, 0.2f);
-            glPushMatrix();
-            glScalef(8, 4, 6);
-            glutSolidCube(1.0f);
-            glPopMatrix();
-
-            // Fox head
-            glColor3f(0.9f, 0.6f, 0.3f);
-            glPushMatrix();
-            glTranslatef(0, 2, 4);
-            glScalef(5, 4, 4);
-            glutSolidCube(1.0f);
-            glPopMatrix();
-
-            glPopMatrix();
-            foxes[i].rotation += 0.3f;
+// Render every decoration kind from IMPOSTOR_ANGLES directions into the
+// atlas. Transparency comes from drawing each view on black and on white:
+// wherever the two differ, the background showed through.
+void buildImpostorAtlas() {
+    const int width = IMPOSTOR_ANGLES * IMPOSTOR_CELL;
+    const int height = IMPOSTOR_KINDS * IMPOSTOR_CELL;
+    std::vector<unsigned char> atlas(width * height * 4);
+    std::vector<unsigned char> onBlack(width * IMPOSTOR_CELL * 3);
+    std::vector<unsigned char> onWhite(width * IMPOSTOR_CELL * 3);
+
+    EntityRig* rigs[IMPOSTOR_KINDS] = {&roseRig, &foxRig};
+    void (*addParts[IMPOSTOR_KINDS])(DrawList&, const TransformNode*) = {addRoseParts, addFoxParts};
+    DrawList parts;
+
+    // Decorations are drawn unlit with the background, so bake them unlit
+    bool offscreen = rBeginOffscreen(width, IMPOSTOR_CELL);
+    rDisable(GL_LIGHTING);
+    Mat4 identity = mat4Identity();
+
+    for (int kind = 0; kind < IMPOSTOR_KINDS; kind++) {
+        TransformTree tree;
+        rigs[kind]->build(tree, 0);
+        float half = impostors.halfSize[kind];
+        float cy = impostors.centerY[kind];
+
+        for (int pass = 0; pass < 2; pass++) {
+            rClearColor(pass, pass, pass, 1.0f);
+            rClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            for (int cell = 0; cell < IMPOSTOR_ANGLES; cell++) {
+                rViewport(cell * IMPOSTOR_CELL, 0, IMPOSTOR_CELL, IMPOSTOR_CELL);
+                rMatrixMode(GL_PROJECTION);
+                rLoadMatrix(mat4Ortho(-half, half, cy - half, cy + half, -50, 50));
+                rMatrixMode(GL_MODELVIEW);
+                rLoadIdentity();
+
+                RigKey key = {0, 0, 0, cell * 360.0f / IMPOSTOR_ANGLES, 1, 0};
+                rigs[kind]->pose(tree, 0, key);
+                updateTransforms(tree, 0, (int)tree.nodes.size());
+                beginDrawList(parts, identity);
+                addParts[kind](parts, &tree.nodes[0]);
+                submitDrawList(parts);
+            }
+            rReadPixels(0, 0, width, IMPOSTOR_CELL, pass ? &onWhite[0] : &onBlack[0]);
+        }
+
+        for (int i = 0; i < width * IMPOSTOR_CELL; i++) {
+            const unsigned char* b = &onBlack[i * 3];
+            const unsigned char* w = &onWhite[i * 3];
+            int seen = ((w[0] - b[0]) + (w[1] - b[1]) + (w[2] - b[2])) / 3;
+            int alpha = std::max(0, std::min(255, 255 - seen));
+            unsigned char* out = &atlas[(kind * width * IMPOSTOR_CELL + i) * 4];
+            for (int c = 0; c < 3; c++) {
+                out[c] = alpha > 0 ? (unsigned char)std::min(255, b[c] * 255 / alpha) : 0;
+            }
+            out[3] = (unsigned char)alpha;
         }
     }
+
+    rEndOffscreen();
+    rEnable(GL_LIGHTING);
+    rClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    reshape(windowWidth, windowHeight);
+    impostors.texture = rCreateTexture(width, height, &atlas[0]);
+    std::cerr << "impostors: " << IMPOSTOR_KINDS << " kinds x " << IMPOSTOR_ANGLES << " angles baked "
+              << (offscreen ? "offscreen" : "in the back buffer") << std::endl;
+}
+
+void reportImpostorStats() {
+    if (impostors.frames == 0) return;
+    std::cerr << "decorations: " << (double)impostors.meshes / impostors.frames << " meshes and "
+              << (double)impostors.sprites / impostors.frames << " impostors per frame, "
+              << decorationRegionsStreamed << " regions streamed in" << std::endl;
 }
 
 // Update all atmospheric effects
 void updateAtmosphericEffects() {
-    // Update shooting stars
-    for (size_t i = 0; i < shootingStars.size(); i++) {
-        shootingStars[i].x += shootingStars[i].vx;
-        shootingStars[i].y += shootingStars[i].vy;
-        shootingStars[i].z += shootingStars[i].vz;
-        shootingStars[i].life -= 2.0f;
-
-        if (shootingStars[i].life <= 0) {
-            shootingStars[i].x = (rand() % 2000) - 1000;
-            shootingStars[i].y = cameraY + 400 + (rand() % 200);
-            shootingStars[i].z = (rand() % 800) - 400;
-            shootingStars[i].life = shootingStars[i].maxLife;
-            shootingStars[i].vx = (rand() % 100 - 50) / 10.0f;
-            shootingStars[i].vy = -(rand() % 30 + 20) / 5.0f;
-            shootingStars[i].vz = (rand() % 40 - 20) / 10.0f;
+    // Inactive particles are frozen and recycle once they are back in play
+    size_t activeShootingStars = activeParticles(shootingStars.size());
+    size_t activePetals = activeParticles(rosePetals.size());
+    size_t activeStardust = activeParticles(stardust.size());
+
+    integrateMotion(shootingStars, activeShootingStars);
+    integrateMotion(rosePetals, activePetals);
+    integrateMotion(stardust, activeStardust);
+
+    // Shooting stars burn out and respawn above the camera
+    for (size_t i = 0; i < activeShootingStars; i++) {
+        Position& p = shootingStars.position[i];
+        Velocity& v = shootingStars.velocity[i];
+        Glow& g = shootingStars.glow[i];
+        g.life -= 2.0f;
+
+        if (g.life <= 0) {
+            p.x = (gameRand() % 2000) - 1000;
+            p.y = cameraY + 400 + (gameRand() % 200);
+            p.z = (gameRand() % 800) - 400;
+            g.life = g.maxLife;
+            v.vx = (gameRand() % 100 - 50) / 10.0f;
+            v.vy = -(gameRand() % 30 + 20) / 5.0f;
+            v.vz = (gameRand() % 40 - 20) / 10.0f;
         }
     }
 
-    // Update rose petals
-    for (size_t i = 0; i < rosePetals.size(); i++) {
-        rosePetals[i].x += rosePetals[i].vx;
-        rosePetals[i].y += rosePetals[i].vy;
-        rosePetals[i].z += rosePetals[i].vz;
-        rosePetals[i].rotation += rosePetals[i].rotSpeed;
-
-        rosePetals[i].vx += sin(gameTime * 0.5f + i) * 0.02f;
-        rosePetals[i].vz += cos(gameTime * 0.3f + i) * 0.015f;
-
-        if (rosePetals[i].y < cameraY - 300) {
-            rosePetals[i].x = (rand() % 1000) - 500;
-            rosePetals[i].y = cameraY + 600 + (rand() % 200);
-            rosePetals[i].z = (rand() % 600) - 300;
-            rosePetals[i].vx = (rand() % 20 - 10) / 20.0f;
-            rosePetals[i].vy = -(rand() % 10 + 5) / 20.0f;
-            rosePetals[i].vz = (rand() % 20 - 10) / 20.0f;
+    // Rose petals drift and recycle once below the camera
+    for (size_t i = 0; i < activePetals; i++) {
+        Position& p = rosePetals.position[i];
+        Velocity& v = rosePetals.velocity[i];
+        v.vx += sin(gameTime * 0.5f + i) * 0.02f;
+        v.vz += cos(gameTime * 0.3f + i) * 0.015f;
+
+        if (p.y < cameraY - 300) {
+            p.x = (gameRand() % 1000) - 500;
+            p.y = cameraY + 600 + (gameRand() % 200);
+            p.z = (gameRand() % 600) - 300;
+            v.vx = (gameRand() % 20 - 10) / 20.0f;
+            v.vy = -(gameRand() % 10 + 5) / 20.0f;
+            v.vz = (gameRand() % 20 - 10) / 20.0f;
         }
     }
 
-    // Update stardust
-    for (size_t i = 0; i < stardust.size(); i++) {
-        stardust[i].x += stardust[i].vx;
-        stardust[i].y += stardust[i].vy;
-        stardust[i].z += stardust[i].vz;
-        stardust[i].pulse += 0.1f;
-
-        stardust[i].vx += sin(gameTime * 0.3f + i) * 0.01f;
-        stardust[i].vy += cos(gameTime * 0.2f + i) * 0.005f;
-
-        if (stardust[i].y < cameraY - 200) {
-            stardust[i].x = (rand() % 1500) - 750;
-            stardust[i].y = cameraY + 500 + (rand() % 300);
-            stardust[i].z = (rand() % 700) - 350;
-            stardust[i].vx = (rand() % 30 - 15) / 30.0f;
-            stardust[i].vy = -(rand() % 20 + 10) / 30.0f;
-            stardust[i].vz = (rand() % 30 - 15) / 30.0f;
+    // Stardust pulses, drifts and recycles once below the camera
+    for (size_t i = 0; i < activeStardust; i++) {
+        Position& p = stardust.position[i];
+        Velocity& v = stardust.velocity[i];
+        stardust.glow[i].pulse += 0.1f;
+
+        v.vx += sin(gameTime * 0.3f + i) * 0.01f;
+        v.vy += cos(gameTime * 0.2f + i) * 0.005f;
+
+        if (p.y < cameraY - 200) {
+            p.x = (gameRand() % 1500) - 750;
+            p.y = cameraY + 500 + (gameRand() % 300);
+            p.z = (gameRand() % 700) - 350;
+            v.vx = (gameRand() % 30 - 15) / 30.0f;
+            v.vy = -(gameRand() % 20 + 10) / 30.0f;
+            v.vz = (gameRand() % 30 - 15) / 30.0f;
         }
     }
 }
 
 // Draw background with magical effects
 void drawBackground() {
-    glDisable(GL_LIGHTING);
-    glDisable(GL_DEPTH_TEST);
+    rDisable(GL_LIGHTING);
+    rDisable(GL_DEPTH_TEST);
 
-    float speedIntensity = currentScrollSpeed / (BASE_SCROLL_SPEED + MAX_LEVELS * SPEED_MULTIPLIER);
+    float speedIntensity = skySpeedIntensity();
 
     // Enhanced night sky with speed effects
-    glBegin(GL_QUADS);
-    glColor3f(0.05f + speedIntensity * 0.08f, 0.1f + speedIntensity * 0.08f, 0.25f + speedIntensity * 0.15f);
-    glVertex3f(-1000, 5000, -1000);
-    glVertex3f(1000, 5000, -1000);
-    glColor3f(0.1f + speedIntensity * 0.08f, 0.05f + speedIntensity * 0.08f, 0.2f + speedIntensity * 0.12f);
-    glVertex3f(1000, 2000, -1000);
-    glVertex3f(-1000, 2000, -1000);
-    glEnd();
-
-    glBegin(GL_QUADS);
-    glColor3f(0.1f + speedIntensity * 0.08f, 0.05f + speedIntensity * 0.08f, 0.2f + speedIntensity * 0.12f);
-    glVertex3f(-1000, 2000, -1000);
-    glVertex3f(1000, 2000, -1000);
-    glColor3f(0.02f + speedIntensity * 0.05f, 0.02f + speedIntensity * 0.05f, 0.1f + speedIntensity * 0.08f);
-    glVertex3f(1000, -1000, -1000);
-    glVertex3f(-1000, -1000, -1000);
-    glEnd();
+    rBegin(GL_QUADS);
+    rColor3f(0.05f + speedIntensity * 0.08f, 0.1f + speedIntensity * 0.08f, 0.25f + speedIntensity * 0.15f);
+    rVertex3f(-1000, 5000, -1000);
+    rVertex3f(1000, 5000, -1000);
+    rColor3f(0.1f + speedIntensity * 0.08f, 0.05f + speedIntensity * 0.08f, 0.2f + speedIntensity * 0.12f);
+    rVertex3f(1000, 2000, -1000);
+    rVertex3f(-1000, 2000, -1000);
+    rEnd();
+
+    rBegin(GL_QUADS);
+    rColor3f(0.1f + speedIntensity * 0.08f, 0.05f + speedIntensity * 0.08f, 0.2f + speedIntensity * 0.12f);
+    rVertex3f(-1000, 2000, -1000);
+    rVertex3f(1000, 2000, -1000);
+    rColor3f(0.02f + speedIntensity * 0.05f, 0.02f + speedIntensity * 0.05f, 0.1f + speedIntensity * 0.08f);
+    rVertex3f(1000, -1000, -1000);
+    rVertex3f(-1000, -1000, -1000);
+    rEnd();
+
+    // The sky is all the GL thread draws while the helpers build
+    finishSceneLists();
 
     // Add nebula clouds
-    glEnable(GL_BLEND);
-    for (int i = 0; i < 5; i++) {
-        glPushMatrix();
-        glTranslatef(-800 + i * 400, 1500 + sin(gameTime * 0.1f + i) * 200, -900);
-        glColor4f(0.2f + speedIntensity * 0.1f, 0.1f + speedIntensity * 0.05f, 0.3f + speedIntensity * 0.1f, 0.15f);
-
-        for (int j = 0; j < 8; j++) {
-            glPushMatrix();
-            glRotatef(j * 45 + gameTime * 2, 0, 0, 1);
-            glTranslatef(50, 0, 0);
-            glutSolidSphere(30 + sin(gameTime * 0.3f + i + j) * 10, 8, 8);
-            glPopMatrix();
-        }
-        glPopMatrix();
-    }
-    glDisable(GL_BLEND);
+    overdrawStage(overdraw, STAGE_NEBULA);
+    submitSceneList(LIST_NEBULA);
 
-    glEnable(GL_DEPTH_TEST);
+    rEnable(GL_DEPTH_TEST);
 
     // Draw all atmospheric effects
-    drawStars();
-    drawShootingStars();
-    drawStardust();
-    drawRosePetals();
-    drawRoses();
-    drawFoxes();
-
-    glEnable(GL_LIGHTING);
+    overdrawStage(overdraw, STAGE_PARTICLES);
+    submitSceneList(LIST_STARS);
+    submitSceneList(LIST_SHOOTING_STARS);
+    submitSceneList(LIST_STARDUST);
+    submitSceneList(LIST_ROSE_PETALS);
+
+    // Roses and foxes are lit like the planets; impostors ignore lighting
+    rEnable(GL_LIGHTING);
+    overdrawStage(overdraw, STAGE_DECORATIONS);
+    submitSceneList(LIST_DECORATIONS);
+    impostors.frames++;
 }
 
-// Create authentic Little Prince planetoids
-void createPlanets() {
-    planets.clear();
-
-    planets.push_back(Planet(0, 50, 0, 120, 60, 0));
-
-    int totalPlanets = PLANETS_PER_LEVEL * currentLevel;
+// Planets are spawned bottom to top, which keeps the table sorted by height
+static void spawnPlanet(ArchetypeTable& table, float x, float y, float z, float width, float depth, int planetType) {
+    EntityDesc planet(x, y, z);
+    planet.extent.width = width;
+    planet.extent.depth = depth;
+    planet.spin.speed = PLANET_SPIN;
+    planet.kind = planetType;
+    spawnEntity(table, planet);
+}
 
-    for (int i = 0; i < totalPlanets; i++) {
-        float x = (rand() % 300) - 150;
-        float y = 100 + i * 70;
-        float z = (rand() % (int)(PLATFORM_Z_RANGE * 1.5f)) - (PLATFORM_Z_RANGE * 0.75f);
+// Create authentic Little Prince planetoids. The layout comes from the
+// chapter's own seed and is checked to be solvable before it is used.
+// Touches nothing but the table and the arena, so it can run on the
+// chapter worker.
+static ChapterStatus buildChapterTable(ArchetypeTable& table, Arena& arena, int level, unsigned seed) {
+    int count = chapterPlanetCount(levelRules, level);
+
+    // The arena's previous chapter goes all at once, layout scratch with it
+    arenaReset(arena);
+    bindTable(table, &arena);
+    reserveTable(table, count);
+    PlanetSpec* layout = (PlanetSpec*)arenaAlloc(arena, count * sizeof(PlanetSpec), alignof(PlanetSpec));
+    ChapterScratch scratch;
+    scratch.camera = (float*)arenaAlloc(arena, count * sizeof(float), alignof(float));
+    scratch.heap = (int*)arenaAlloc(arena, count * sizeof(int), alignof(int));
+    scratch.slot = (int*)arenaAlloc(arena, count * sizeof(int), alignof(int));
+
+    ChapterStatus status = buildChapter(levelRules, jumpArc, seed, level, layout, scratch);
+    for (int i = 0; i < count; i++) {
+        const PlanetSpec& p = layout[i];
+        spawnPlanet(table, p.x, p.y, p.z, p.width, p.depth, p.type);
+    }
+    return status;
+}
 
-        float width = 50 + rand() % 40;
-        float depth = 35 + rand() % 25;
+static void logChapterStatus(int level, ChapterStatus status) {
+    if (status == CHAPTER_UNSOLVABLE) {
+        std::cerr << "levelgen: chapter " << level << " of seed " << levelSeed << " may not be solvable" << std::endl;
+    }
+}
 
-        int planetType = 0;
-        if (i % 12 == 3) planetType = 1;
-        else if (i % 15 == 7) planetType = 2;
-        else if (i % 18 == 11) planetType = 3;
+// Build the current chapter in place, on the game thread
+void createPlanets() {
+    logChapterStatus(currentLevel, buildChapterTable(planets, levelArenas[activeLevelArena], currentLevel, levelSeed));
+}
 
-        if (i >= PLANETS_PER_LEVEL) {
-            int levelNum = (i / PLANETS_PER_LEVEL) + 1;
-            width -= levelNum * 1.5f;
-            depth -= levelNum * 1.0f;
-            y += levelNum * 4;
+// Parts that only depend on the planet's size are placed once; the root
+// and the petals follow its turn
+static void buildPlanetRig(TransformTree& tree, int root) {
+    addTransform(tree, -1, mat4Identity());
+    addTransform(tree, root, mat4Scale(1.0f, 0.3f, 1.0f));
+    addTransform(tree, root, mat4Identity());
+    addTransform(tree, root, mat4Identity());
+    for (int i = 0; i < 3; i++) {
+        addTransform(tree, root, mat4Identity());
+    }
+}
 
-            if (width < 25) width = 25;
-            if (depth < 20) depth = 20;
-        }
+static void posePlanetRig(TransformTree& tree, int root, const RigKey& key) {
+    setTransform(tree, root, mat4Multiply(mat4Translate(key.x, key.y, key.z), mat4Rotate(key.angle * 0.1f, 0, 1, 0)));
+    setTransform(tree, root + PLANET_PETALS, mat4Multiply(mat4Translate(0, 12, 0), mat4Rotate(key.angle, 0, 1, 0)));
 
-        planets.push_back(Planet(x, y, z, width, depth, planetType));
+    if (key.kind == 2) {
+        setTransform(tree, root + PLANET_DECORATION,
+                     mat4Multiply(mat4Translate(key.size / 3, 6, 0), mat4Scale(0.4f, 0.4f, 0.4f)));
+    } else if (key.kind == 3) {
+        setTransform(tree, root + PLANET_DECORATION,
+                     mat4Multiply(mat4Translate(-key.size / 3, 8, 0), mat4Scale(3, 4, 2)));
     }
+    for (int i = 0; i < 3; i++) {
+        setTransform(tree, root + PLANET_HOME + i,
+                     mat4Multiply(mat4Rotate(i * 120, 0, 1, 0), mat4Translate(key.size / 3, 0, 0)));
+    }
+}
+
+EntityRig planetRig = {TransformTree(), std::vector<RigKey>(), PLANET_PARTS, buildPlanetRig, posePlanetRig};
 
-    float finalY = 100 + totalPlanets * 70;
-    planets.push_back(Planet(0, finalY, 0, 180, 90, 4));
+// Runs on the chapter worker: the next chapter's planets into the spare
+// level arena, and the planet rig for them
+static void prefetchJob(void* arg) {
+    ChapterPrefetch& next = *static_cast<ChapterPrefetch*>(arg);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    next.status = buildChapterTable(next.planets, *next.arena, next.level, next.seed);
+    buildRigRows(planetRig, next.rig, next.keys, next.planets.size());
+    next.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
-// Draw Little Prince planetoid with glass-domed roses
-void drawPlanet(const Planet& planet) {
-    glPushMatrix();
-    glTranslatef(planet.x, planet.y, planet.z);
-    glRotatef(planet.rotation * 0.1f, 0, 1, 0);
+// Start building `level` in the background, once the previous prefetch is
+// done with the spare arena
+void prefetchChapter(int level) {
+    waitForWorker(chapterWorker);
+    nextChapter.level = 0;
+    if (level > MAX_LEVELS || !chapterWorker.thread.joinable()) return;
+
+    nextChapter.level = level;
+    nextChapter.seed = levelSeed;
+    nextChapter.arena = &levelArenas[1 - activeLevelArena];
+    submitJob(chapterWorker, prefetchJob, &nextChapter);
+}
 
-    // Planet colors based on type
-    switch(planet.planetType) {
-        case 0: glColor3f(0.6f, 0.5f, 0.4f); break;
-        case 1: glColor3f(0.7f, 0.5f, 0.5f); break;
-        case 2: glColor3f(0.7f, 0.6f, 0.4f); break;
-        case 3: glColor3f(0.6f, 0.5f, 0.7f); break;
-        case 4: glColor3f(0.8f, 0.7f, 0.5f); break;
+// Make the next chapter current: swap in the prefetched one when it is the
+// right one (a rewind may have changed the level since), else build it
+// here. A swap only exchanges pointers, however big the chapter.
+static void enterChapter() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    waitForWorker(chapterWorker);
+
+    if (nextChapter.level == currentLevel && nextChapter.seed == levelSeed) {
+        swapTables(planets, nextChapter.planets);
+        planetRig.tree.nodes.swap(nextChapter.rig.nodes);
+        planetRig.keys.swap(nextChapter.keys);
+        activeLevelArena = 1 - activeLevelArena;
+        nextChapter.level = 0;
+        logChapterStatus(currentLevel, nextChapter.status);
+
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        nextChapter.swapped++;
+        nextChapter.prefetchMs += nextChapter.buildMs;
+        nextChapter.worstSwapUs = std::max(nextChapter.worstSwapUs, us);
+    } else {
+        createPlanets();
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        nextChapter.builtInPlace++;
+        nextChapter.worstBuildUs = std::max(nextChapter.worstBuildUs, us);
     }
+    prefetchChapter(currentLevel + 1);
+}
 
-    // Planetoid body
-    glPushMatrix();
-    glScalef(1.0f, 0.3f, 1.0f);
-    glutSolidSphere(planet.width/2.5f, 16, 12);
-    glPopMatrix();
-
-    // Rose stem base
-    glColor3f(0.15f, 0.4f, 0.15f);
-    glPushMatrix();
-    glTranslatef(0, 8, 0);
-    glScalef(0.8f, 6, 0.8f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-
-    // Rose bloom
-    glColor3f(0.85f, 0.15f, 0.2f);
-    glPushMatrix();
-    glTranslatef(0, 12, 0);
-    glutSolidSphere(2.2f, 12, 12);
-    glPopMatrix();
+void stopChapterWorker() {
+    stopWorker(chapterWorker);
+}
 
-    // Rose petals
-    for (int i = 0; i < 6; i++) {
-        glPushMatrix();
-        glTranslatef(0, 12, 0);
-        glRotatef(i * 60 + planet.rotation, 0, 1, 0);
-        glTranslatef(1.8f, 0, 0);
-        glColor3f(0.9f, 0.25f + i * 0.03f, 0.3f);
-        glutSolidSphere(0.8f, 8, 8);
-        glPopMatrix();
-    }
-
-    // GLASS DOME (key element from the book!)
-    glEnable(GL_BLEND);
-    glColor4f(0.9f, 0.95f, 1.0f, 0.3f);
-
-    glPushMatrix();
-    glTranslatef(0, 10, 0);
-
-    // Main dome hemisphere
-    for (int i = 0; i < 12; i++) {
-        glPushMatrix();
-        glRotatef(i * 30, 0, 1, 0);
-        glBegin(GL_TRIANGLES);
-        for (int j = 0; j < 8; j++) {
-            float angle1 = j * 3.14159f / 16.0f;
-            float angle2 = (j + 1) * 3.14159f / 16.0f;
-            float radius = 4.5f;
-
-            glVertex3f(0, radius, 0);
-            glVertex3f(radius * sin(angle1), radius * cos(angle1), 0);
-            glVertex3f(radius * sin(angle2), radius * cos(angle2), 0);
-        }
-        glEnd();
-        glPopMatrix();
-    }
-
-    // Glass dome base ring
-    glColor4f(0.8f, 0.85f, 0.9f, 0.6f);
-    glPushMatrix();
-    glTranslatef(0, -2, 0);
-    glutSolidTorus(0.5, 4.5, 8, 16);
-    glPopMatrix();
-
-    glPopMatrix();
-    glDisable(GL_BLEND);
-
-    // Planet-specific decorations
-    if (planet.planetType == 2) {
-        glColor3f(0.8f, 0.5f, 0.2f);
-        glPushMatrix();
-        glTranslatef(planet.width/3, 6, 0);
-        glScalef(0.4f, 0.4f, 0.4f);
-        glutSolidCube(4);
-        glPopMatrix();
-    } else if (planet.planetType == 3) {
-        glColor3f(0.7f, 0.6f, 0.2f);
-        glPushMatrix();
-        glTranslatef(-planet.width/3, 8, 0);
-        glScalef(3, 4, 2);
-        glutSolidCube(1.0f);
-        glPopMatrix();
-    } else if (planet.planetType == 4) {
-        // Multiple roses for home planet
-        for (int i = 0; i < 3; i++) {
-            glPushMatrix();
-            glRotatef(i * 120, 0, 1, 0);
-            glTranslatef(planet.width/3, 0, 0);
-
-            glColor3f(0.8f, 0.2f, 0.25f);
-            glPushMatrix();
-            glTranslatef(0, 8, 0);
-            glutSolidSphere(1.5f, 8, 8);
-            glPopMatrix();
-
-            glEnable(GL_BLEND);
-            glColor4f(0.9f, 0.95f, 1.0f, 0.25f);
-            glPushMatrix();
-            glTranslatef(0, 9, 0);
-            glutSolidSphere(2.5f, 10, 8);
-            glPopMatrix();
-            glDisable(GL_BLEND);
-
-            glPopMatrix();
-        }
+void reportPrefetchStats() {
+    if (nextChapter.swapped + nextChapter.builtInPlace == 0) return;
+    std::cerr << "chapters: " << nextChapter.swapped << " prefetched";
+    if (nextChapter.swapped > 0) {
+        std::cerr << " (" << nextChapter.prefetchMs / nextChapter.swapped << " ms each on the worker, swapped in within "
+                  << nextChapter.worstSwapUs << " us)";
     }
-
-    glPopMatrix();
+    std::cerr << ", " << nextChapter.builtInPlace << " built in place";
+    if (nextChapter.builtInPlace > 0) std::cerr << " (worst " << nextChapter.worstBuildUs << " us)";
+    std::cerr << std::endl;
 }
 
-// Draw The Little Prince character
-void drawLittlePrince() {
-    if (player.onGround) {
-        glPushMatrix();
-        glTranslatef(player.x, planets[player.lastPlanetIndex].y + 1, player.z);
-        glColor4f(0.0f, 0.0f, 0.0f, 0.3f);
-        glBegin(GL_QUADS);
-        glVertex3f(-4, 0, -4);
-        glVertex3f(4, 0, -4);
-        glVertex3f(4, 0, 4);
-        glVertex3f(-4, 0, 4);
-        glEnd();
-        glPopMatrix();
-    }
-
-    glPushMatrix();
-    glTranslatef(player.x, player.y + player.bobOffset, player.z);
-    glRotatef(player.rotation, 0, 1, 0);
+// Planetoid body colour of each type
+const float PLANET_BODY_COLORS[PLANET_TYPES][4] = {
+    {0.6f, 0.5f, 0.4f, 1.0f}, {0.7f, 0.5f, 0.5f, 1.0f}, {0.7f, 0.6f, 0.4f, 1.0f},
+    {0.6f, 0.5f, 0.7f, 1.0f}, {0.8f, 0.7f, 0.5f, 1.0f}
+};
 
-    // Royal blue coat
-    glColor3f(0.15f, 0.35f, 0.65f);
-    glPushMatrix();
-    glTranslatef(0, -5, 0);
-    glScalef(5, 9, 4);
-    glutSolidCube(1.0f);
-    glPopMatrix();
+// Store a baked part for the types first to last, which share the mesh
+static void storePlanetMesh(int part, int first, int last, const std::vector<MeshVertex>& vertices) {
+    int mesh = rStoreMesh(planetBatches.mesh[first][part], vertices.data(), (int)vertices.size());
+    for (int t = first; t <= last; t++) planetBatches.mesh[t][part] = mesh;
+}
 
-    // Golden buttons
-    glColor3f(1.0f, 0.85f, 0.2f);
-    for (int i = 0; i < 3; i++) {
-        glPushMatrix();
-        glTranslatef(0, -2 + i * 2, 2.5f);
-        glutSolidSphere(0.3f, 6, 6);
-        glPopMatrix();
-    }
+// Little Prince planetoids with glass-domed roses, baked at the current
+// tessellation. Runs on the GL thread while no lists are being built.
+void bakePlanetMeshes() {
+    if (planetBatches.tessellation == quality.tessellationPercent) return;
+    std::vector<MeshVertex> v;
+    BakeTransform xf;
 
-    // Head
-    glColor3f(0.96f, 0.87f, 0.78f);
-    glPushMatrix();
-    glTranslatef(0, 3, 0);
-    glutSolidSphere(3.5f, 14, 14);
-    glPopMatrix();
+    // Planetoid body
+    for (int t = 0; t < PLANET_TYPES; t++) {
+        v.clear();
+        bakeReset(xf);
+        bakeSphere(v, xf, 1.0f, rTessellate(16, 4), rTessellate(12, 3), PLANET_BODY_COLORS[t]);
+        storePlanetMesh(PLANET_MESH_BODY, t, t, v);
+    }
 
-    // Curly hair
-    glColor3f(1.0f, 0.92f, 0.65f);
-    glPushMatrix();
-    glTranslatef(0, 6, 0);
-    glutSolidSphere(3.2f, 12, 10);
-    glPopMatrix();
+    // Rose stem base and bloom
+    const float stem[4] = {0.15f, 0.4f, 0.15f, 1.0f};
+    const float bloom[4] = {0.85f, 0.15f, 0.2f, 1.0f};
+    v.clear();
+    bakeReset(xf);
+    bakeTranslate(xf, 0, 8, 0);
+    bakeScale(xf, 0.8f, 6, 0.8f);
+    bakeCube(v, xf, 1.0f, stem);
+    bakeReset(xf);
+    bakeTranslate(xf, 0, 12, 0);
+    bakeSphere(v, xf, 2.2f, rTessellate(12, 4), rTessellate(12, 3), bloom);
+    storePlanetMesh(PLANET_MESH_ROSE, 0, PLANET_TYPES - 1, v);
 
-    // Hair curls
+    // Rose petals
+    v.clear();
     for (int i = 0; i < 6; i++) {
-        glPushMatrix();
-        glTranslatef(0, 6, 0);
-        glRotatef(i * 60, 0, 1, 0);
-        glTranslatef(2.8f, sin(gameTime + i) * 0.3f, 0);
-        glutSolidSphere(0.6f, 6, 6);
-        glPopMatrix();
+        const float petal[4] = {0.9f, 0.25f + i * 0.03f, 0.3f, 1.0f};
+        bakeReset(xf);
+        bakeRotate(xf, i * 60, 0, 1, 0);
+        bakeTranslate(xf, 1.8f, 0, 0);
+        bakeSphere(v, xf, 0.8f, rTessellate(8, 4), rTessellate(8, 3), petal);
     }
+    storePlanetMesh(PLANET_MESH_PETALS, 0, PLANET_TYPES - 1, v);
+
+    // GLASS DOME (key element from the book!) and its base ring
+    const float ring[4] = {0.8f, 0.85f, 0.9f, 0.6f};
+    v.assign(GLASS_DOME_TABLE.vertices, GLASS_DOME_TABLE.vertices + DOME_VERTEX_COUNT);
+    for (size_t i = 0; i < v.size(); i++) v[i].y += 10;
+    bakeReset(xf);
+    bakeTranslate(xf, 0, 8, 0);
+    bakeTorus(v, xf, 0.5f, 4.5f, rTessellate(8, 4), rTessellate(16, 6), ring);
+    storePlanetMesh(PLANET_MESH_DOME, 0, PLANET_TYPES - 1, v);
+
+    // Planet-specific decorations, sized per instance
+    const float crate[4] = {0.8f, 0.5f, 0.2f, 1.0f};
+    const float well[4] = {0.7f, 0.6f, 0.2f, 1.0f};
+    v.clear();
+    bakeReset(xf);
+    bakeCube(v, xf, 1.0f, crate);
+    storePlanetMesh(PLANET_MESH_DECORATION, 2, 2, v);
+    v.clear();
+    bakeCube(v, xf, 1.0f, well);
+    storePlanetMesh(PLANET_MESH_DECORATION, 3, 3, v);
+
+    // Multiple roses for home planet
+    const float rose[4] = {0.8f, 0.2f, 0.25f, 1.0f};
+    const float dome[4] = {0.9f, 0.95f, 1.0f, 0.25f};
+    v.clear();
+    bakeReset(xf);
+    bakeTranslate(xf, 0, 8, 0);
+    bakeSphere(v, xf, 1.5f, rTessellate(8, 4), rTessellate(8, 3), rose);
+    storePlanetMesh(PLANET_MESH_HOME_ROSE, 4, 4, v);
+    v.clear();
+    bakeReset(xf);
+    bakeTranslate(xf, 0, 9, 0);
+    bakeSphere(v, xf, 2.5f, rTessellate(10, 4), rTessellate(8, 3), dome);
+    storePlanetMesh(PLANET_MESH_HOME_DOME, 4, 4, v);
+
+    planetBatches.tessellation = quality.tessellationPercent;
+}
 
-    // Arms
-    glColor3f(0.15f, 0.35f, 0.65f);
-    glPushMatrix();
-    glTranslatef(-3.5f, -1, 0);
-    glScalef(2, 6, 2);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(3.5f, -1, 0);
-    glScalef(2, 6, 2);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-
-    // Legs
-    glColor3f(0.25f, 0.25f, 0.35f);
-    glPushMatrix();
-    glTranslatef(-1.5f, -12, 0);
-    glScalef(2, 7, 2);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(1.5f, -12, 0);
-    glScalef(2, 7, 2);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-
-    // Boots
-    glColor3f(0.4f, 0.25f, 0.1f);
-    glPushMatrix();
-    glTranslatef(-1.5f, -16, 1);
-    glScalef(2.5f, 2, 3.5f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(1.5f, -16, 1);
-    glScalef(2.5f, 2, 3.5f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
+// What sets a planet type's batches apart, fixed at compile time so each
+// type's renderer carries no per-planet branches
+template <int Type> struct PlanetTraits {
+    static const bool decorated = Type == 2 || Type == 3;
+    static const int decorationSize = Type == 2 ? 4 : 1;    // crate, well
+    static const bool home = Type == 4;
+};
 
-    // Sword
-    glColor3f(0.7f, 0.7f, 0.8f);
-    glPushMatrix();
-    glTranslatef(-4, -3, 0);
-    glRotatef(25, 0, 0, 1);
-    glScalef(0.3f, 6, 0.2f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
-
-    // Yellow scarf
-    player.scarfWave += 0.12f;
-    glColor3f(1.0f, 0.88f, 0.25f);
-
-    glPushMatrix();
-    glTranslatef(1.2f, 1, 0);
-    glRotatef(sin(player.scarfWave) * 12 + 8, 0, 0, 1);
-    glScalef(1.2f, 7, 0.6f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
+static MeshInstance planetInstance(const Mat4& model, float scale) {
+    MeshInstance instance;
+    instance.model = model;
+    instance.scale = scale;
+    return instance;
+}
 
-    // Scarf tail
-    for (int i = 0; i < 3; i++) {
-        glPushMatrix();
-        glTranslatef(2.5f + i * 1.5f, -1 - i * 2, 0);
-        glRotatef(sin(player.scarfWave + i * 0.5f) * 18 + 35 + i * 10, 0, 0, 1);
-        glScalef(0.8f - i * 0.1f, 4 - i * 0.5f, 0.5f);
-        glutSolidCube(1.0f);
-        glPopMatrix();
-    }
-
-    // Effects when jumping
-    if (!player.onGround) {
-        glColor4f(0.12f, 0.3f, 0.6f, 0.7f);
-        glPushMatrix();
-        glTranslatef(0, -3, -2);
-        glRotatef(10, 1, 0, 0);
-        glScalef(7, 6, 0.6f);
-        glutSolidCube(1.0f);
-        glPopMatrix();
-
-        // Starlight aura
-        glColor3f(1.0f, 1.0f, 0.95f);
-        for (int i = 0; i < 8; i++) {
-            glPushMatrix();
-            float angle = gameTime * 1.2f + i * 0.785f;
-            float radius = 10 + sin(gameTime * 2 + i) * 2;
-            glTranslatef(sin(angle) * radius, cos(angle * 1.1f) * 6, cos(angle) * 4);
-            glutSolidSphere(0.5f, 6, 6);
-            glPopMatrix();
+// One instanced draw per part for every planet of a type in view. Opaque
+// parts go in one pass and the glass in the next, so every type's glass is
+// drawn over every type's planets as before.
+template <int Type>
+static void addPlanetBatches(DrawList& list, const std::vector<PlanetInView>& inView, bool glass) {
+    typedef PlanetTraits<Type> Traits;
+    const int* mesh = planetBatches.mesh[Type];
+    int count = (int)inView.size();
+    if (count == 0) return;
+
+    if (glass) {
+        MeshInstance* domes = drawListInstances(list, mesh[PLANET_MESH_DOME], count, DRAW_BLEND);
+        for (int i = 0; i < count; i++) domes[i] = planetInstance(inView[i].parts[PLANET_ROOT].world, 1);
+        if (Traits::home) {
+            MeshInstance* homeDomes = drawListInstances(list, mesh[PLANET_MESH_HOME_DOME], count * 3, DRAW_BLEND);
+            for (int i = 0; i < count * 3; i++) {
+                homeDomes[i] = planetInstance(inView[i / 3].parts[PLANET_HOME + i % 3].world, 1);
+            }
         }
+        return;
     }
 
-    glPopMatrix();
+    MeshInstance* bodies = drawListInstances(list, mesh[PLANET_MESH_BODY], count);
+    for (int i = 0; i < count; i++) bodies[i] = planetInstance(inView[i].parts[PLANET_BODY].world, inView[i].width / 2.5f);
+    MeshInstance* roses = drawListInstances(list, mesh[PLANET_MESH_ROSE], count);
+    for (int i = 0; i < count; i++) roses[i] = planetInstance(inView[i].parts[PLANET_ROOT].world, 1);
+    MeshInstance* petals = drawListInstances(list, mesh[PLANET_MESH_PETALS], count);
+    for (int i = 0; i < count; i++) petals[i] = planetInstance(inView[i].parts[PLANET_PETALS].world, 1);
+
+    if (Traits::decorated) {
+        MeshInstance* decorations = drawListInstances(list, mesh[PLANET_MESH_DECORATION], count);
+        for (int i = 0; i < count; i++) {
+            decorations[i] = planetInstance(inView[i].parts[PLANET_DECORATION].world, Traits::decorationSize);
+        }
+    }
+    if (Traits::home) {
+        MeshInstance* homeRoses = drawListInstances(list, mesh[PLANET_MESH_HOME_ROSE], count * 3);
+        for (int i = 0; i < count * 3; i++) {
+            homeRoses[i] = planetInstance(inView[i / 3].parts[PLANET_HOME + i % 3].world, 1);
+        }
+    }
 }
 
-// Draw text function
-void drawText(float x, float y, const char* text) {
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    gluOrtho2D(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT);
+// Planets in view, grouped by type; the table is sorted by height, so skip
+// straight to the first one in view and stop at the first one above it
+static void buildPlanetList(DrawList& list) {
+    beginDrawList(list, sceneLists.view);
+    std::vector<PlanetInView>* inView = planetBatches.inView;
+    for (int t = 0; t < PLANET_TYPES; t++) inView[t].clear();
+
+    for (size_t i = firstRowAbove(planets, cameraY - 200); i < planets.size(); i++) {
+        const Position& pos = planets.position[i];
+        if (pos.y >= cameraY + 600) break;
+        if (pos.y <= cameraY - 200) continue;
+
+        int type = planets.kind[i];
+        RigKey key = {pos.x, pos.y, pos.z, planets.spin[i].angle, planets.extent[i].width, type};
+        PlanetInView planet = {rigNodes(planetRig, planets.size(), i, key), planets.extent[i].width};
+        inView[type].push_back(planet);
+        planetBatches.planets++;
+    }
+
+    for (int glass = 0; glass < 2; glass++) {
+        addPlanetBatches<0>(list, inView[0], glass != 0);
+        addPlanetBatches<1>(list, inView[1], glass != 0);
+        addPlanetBatches<2>(list, inView[2], glass != 0);
+        addPlanetBatches<3>(list, inView[3], glass != 0);
+        addPlanetBatches<4>(list, inView[4], glass != 0);
+    }
+    planetBatches.frames++;
+    planetBatches.draws += list.items.size();
+}
 
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
+void reportPlanetBatchStats() {
+    if (planetBatches.frames == 0) return;
+    double frames = planetBatches.frames;
+    std::cerr << "planets: " << planetBatches.planets / frames << " per frame in " << planetBatches.draws / frames
+              << " instanced draws" << std::endl;
+    planetBatches.frames = 0;
+    planetBatches.planets = planetBatches.draws = 0;
+}
 
-    glDisable(GL_LIGHTING);
-    glDisable(GL_DEPTH_TEST);
+void (*const SCENE_LIST_BUILDERS[SCENE_LISTS])(DrawList& list) = {
+    buildNebulaList, buildStarList, buildShootingStarList, buildStardustList, buildRosePetalList,
+    buildDecorationList, buildPlanetList
+};
 
-    glRasterPos2f(x, y);
-    for (const char* c = text; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+// Build lists until none are left unclaimed; run by the helpers and by the
+// GL thread itself
+static void buildSceneListsJob(void*) {
+    for (;;) {
+        int i = sceneLists.nextList.fetch_add(1, std::memory_order_relaxed);
+        if (i >= SCENE_LISTS) return;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        SCENE_LIST_BUILDERS[i](sceneLists.lists[i]);
+        sceneLists.lists[i].buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
+}
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-
-    glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
+// A helper's part, with what it allocates counted towards the frame
+static void buildSceneListsOnHelper(void* arg) {
+    AllocationShare& share = *(AllocationShare*)arg;
+    beginAllocationShare(share, frameAllocations);
+    buildSceneListsJob(0);
+    endAllocationShare(share);
 }
 
-// Game functions
-float getCurrentScrollSpeed() {
-    return BASE_SCROLL_SPEED + (currentLevel - 1) * SPEED_MULTIPLIER;
+void setSceneListThreads(int threads) {
+    sceneLists.threads = std::max(1, std::min(MAX_DRAW_THREADS, threads));
+    for (int i = 0; i < sceneLists.threads - 1; i++) startWorker(sceneLists.workers[i]);
 }
 
-void checkExplorationBonus() {
-    if (planetsVisited > 0 && planetsVisited % PLANETS_FOR_BONUS == 0) {
-        int bonus = EXPLORATION_BONUS * currentLevel;
-        addPoints(bonus, player.x, player.y + 50);
-        explorationBoostTimer = 60;
-        planetsVisited = 0;
-    }
+void stopSceneListThreads() {
+    for (int i = 0; i < MAX_DRAW_THREADS - 1; i++) stopWorker(sceneLists.workers[i]);
 }
 
-void updateSpeedEffects() {
-    if (explorationBoostTimer > 0) {
-        explorationBoostTimer--;
-    }
-    currentScrollSpeed = getCurrentScrollSpeed();
+// Room for every row of every table being in view at full quality
+void reserveSceneLists() {
+    DrawList* lists = sceneLists.lists;
+    reserveDrawList(lists[LIST_NEBULA], NEBULA_CLOUDS * (size_t)QUALITY_KNOBS[KNOB_NEBULA].values[0], 0, 0, 0);
+    reserveDrawList(lists[LIST_STARS], 2, STAR_TILE_CACHE * (STARS_PER_TILE + 1), 0, 0);
+    reserveDrawList(lists[LIST_SHOOTING_STARS], 2, shootingStars.size() * 3, 0, 0);
+    reserveDrawList(lists[LIST_STARDUST], stardust.size() * 5, 0, 0, 0);
+    reserveDrawList(lists[LIST_ROSE_PETALS], rosePetals.size() * 2, 0, 0, 0);
+    reserveDrawList(lists[LIST_DECORATIONS], roses.size() * ROSE_PARTS + foxes.size() * FOX_PARTS + 2, 0,
+                    (roses.size() + foxes.size()) * 6, 0);
+
+    // Planets: a batch per type and mesh, and the home planet's ten instances for each
+    size_t planetCount = chapterPlanetCount(levelRules, MAX_LEVELS);
+    reserveDrawList(lists[LIST_PLANETS], PLANET_TYPES * PLANET_MESHES, 0, 0, planetCount * 10);
+    for (int t = 0; t < PLANET_TYPES; t++) planetBatches.inView[t].reserve(planetCount);
 }
 
-void updateCombo() {
-    if (player.comboTimer > 0) {
-        player.comboTimer--;
-    } else if (player.combo > 0) {
-        player.combo = 0;
+// Hand the lists to the helpers for the camera's view. Until
+// finishSceneLists() the GL thread may draw, but must not change what the
+// lists are built from.
+void startSceneLists(const Mat4& view) {
+    sceneLists.view = view;
+    sceneLists.nextList.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < sceneLists.threads - 1; i++) {
+        submitJob(sceneLists.workers[i], buildSceneListsOnHelper, &sceneLists.shares[i]);
     }
 }
 
-void addPoints(int points, float x, float y) {
-    score += points;
-    if (score > highScore) {
-        highScore = score;
+// Build whatever the helpers have not claimed, then wait for them
+void finishSceneLists() {
+    buildSceneListsJob(0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < sceneLists.threads - 1; i++) waitForWorker(sceneLists.workers[i]);
+    sceneLists.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i < sceneLists.threads - 1; i++) {
+        addAllocationShare(frameAllocations, sceneLists.shares[i]);
+        sceneLists.shares[i] = AllocationShare();
     }
+    for (int i = 0; i < SCENE_LISTS; i++) sceneLists.buildMs += sceneLists.lists[i].buildMs;
+    sceneLists.frames++;
 }
 
-bool isPlanetVisible(int planetIndex) {
-    if (planetIndex >= (int)planets.size()) return false;
-    float planetY = planets[planetIndex].y;
-    return (planetY >= cameraY - 100 && planetY <= cameraY + 500);
+void submitSceneList(int list) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    submitDrawList(sceneLists.lists[list]);
+    sceneLists.submitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
-void resetGame() {
-    currentLevel = 1;
-    createPlanets();
-
-    player.x = 0;
-    player.y = 50;
-    player.z = 0;
-    player.vx = 0;
-    player.vy = 0;
-    player.onGround = true;
-    player.jumpCount = 0;
-    player.lastPlanetIndex = 0;
-    player.planetsExplored = 0;
-    player.combo = 0;
-    player.comboTimer = 0;
-    player.rotation = 0;
-    player.bobOffset = 0;
-    player.scarfWave = 0;
-    player.timeInSpace = 0;
-    player.driftingIntoSpace = false;
+void reportSceneListStats() {
+    if (sceneLists.frames == 0) return;
+    double frames = sceneLists.frames;
+    std::cerr << "draw lists: built on " << sceneLists.threads << " threads, per frame " << sceneLists.buildMs / frames
+              << " ms building, " << sceneLists.waitMs / frames << " ms waiting for helpers, "
+              << sceneLists.submitMs / frames << " ms submitting" << std::endl;
+    sceneLists.frames = 0;
+    sceneLists.buildMs = sceneLists.waitMs = sceneLists.submitMs = 0;
+}
 
-    cameraY = 0;
-    score = 0;
-    planetsVisited = 0;
-    totalPlanetsExplored = 0;
-    currentScrollSpeed = BASE_SCROLL_SPEED;
-    explorationBoostTimer = 0;
-    gameRunning = true;
-    gameTime = 0;
+static void addMeshPart(CharacterMesh& mesh, int kind, int index, int first) {
+    mesh.parts.push_back(MeshPart(kind, index, first, (int)mesh.baseVertices.size() - first));
 }
 
-void advanceToNextLevel() {
-    addPoints(LEVEL_COMPLETION_BONUS * currentLevel, player.x, player.y + 30);
-    currentLevel++;
+// Bake The Little Prince into one vertex array with animated part groups
+void buildPrinceMesh() {
+    CharacterMesh& mesh = princeMesh;
+    std::vector<MeshVertex>& v = mesh.baseVertices;
+    v.clear();
+    mesh.parts.clear();
+
+    const float coatColor[4] = {0.15f, 0.35f, 0.65f, 1.0f};
+    const float buttonColor[4] = {1.0f, 0.85f, 0.2f, 1.0f};
+    const float skinColor[4] = {0.96f, 0.87f, 0.78f, 1.0f};
+    const float hairColor[4] = {1.0f, 0.92f, 0.65f, 1.0f};
+    const float legColor[4] = {0.25f, 0.25f, 0.35f, 1.0f};
+    const float bootColor[4] = {0.4f, 0.25f, 0.1f, 1.0f};
+    const float swordColor[4] = {0.7f, 0.7f, 0.8f, 1.0f};
+    const float scarfColor[4] = {1.0f, 0.88f, 0.25f, 1.0f};
+    const float capeColor[4] = {0.12f, 0.3f, 0.6f, 0.7f};
+    const float auraColor[4] = {1.0f, 1.0f, 0.95f, 1.0f};
+
+    BakeTransform xf;
+    int first = 0;
 
-    if (currentLevel > MAX_LEVELS) {
-        gameRunning = false;
-        return;
+    // Royal blue coat
+    bakeReset(xf);
+    bakeTranslate(xf, 0, -5, 0);
+    bakeScale(xf, 5, 9, 4);
+    bakeCube(v, xf, 1.0f, coatColor);
+
+    // Golden buttons
+    for (int i = 0; i < 3; i++) {
+        bakeReset(xf);
+        bakeTranslate(xf, 0, -2 + i * 2, 2.5f);
+        bakeSphere(v, xf, 0.3f, 6, 6, buttonColor);
     }
 
-    createPlanets();
+    // Head
+    bakeReset(xf);
+    bakeTranslate(xf, 0, 3, 0);
+    bakeSphere(v, xf, 3.5f, 14, 14, skinColor);
 
-    player.x = 0;
-    player.y = 50;
-    player.z = 0;
-    player.vx = 0;
-    player.vy = 0;
-    player.onGround = true;
-    player.jumpCount = 0;
-    player.lastPlanetIndex = 0;
-    player.planetsExplored = 0;
-    player.comboTimer = 100;
+    // Curly hair
+    bakeReset(xf);
+    bakeTranslate(xf, 0, 6, 0);
+    bakeSphere(v, xf, 3.2f, 12, 10, hairColor);
 
-    planetsVisited = 0;
-    explorationBoostTimer = 120;
-    cameraY = 0;
-}
+    // Arms
+    for (int side = -1; side <= 1; side += 2) {
+        bakeReset(xf);
+        bakeTranslate(xf, side * 3.5f, -1, 0);
+        bakeScale(xf, 2, 6, 2);
+        bakeCube(v, xf, 1.0f, coatColor);
+    }
 
-void init() {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Legs
+    for (int side = -1; side <= 1; side += 2) {
+        bakeReset(xf);
+        bakeTranslate(xf, side * 1.5f, -12, 0);
+        bakeScale(xf, 2, 7, 2);
+        bakeCube(v, xf, 1.0f, legColor);
+    }
 
-    setupLighting();
-    createStars();
-    createRoses();
-    createFoxes();
+    // Boots
+    for (int side = -1; side <= 1; side += 2) {
+        bakeReset(xf);
+        bakeTranslate(xf, side * 1.5f, -16, 1);
+        bakeScale(xf, 2.5f, 2, 3.5f);
+        bakeCube(v, xf, 1.0f, bootColor);
+    }
+
+    // Sword
+    bakeReset(xf);
+    bakeTranslate(xf, -4, -3, 0);
+    bakeRotate(xf, 25, 0, 0, 1);
+    bakeScale(xf, 0.3f, 6, 0.2f);
+    bakeCube(v, xf, 1.0f, swordColor);
+
+    addMeshPart(mesh, PART_STATIC, 0, first);
+
+    // Hair curls, posed around the head every frame
+    for (int i = 0; i < 6; i++) {
+        first = v.size();
+        bakeReset(xf);
+        bakeSphere(v, xf, 0.6f, 6, 6, hairColor);
+        addMeshPart(mesh, PART_HAIR_CURL, i, first);
+    }
+
+    // Yellow scarf; scale is baked so the per-frame pose stays rigid
+    first = v.size();
+    bakeReset(xf);
+    bakeScale(xf, 1.2f, 7, 0.6f);
+    bakeCube(v, xf, 1.0f, scarfColor);
+    addMeshPart(mesh, PART_SCARF, 0, first);
+
+    // Scarf tail
+    for (int i = 0; i < 3; i++) {
+        first = v.size();
+        bakeReset(xf);
+        bakeScale(xf, 0.8f - i * 0.1f, 4 - i * 0.5f, 0.5f);
+        bakeCube(v, xf, 1.0f, scarfColor);
+        addMeshPart(mesh, PART_SCARF_TAIL, i, first);
+    }
+
+    mesh.groundedVertexCount = v.size();
+
+    // Cape, only shown when jumping
+    first = v.size();
+    bakeReset(xf);
+    bakeTranslate(xf, 0, -3, -2);
+    bakeRotate(xf, 10, 1, 0, 0);
+    bakeScale(xf, 7, 6, 0.6f);
+    bakeCube(v, xf, 1.0f, capeColor);
+    addMeshPart(mesh, PART_STATIC, 1, first);
+
+    // Starlight aura, only shown when jumping
+    for (int i = 0; i < 8; i++) {
+        first = v.size();
+        bakeReset(xf);
+        bakeSphere(v, xf, 0.5f, 6, 6, auraColor);
+        addMeshPart(mesh, PART_AURA, i, first);
+    }
+
+    mesh.posedVertices = mesh.baseVertices;
+
+    // Joints of the animated parts. The fixed offset of each part is a
+    // static parent node; only the animated child is set per pose.
+    clearTransforms(princeRig);
+    for (size_t i = 0; i < mesh.parts.size(); i++) {
+        MeshPart& part = mesh.parts[i];
+        int base = -1;
+        switch (part.kind) {
+            case PART_HAIR_CURL:
+                base = addTransform(princeRig, -1, mat4Multiply(mat4Translate(0, 6, 0), mat4Rotate(part.index * 60, 0, 1, 0)));
+                break;
+            case PART_SCARF:
+                base = addTransform(princeRig, -1, mat4Translate(1.2f, 1, 0));
+                break;
+            case PART_SCARF_TAIL:
+                base = addTransform(princeRig, -1, mat4Translate(2.5f + part.index * 1.5f, -1 - part.index * 2, 0));
+                break;
+            case PART_AURA:
+                break;
+            default:
+                continue;
+        }
+        part.node = addTransform(princeRig, base, mat4Identity());
+    }
+}
+
+// Apply per-part animation transforms for this frame. Static parts were
+// copied at bake time and are never touched again.
+void posePrinceMesh(const Player& p, float scarfWave) {
+    CharacterMesh& mesh = princeMesh;
+
+    // Shared time terms of the aura; per-spark phases come from AURA_PHASE_TABLE
+    float sinT = 0, cosT = 0, sinTs = 0, cosTs = 0, sinR = 0, cosR = 0;
+    if (!p.onGround) {
+        sinT = sin(gameTime * 1.2f);
+        cosT = cos(gameTime * 1.2f);
+        sinTs = sin(gameTime * 1.2f * 1.1f);
+        cosTs = cos(gameTime * 1.2f * 1.1f);
+        sinR = sin(gameTime * 2);
+        cosR = cos(gameTime * 2);
+    }
+
+    for (size_t i = 0; i < mesh.parts.size(); i++) {
+        const MeshPart& part = mesh.parts[i];
+
+        switch (part.kind) {
+            case PART_HAIR_CURL:
+                setTransform(princeRig, part.node, mat4Translate(2.8f, sin(gameTime + part.index) * 0.3f, 0));
+                break;
+            case PART_SCARF:
+                setTransform(princeRig, part.node, mat4Rotate(sin(scarfWave) * 12 + 8, 0, 0, 1));
+                break;
+            case PART_SCARF_TAIL: {
+                int t = part.index;
+                setTransform(princeRig, part.node, mat4Rotate(sin(scarfWave + t * 0.5f) * 18 + 35 + t * 10, 0, 0, 1));
+                break;
+            }
+            case PART_AURA: {
+                if (p.onGround) continue;
+                const AuraPhaseTable& t = AURA_PHASE_TABLE;
+                int i = part.index;
+                float sinAngle = sinT * t.cosPhase[i] + cosT * t.sinPhase[i];
+                float cosAngle = cosT * t.cosPhase[i] - sinT * t.sinPhase[i];
+                float cosStretch = cosTs * t.cosPhaseStretch[i] - sinTs * t.sinPhaseStretch[i];
+                float radius = 10 + (sinR * t.cosRadiusPhase[i] + cosR * t.sinRadiusPhase[i]) * 2;
+                setTransform(princeRig, part.node, mat4Translate(sinAngle * radius, cosStretch * 6, cosAngle * 4));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    updateTransforms(princeRig, 0, (int)princeRig.nodes.size());
+
+    for (size_t i = 0; i < mesh.parts.size(); i++) {
+        const MeshPart& part = mesh.parts[i];
+        if (part.node < 0 || (part.kind == PART_AURA && p.onGround)) continue;
+
+        // Poses are rigid, so the same 3x3 transforms positions and normals
+        const float* m = princeRig.nodes[part.node].world.m;
+        for (int k = part.first; k < part.first + part.count; k++) {
+            const MeshVertex& src = mesh.baseVertices[k];
+            MeshVertex& dst = mesh.posedVertices[k];
+            dst.x = m[0] * src.x + m[4] * src.y + m[8] * src.z + m[12];
+            dst.y = m[1] * src.x + m[5] * src.y + m[9] * src.z + m[13];
+            dst.z = m[2] * src.x + m[6] * src.y + m[10] * src.z + m[14];
+            dst.nx = m[0] * src.nx + m[4] * src.ny + m[8] * src.nz;
+            dst.ny = m[1] * src.nx + m[5] * src.ny + m[9] * src.nz;
+            dst.nz = m[2] * src.nx + m[6] * src.ny + m[10] * src.nz;
+        }
+    }
+}
+
+// Draw a prince (local player or ghost) with a single vertex array call.
+// The scarf's phase comes from game time, so drawing never changes the
+// simulation state.
+void drawPrinceCharacter(const Player& p, float scarfWave) {
+    CharacterMesh& mesh = princeMesh;
+    if (mesh.posedVertices.empty()) return;
+
+    posePrinceMesh(p, scarfWave);
+
+    Mat4 view = rModelView();
+    Mat4 place = mat4Multiply(mat4Translate(p.x, p.y + p.bobOffset, p.z), mat4Rotate(p.rotation, 0, 1, 0));
+    rLoadMatrix(mat4Multiply(view, place));
+
+    int count = p.onGround ? mesh.groundedVertexCount : (int)mesh.posedVertices.size();
+    rDrawVertices(GL_TRIANGLES, &mesh.posedVertices[0], count);
+
+    rLoadMatrix(view);
+}
+
+// Draw The Little Prince character
+void drawLittlePrince() {
+    if (player.onGround) {
+        Mat4 view = rModelView();
+        rLoadMatrix(mat4Multiply(view, mat4Translate(player.x, planets.position[player.lastPlanetIndex].y + 1, player.z)));
+        rColor4f(0.0f, 0.0f, 0.0f, 0.3f);
+        rBegin(GL_QUADS);
+        rVertex3f(-4, 0, -4);
+        rVertex3f(4, 0, -4);
+        rVertex3f(4, 0, 4);
+        rVertex3f(-4, 0, 4);
+        rEnd();
+        rLoadMatrix(view);
+    }
+
+    drawPrinceCharacter(player, gameTime * SCARF_WAVE_SPEED);
+}
+
+// Draw the other princes that are still in the race and near the camera
+void drawGhosts() {
+    for (int i = 1; i < playerCount; i++) {
+        const Player& p = players[i];
+        if (!p.alive || p.y < cameraY - 100 || p.y > cameraY + 600) continue;
+        drawPrinceCharacter(p, gameTime * SCARF_WAVE_SPEED + i);
+    }
+}
+
+// Draw text function
+void drawText(float x, float y, const char* text) {
+    rBitmapText(x, y, WINDOW_WIDTH, WINDOW_HEIGHT, text);
+}
+
+// Game functions
+float getCurrentScrollSpeed() {
+    return BASE_SCROLL_SPEED + (currentLevel - 1) * SPEED_MULTIPLIER;
+}
+
+void checkExplorationBonus() {
+    if (planetsVisited > 0 && planetsVisited % PLANETS_FOR_BONUS == 0) {
+        int bonus = EXPLORATION_BONUS * currentLevel;
+        addPoints(player, bonus, player.x, player.y + 50);
+        telemetryEvent(TELEMETRY_EXPLORATION_BONUS, 0, simulationTick, bonus);
+        playSound(SOUND_EXPLORATION_BONUS);
+        explorationBoostTimer = 60;
+        planetsVisited = 0;
+    }
+}
+
+void updateSpeedEffects() {
+    if (explorationBoostTimer > 0) {
+        explorationBoostTimer--;
+    }
+    currentScrollSpeed = getCurrentScrollSpeed();
+}
+
+void updateCombo(Player& p) {
+    if (p.comboTimer > 0) {
+        p.comboTimer--;
+    } else if (p.combo > 0) {
+        p.combo = 0;
+    }
+}
+
+void addPoints(Player& p, int points, float x, float y) {
+    p.score += points;
+    if (&p == &player && p.score > highScore) {
+        highScore = p.score;
+    }
+}
+
+bool isPlanetVisible(int planetIndex) {
+    if (planetIndex >= (int)planets.size()) return false;
+    float planetY = planets.position[planetIndex].y;
+    return (planetY >= cameraY - 100 && planetY <= cameraY + 500);
+}
+
+// Put a player on the first planet. Bots spread out across it so a crowd
+// does not start stacked on one spot.
+void spawnPlayer(Player& p, int index) {
+    p.x = index == 0 ? 0 : (float)((index * 37) % 100 - 50);
+    p.y = 50;
+    p.z = 0;
+    p.vx = 0;
+    p.vy = 0;
+    p.onGround = true;
+    p.jumpCount = 0;
+    p.lastPlanetIndex = 0;
+    p.planetsExplored = 0;
+}
+
+void resetGame() {
+    currentLevel = 1;
+    createPlanets();
+    prefetchChapter(2);
+
+    for (int i = 0; i < playerCount; i++) {
+        players[i] = Player();
+        spawnPlayer(players[i], i);
+    }
+
+    cameraY = 0;
+    for (int i = 0; i < DECORATION_REGIONS; i++) decorationRegions[i] = -1;
+    streamDecorations();
+    planetsVisited = 0;
+    totalPlanetsExplored = 0;
+    currentScrollSpeed = BASE_SCROLL_SPEED;
+    explorationBoostTimer = 0;
+    gameRunning = true;
+    gameTime = 0;
+    simulationTick = 0;
+    clearRewindBuffer(rewindBuffer);
+}
+
+// The first player to reach the final planet takes the level for everyone
+// still in the race
+void advanceToNextLevel(Player& finisher) {
+    int bonus = LEVEL_COMPLETION_BONUS * currentLevel;
+    addPoints(finisher, bonus, finisher.x, finisher.y + 30);
+    telemetryEvent(TELEMETRY_LEVEL_COMPLETE, (int)(&finisher - players), simulationTick, currentLevel, bonus);
+    playSound(SOUND_LEVEL_COMPLETE);
+    currentLevel++;
+
+    if (currentLevel > MAX_LEVELS) {
+        gameRunning = false;
+        return;
+    }
+
+    enterChapter();
+
+    for (int i = 0; i < playerCount; i++) {
+        if (!players[i].alive) continue;
+        spawnPlayer(players[i], i);
+        players[i].comboTimer = 100;
+    }
+
+    planetsVisited = 0;
+    explorationBoostTimer = 120;
+    cameraY = 0;
+    for (int i = 0; i < DECORATION_REGIONS; i++) decorationRegions[i] = -1;
+    streamDecorations();
+}
+
+void init() {
+    rClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    rEnable(GL_DEPTH_TEST);
+    rEnable(GL_BLEND);
+    rBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+#ifndef NDEBUG
+    verifyGeometryTables();
+#endif
+
+    rInit();
+    rSetBackend(requestedBackend);
+    applyQualitySettings();
+    setupLighting();
+    buildPrinceMesh();
+    buildImpostorAtlas();
+    initSimulation();
+    startGhostLink();
+
+    // Everything a frame appends to, sized for the worst case up front
+    size_t decorations = std::max(roses.size(), foxes.size());
+    decorationDraws.reserve(decorations);
+    reserveRig(roseRig, roses.size());
+    reserveRig(foxRig, foxes.size());
+    reserveRig(planetRig, chapterPlanetCount(levelRules, MAX_LEVELS));
+    reserveSceneLists();
+    setSceneListThreads(drawThreads > 0 ? drawThreads : std::min((int)SCENE_LISTS, (int)std::thread::hardware_concurrency()));
+    nextChapter.rig.nodes.reserve(planetRig.tree.nodes.capacity());
+    nextChapter.keys.reserve(planetRig.keys.capacity());
+    int qualitySteps = 0;
+    for (int i = 0; i < QUALITY_KNOB_COUNT; i++) qualitySteps += QUALITY_KNOBS[i].steps;
+    governor.history.reserve(qualitySteps);
+
+    // --overdraw: switch on through the toggle so the stencil is checked
+    if (overdraw.enabled) {
+        overdraw.enabled = false;
+        toggleOverdraw();
+    }
+}
+
+// Everything the simulation needs; no GL, so headless runs can call it too
+void initSimulation() {
+    initLevelRules();
+    initEntityStore(world);
+    if (!worldArena.first) arenaInit(worldArena, "world", WORLD_ARENA_CHUNK);
+    if (!levelArenas[0].first) arenaInit(levelArenas[0], "level A", LEVEL_ARENA_CHUNK);
+    if (!levelArenas[1].first) arenaInit(levelArenas[1], "level B", LEVEL_ARENA_CHUNK);
+    nextChapter.planets.components = planets.components;
+    arenaReset(worldArena);
+    for (int i = 0; i < ARCH_COUNT; i++) {
+        if (i != ARCH_PLANET) bindTable(world.tables[i], &worldArena);
+    }
+    initRewindBuffer(rewindBuffer, REWIND_FRAMES, REWIND_KEYFRAME_INTERVAL);
+    createDecorations();
     createShootingStars();
     createRosePetals();
     createStardust();
+    startWorker(chapterWorker);
     resetGame();
+    waitForWorker(chapterWorker);
+    entityHeapBaseline = entityHeapAllocations();
+
+    // Size the rewind ring for the final chapter, which has the most planets
+    // and so the largest state, so recording never allocates mid-game
+    if (!headless) {
+        saveGameState(tickState);
+        size_t morePlanets = chapterPlanetCount(levelRules, MAX_LEVELS) - planets.size();
+        size_t largestState = tickState.size() + morePlanets * tableRowBytes(planets);
+        tickState.reserve(largestState);
+        reserveRewindBuffer(rewindBuffer, largestState);
+    }
 }
 
 void update(int value) {
+    // Once the game over screen's scene is captured there is nothing to
+    // tick for; the loop sleeps until a key press restarts it
+    if (screenIsIdle() && !rewindHeld && idleScreen.tick == simulationTick) {
+        idleScreen.sleeping = true;
+        return;
+    }
+
+    beginAllocationPeriod(tickAllocations);
+    if (rewindHeld) {
+        rewindOneTick();
+    } else {
+        stepSimulation();
+        recordRewindFrame();
+    }
+    sendGhostFrame();
+    receiveGhostFrames();
+    endAllocationPeriod(tickAllocations);
+
+    glutPostRedisplay();
+    glutTimerFunc(16, update, 0);
+}
+
+// One fixed 16 ms simulation tick
+void stepSimulation() {
+    simulationTick++;
     gameTime += 0.016f;
 
+    // Taps shorter than a tick still count as held for this tick
+    bool leftTapped = false;
+    bool rightTapped = false;
+    consumeInputEvents(leftTapped, rightTapped);
+    bool moveLeft = leftKey || leftTapped;
+    bool moveRight = rightKey || rightTapped;
+
+    // Decorations keep turning on the title and game over screens too
+    integrateMotion(roses, roses.size());
+    integrateMotion(foxes, foxes.size());
+
     if (gameRunning) {
-        updateCombo();
         updateSpeedEffects();
         updateAtmosphericEffects();
 
@@ -1073,7 +2169,7 @@ void update(int value) {
         cameraY += currentScrollSpeed;
 
         for (size_t i = 0; i < planets.size(); i++) {
-            if (planets[i].y < oldCameraY && planets[i].y >= oldCameraY - currentScrollSpeed) {
+            if (planets.position[i].y < oldCameraY && planets.position[i].y >= oldCameraY - currentScrollSpeed) {
                 planetsVisited++;
                 totalPlanetsExplored++;
                 checkExplorationBonus();
@@ -1081,317 +2177,1345 @@ void update(int value) {
             }
         }
 
-        // Player movement
-        if (leftKey) {
-            player.vx = -MOVE_SPEED;
-            player.rotation = 45;
-        } else if (rightKey) {
-            player.vx = MOVE_SPEED;
-            player.rotation = -45;
-        } else {
-            player.vx = 0;
-            player.rotation = 0;
+        PlayerControls local = {moveLeft, moveRight, jumpRequested};
+        for (int i = 0; i < playerCount; i++) {
+            Player& p = players[i];
+            if (!p.alive) continue;
+            updateCombo(p);
+            stepPlayer(p, i < humanPlayers ? local : botControls(p, i));
         }
 
-        // Auto-adjust Z position
-        if (!player.onGround && planets.size() > 0) {
-            float nearestPlanetZ = 0;
-            float minDistance = 999999;
-            for (size_t i = 0; i < planets.size(); i++) {
-                if (planets[i].y > player.y - 100 && planets[i].y < player.y + 50) {
-                    float distance = fabs(player.x - planets[i].x);
-                    if (distance < minDistance) {
-                        minDistance = distance;
-                        nearestPlanetZ = planets[i].z;
-                    }
-                }
-            }
-            float zDiff = nearestPlanetZ - player.z;
-            if (fabs(zDiff) > 5) {
-                player.z += zDiff * 0.02f;
+        resolvePlanetCollisions();
+
+        // Camera following the highest player still in the race
+        for (int i = 0; i < playerCount; i++) {
+            if (isCountedPlayer(i) && players[i].y > cameraY + 240) {
+                cameraY = players[i].y - 240;
             }
         }
+        streamDecorations();
+
+        // Game over conditions, per player
+        bool anyoneLeft = false;
+        for (int i = 0; i < playerCount; i++) {
+            Player& p = players[i];
+            if (!p.alive) continue;
+
+            int cause = -1;
+
+            // Drifting into space
+            if (!p.onGround) {
+                p.timeInSpace += 0.016f;
+                if (p.timeInSpace > 3.0f && !p.driftingIntoSpace) {
+                    p.driftingIntoSpace = true;
+                    cause = GAME_OVER_DRIFTED;
+                }
+            } else {
+                p.timeInSpace = 0;
+                p.driftingIntoSpace = false;
+            }
 
-        // Jumping
-        bool newSpacePress = spaceKey && !spaceKeyWasPressed;
-        spaceKeyWasPressed = spaceKey;
-
-        if (player.onGround && newSpacePress) {
-            player.vy = JUMP_FORCE;
-            player.onGround = false;
-            player.jumpCount = 1;
+            if (cause < 0 && p.y < cameraY - 50) {
+                cause = GAME_OVER_FELL;
+            }
+            if (cause < 0 && p.onGround && planets.position[p.lastPlanetIndex].y < cameraY) {
+                cause = GAME_OVER_SUNK;
+            }
+            if (cause >= 0) {
+                p.alive = false;
+                telemetryEvent(TELEMETRY_GAME_OVER, i, simulationTick, cause);
+                if (&p == &player) playSound(SOUND_GAME_OVER);
+            }
 
-            if (leftKey) player.vx = -MOVE_SPEED * JUMP_BOOST;
-            else if (rightKey) player.vx = MOVE_SPEED * JUMP_BOOST;
+            if (isCountedPlayer(i)) anyoneLeft = true;
         }
-
-        // Gravity
-        float currentGravity = GRAVITY;
-        if (player.vy > 0) {
-            currentGravity = GRAVITY * 0.85f;
+        if (!anyoneLeft) {
+            gameRunning = false;
         }
-        player.vy -= currentGravity;
 
-        // Update position
-        player.x += player.vx;
-        player.y += player.vy;
-
-        // Screen wrap
-        if (player.x < -320) player.x = 320;
-        if (player.x > 320) player.x = -320;
-
-        // Bobbing animation
-        if (player.onGround) {
-            player.bobOffset = sin(gameTime * 6) * 2;
-        } else {
-            player.bobOffset = 0;
+        // Level completion, unless the game just ended: a bot still alive
+        // must not move the chapter on under the game over screen
+        for (int i = 0; gameRunning && i < playerCount; i++) {
+            if (players[i].alive && (size_t)players[i].lastPlanetIndex == planets.size() - 1) {
+                advanceToNextLevel(players[i]);
+                break;
+            }
         }
 
-        // Planet collision
-        player.onGround = false;
-        for (size_t i = 0; i < planets.size(); i++) {
-            if (player.vy <= 0) {
-                float dx = player.x - planets[i].x;
-                float dz = player.z - planets[i].z;
-
-                if (fabs(dx) < planets[i].width/2 + 10 &&
-                    fabs(dz) < planets[i].depth/2 + 10 &&
-                    player.y > planets[i].y - 10 &&
-                    player.y < planets[i].y + 20) {
-
-                    if (fabs(dx) > planets[i].width/2) {
-                        player.x = planets[i].x + (dx > 0 ? planets[i].width/2 : -planets[i].width/2);
-                    }
-                    if (fabs(dz) > planets[i].depth/2) {
-                        player.z = planets[i].z + (dz > 0 ? planets[i].depth/2 : -planets[i].depth/2);
-                    }
-
-                    player.y = planets[i].y;
-                    player.vy = 0;
-                    player.onGround = true;
-                    player.jumpCount = 0;
-
-                    if (i != (size_t)player.lastPlanetIndex && i > (size_t)player.lastPlanetIndex) {
-                        int planetsJumped = i - player.lastPlanetIndex;
-                        player.planetsExplored++;
-                        player.combo++;
-                        player.comboTimer = 100;
+        // Update planet rotations
+        integrateMotion(planets, planets.size());
+    }
 
-                        int basePoints = POINTS_PER_PLANET * planetsJumped;
-                        int comboMultiplier = player.combo;
-                        if (comboMultiplier > 10) comboMultiplier = 10;
-                        int earnedPoints = basePoints * comboMultiplier;
+    // A press only triggers a jump on the tick that consumed it
+    jumpRequested = false;
+}
 
-                        addPoints(earnedPoints, player.x, player.y + 30);
-                    }
+// Movement, jumping and gravity for one player. Landing is resolved for all
+// players together afterwards.
+void stepPlayer(Player& p, const PlayerControls& controls) {
+    // Player movement
+    if (controls.left) {
+        p.vx = -MOVE_SPEED;
+        p.rotation = 45;
+    } else if (controls.right) {
+        p.vx = MOVE_SPEED;
+        p.rotation = -45;
+    } else {
+        p.vx = 0;
+        p.rotation = 0;
+    }
 
-                    player.lastPlanetIndex = i;
-                    break;
+    // Auto-adjust Z position towards the nearest planet around this height
+    if (!p.onGround && planets.size() > 0) {
+        float nearestPlanetZ = 0;
+        float minDistance = 999999;
+        for (size_t i = firstRowAbove(planets, p.y - 100); i < planets.size(); i++) {
+            if (planets.position[i].y >= p.y + 50) break;
+            if (planets.position[i].y > p.y - 100) {
+                float distance = fabs(p.x - planets.position[i].x);
+                if (distance < minDistance) {
+                    minDistance = distance;
+                    nearestPlanetZ = planets.position[i].z;
                 }
             }
         }
-
-        // Camera following
-        if (player.y > cameraY + 240) {
-            cameraY = player.y - 240;
+        float zDiff = nearestPlanetZ - p.z;
+        if (fabs(zDiff) > 5) {
+            p.z += zDiff * 0.02f;
         }
+    }
 
-        // Drifting into space game over
-        if (!player.onGround) {
-            player.timeInSpace += 0.016f;
+    // Jumping
+    if (p.onGround && controls.jump) {
+        p.vy = JUMP_FORCE;
+        p.onGround = false;
+        p.jumpCount = 1;
+        if (&p == &player) playSound(SOUND_JUMP);
 
-            if (player.timeInSpace > 3.0f && !player.driftingIntoSpace) {
-                player.driftingIntoSpace = true;
-                if (score > highScore) {
-                    highScore = score;
-                }
-                gameRunning = false;
-            }
-        } else {
-            player.timeInSpace = 0;
-            player.driftingIntoSpace = false;
-        }
+        if (controls.left) p.vx = -MOVE_SPEED * JUMP_BOOST;
+        else if (controls.right) p.vx = MOVE_SPEED * JUMP_BOOST;
+    }
 
-        // Game over conditions
-        if (player.y < cameraY - 50) {
-            if (score > highScore) {
-                highScore = score;
-            }
-            gameRunning = false;
-        }
+    // Gravity
+    float currentGravity = GRAVITY;
+    if (p.vy > 0) {
+        currentGravity = GRAVITY * 0.85f;
+    }
+    p.vy -= currentGravity;
+
+    // Update position
+    p.x += p.vx;
+    p.y += p.vy;
+
+    // Screen wrap
+    if (p.x < -320) p.x = 320;
+    if (p.x > 320) p.x = -320;
+
+    // Bobbing animation
+    if (p.onGround) {
+        p.bobOffset = sin(gameTime * 6) * 2;
+    } else {
+        p.bobOffset = 0;
+    }
+}
 
-        if (player.onGround && planets[player.lastPlanetIndex].y < cameraY) {
-            if (score > highScore) {
-                highScore = score;
+// Land every falling player in one sweep. Players sorted by height walk the
+// height-sorted planet table with a single cursor, so each player only
+// tests the few planets within its landing band (-20..+10 around its feet).
+void resolvePlanetCollisions() {
+    int count = 0;
+    for (int i = 0; i < playerCount; i++) {
+        if (!players[i].alive) continue;
+        players[i].onGround = false;
+        collisionOrder[count++] = i;
+    }
+    std::sort(collisionOrder, collisionOrder + count, [](int a, int b) {
+        return players[a].y < players[b].y || (players[a].y == players[b].y && a < b);
+    });
+
+    size_t first = 0;
+    for (int k = 0; k < count; k++) {
+        Player& p = players[collisionOrder[k]];
+        while (first < planets.size() && planets.position[first].y <= p.y - 20) first++;
+        if (p.vy > 0) continue;
+
+        for (size_t i = first; i < planets.size() && planets.position[i].y < p.y + 10; i++) {
+            float dx = p.x - planets.position[i].x;
+            float dz = p.z - planets.position[i].z;
+            if (fabs(dx) < planets.extent[i].width/2 + 10 &&
+                fabs(dz) < planets.extent[i].depth/2 + 10) {
+                landOnPlanet(p, i);
+                break;
             }
-            gameRunning = false;
         }
+    }
+}
 
-        // Level completion
-        if ((size_t)player.lastPlanetIndex == planets.size() - 1) {
-            advanceToNextLevel();
-        }
+void landOnPlanet(Player& p, size_t i) {
+    float dx = p.x - planets.position[i].x;
+    float dz = p.z - planets.position[i].z;
+    if (fabs(dx) > planets.extent[i].width/2) {
+        p.x = planets.position[i].x + (dx > 0 ? planets.extent[i].width/2 : -planets.extent[i].width/2);
+    }
+    if (fabs(dz) > planets.extent[i].depth/2) {
+        p.z = planets.position[i].z + (dz > 0 ? planets.extent[i].depth/2 : -planets.extent[i].depth/2);
+    }
 
-        // Update planet rotations
-        for (size_t i = 0; i < planets.size(); i++) {
-            planets[i].rotation += 0.08f;
-        }
+    p.y = planets.position[i].y;
+    p.vy = 0;
+    p.onGround = true;
+    if (&p == &player && p.jumpCount > 0) playSound(SOUND_LANDING);
+    p.jumpCount = 0;
+
+    if (i != (size_t)p.lastPlanetIndex && i > (size_t)p.lastPlanetIndex) {
+        int planetsJumped = i - p.lastPlanetIndex;
+        p.planetsExplored++;
+        p.combo++;
+        p.comboTimer = 100;
+
+        int basePoints = POINTS_PER_PLANET * planetsJumped;
+        int comboMultiplier = p.combo;
+        if (comboMultiplier > 10) comboMultiplier = 10;
+        int earnedPoints = basePoints * comboMultiplier;
+
+        addPoints(p, earnedPoints, p.x, p.y + 30);
+        if (&p == &player && p.combo % COMBO_SOUND_STEP == 0) playSound(SOUND_COMBO);
+        telemetryEvent(TELEMETRY_LANDING, (int)(&p - players), simulationTick, (int)i, planetsJumped, p.combo, earnedPoints);
     }
 
-    glutPostRedisplay();
-    glutTimerFunc(16, update, 0);
+    p.lastPlanetIndex = i;
 }
 
-void display() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
+// Players that keep the game going and steer the camera: the keyboard
+// players when there are any, otherwise every bot
+bool isCountedPlayer(int index) {
+    return players[index].alive && (humanPlayers == 0 || index < humanPlayers);
+}
 
-    float cameraX = player.x * 0.3f;
-    float cameraZ = CAMERA_DISTANCE;
-    float cameraLookY = cameraY + 100;
+// Bot for ghosts and headless runs: jump for the highest planet within
+// reach, then steer towards it in the air. A short hop is fatal because the
+// camera follows the jump's apex, so the bot aims as high as it can. Each
+// bot reaches a little differently so a crowd spreads out instead of
+// moving in lockstep.
+PlayerControls botControls(const Player& p, int index) {
+    PlayerControls controls = {false, false, false};
+    if (planets.size() == 0) return controls;
+
+    // Measured from the take-off planet so the target holds during the jump
+    float reach = BOT_JUMP_REACH - (index % 4) * 15;
+    float takeOffY = planets.position[p.lastPlanetIndex].y;
+    size_t target = p.lastPlanetIndex;
+    for (size_t i = p.lastPlanetIndex + 1; i < planets.size(); i++) {
+        if (planets.position[i].y - takeOffY > reach) break;
+        target = i;
+    }
+    // The final planet sits too close above the one below it to jump from there
+    if (target + 2 == planets.size() && target > (size_t)p.lastPlanetIndex + 1) target--;
 
-    gluLookAt(cameraX, cameraY + CAMERA_HEIGHT_OFFSET, cameraZ,
-              cameraX * 0.5f, cameraLookY, 0,
-              0, 1, 0);
+    if (p.onGround) {
+        controls.jump = target != (size_t)p.lastPlanetIndex;
+        return controls;
+    }
 
-    drawBackground();
+    float aimX = planets.position[target].x + (index * 7) % 21 - 10;
+    float dx = aimX - p.x;
+    if (dx < -MOVE_SPEED) controls.left = true;
+    else if (dx > MOVE_SPEED) controls.right = true;
+    return controls;
+}
 
-    // Draw planets
-    for (size_t i = 0; i < planets.size(); i++) {
-        if (planets[i].y > cameraY - 200 && planets[i].y < cameraY + 600) {
-            if (i == planets.size() - 1) {
-                glColor3f(1.0f, 0.95f, 0.7f);
-            } else {
-                float intensity = 0.6f + 0.4f * (static_cast<float>(i) / planets.size());
-                glColor3f(0.7f * intensity, 0.6f * intensity, 0.5f * intensity);
-            }
-            drawPlanet(planets[i]);
-        }
+void display() {
+    std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+    beginAllocationPeriod(frameAllocations);
+
+    overdrawBeginFrame(overdraw, windowWidth, windowHeight);
+
+    // Both the idle capture and an upscaled scene cover the whole window,
+    // so only a scene drawn at full resolution clears it
+    bool idle = screenIsIdle();
+    if (idle && idleScreen.tick == simulationTick && idleScreen.width == windowWidth &&
+        idleScreen.height == windowHeight && idleScreen.backend == rGetBackend()) {
+        rDrawFullscreen(idleScreen.texture);
+        idleScreen.frames++;
+    } else {
+        drawScaledScene();
+        if (idle) captureIdleScene();
     }
 
-    drawLittlePrince();
-
     // HUD
-    glColor3f(1.0f, 1.0f, 0.9f);
+    overdrawStage(overdraw, STAGE_HUD);
+    rColor3f(1.0f, 1.0f, 0.9f);
 
-    std::stringstream ss;
-    ss << "Stars Collected: " << score << "   Best Journey: " << highScore;
-    drawText(10, WINDOW_HEIGHT - 30, ss.str().c_str());
+    // Formatted on the stack: a frame must not touch the heap
+    char line[128];
+    snprintf(line, sizeof(line), "Stars Collected: %d   Best Journey: %d", player.score, highScore);
+    drawText(10, WINDOW_HEIGHT - 30, line);
 
-    std::stringstream ls;
-    ls << "Chapter: " << currentLevel << " / " << MAX_LEVELS << "   Cosmic Speed: " << (int)(currentScrollSpeed * 60) << "%";
-    drawText(10, WINDOW_HEIGHT - 50, ls.str().c_str());
+    snprintf(line, sizeof(line), "Chapter: %d / %d   Cosmic Speed: %d%%", currentLevel, MAX_LEVELS, (int)(currentScrollSpeed * 60));
+    drawText(10, WINDOW_HEIGHT - 50, line);
 
-    std::stringstream cs;
-    cs << "Wonder: x" << player.combo << "   Planetoids: " << (PLANETS_FOR_BONUS - planetsVisited) << " until next discovery";
-    drawText(10, WINDOW_HEIGHT - 70, cs.str().c_str());
+    snprintf(line, sizeof(line), "Wonder: x%d   Planetoids: %d until next discovery", player.combo, PLANETS_FOR_BONUS - planetsVisited);
+    drawText(10, WINDOW_HEIGHT - 70, line);
 
-    std::stringstream bs;
-    bs << "Worlds Discovered: " << totalPlanetsExplored;
-    drawText(10, WINDOW_HEIGHT - 90, bs.str().c_str());
+    snprintf(line, sizeof(line), "Worlds Discovered: %d", totalPlanetsExplored);
+    drawText(10, WINDOW_HEIGHT - 90, line);
 
     if (explorationBoostTimer > 0) {
         float alpha = explorationBoostTimer / 60.0f;
-        glColor3f(1.0f, 0.9f + alpha * 0.1f, 0.6f + alpha * 0.2f);
+        rColor3f(1.0f, 0.9f + alpha * 0.1f, 0.6f + alpha * 0.2f);
         drawText(WINDOW_WIDTH / 2 - 80, WINDOW_HEIGHT - 120, "New Discovery!");
     }
 
     // Game over screens
     if (!gameRunning) {
         if (currentLevel > MAX_LEVELS) {
-            glColor3f(1.0f, 0.95f, 0.7f);
+            rColor3f(1.0f, 0.95f, 0.7f);
             drawText(WINDOW_WIDTH / 2 - 100, WINDOW_HEIGHT / 2 + 30, "Journey's End");
-            glColor3f(1.0f, 1.0f, 0.9f);
+            rColor3f(1.0f, 1.0f, 0.9f);
             drawText(WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2, "The Little Prince returns to his beloved rose...");
 
-            std::stringstream finalScore;
-            finalScore << "Stars Gathered: " << score;
-            drawText(WINDOW_WIDTH / 2 - 80, WINDOW_HEIGHT / 2 - 30, finalScore.str().c_str());
+            snprintf(line, sizeof(line), "Stars Gathered: %d", player.score);
+            drawText(WINDOW_WIDTH / 2 - 80, WINDOW_HEIGHT / 2 - 30, line);
 
             drawText(WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 - 60, "Press SPACE for another tale");
         } else if (player.driftingIntoSpace) {
-            glColor3f(0.8f, 0.9f, 1.0f);
+            rColor3f(0.8f, 0.9f, 1.0f);
             drawText(WINDOW_WIDTH / 2 - 120, WINDOW_HEIGHT / 2 + 30, "Adrift Among the Stars");
-            glColor3f(1.0f, 1.0f, 0.9f);
+            rColor3f(1.0f, 1.0f, 0.9f);
             drawText(WINDOW_WIDTH / 2 - 160, WINDOW_HEIGHT / 2, "The Little Prince floats gently in the cosmic void...");
             drawText(WINDOW_WIDTH / 2 - 140, WINDOW_HEIGHT / 2 - 20, "Perhaps the stars will guide him home.");
 
-            std::stringstream finalScore;
-            finalScore << "Worlds Visited: " << totalPlanetsExplored;
-            drawText(WINDOW_WIDTH / 2 - 90, WINDOW_HEIGHT / 2 - 50, finalScore.str().c_str());
+            snprintf(line, sizeof(line), "Worlds Visited: %d", totalPlanetsExplored);
+            drawText(WINDOW_WIDTH / 2 - 90, WINDOW_HEIGHT / 2 - 50, line);
 
             drawText(WINDOW_WIDTH / 2 - 90, WINDOW_HEIGHT / 2 - 100, "Press SPACE to begin anew");
         } else {
-            glColor3f(1.0f, 0.8f, 0.6f);
+            rColor3f(1.0f, 0.8f, 0.6f);
             drawText(WINDOW_WIDTH / 2 - 80, WINDOW_HEIGHT / 2 + 30, "Lost Among Stars");
-            glColor3f(1.0f, 1.0f, 0.9f);
+            rColor3f(1.0f, 1.0f, 0.9f);
             drawText(WINDOW_WIDTH / 2 - 130, WINDOW_HEIGHT / 2, "The Little Prince drifts in the cosmic wind...");
 
-            std::stringstream finalScore;
-            finalScore << "Worlds Visited: " << totalPlanetsExplored;
-            drawText(WINDOW_WIDTH / 2 - 90, WINDOW_HEIGHT / 2 - 30, finalScore.str().c_str());
+            snprintf(line, sizeof(line), "Worlds Visited: %d", totalPlanetsExplored);
+            drawText(WINDOW_WIDTH / 2 - 90, WINDOW_HEIGHT / 2 - 30, line);
 
             drawText(WINDOW_WIDTH / 2 - 90, WINDOW_HEIGHT / 2 - 80, "Press SPACE to begin anew");
         }
     }
 
-    glutSwapBuffers();
+    if (overdraw.enabled) {
+        overdrawEndFrame(overdraw);
+        drawOverdrawReport();
+    }
+
+    // Include GPU work so every backend is timed like-for-like
+    rFinish();
+    double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    backendFrameTime += frameMs;
+    backendFrameCount++;
+    // Stencil readbacks would have the governor cut quality for nothing
+    if (!overdraw.enabled) governorRecordFrame(frameMs);
+    telemetryEvent(TELEMETRY_FRAME, 0, simulationTick, (int)(frameMs * 1000));
+    if (backendFrameCount >= 300) {
+        reportBackendFrameTime();
+    }
+
+    endAllocationPeriod(frameAllocations);
+    rPresent();
+
+    double presentTime = nowMs();
+    for (int i = 0; i < pendingPresentCount; i++) {
+        recordLatency(inputToPresent, presentTime - pendingPresentTimes[i]);
+    }
+    pendingPresentCount = 0;
+}
+
+// Background, planets and princes from the current camera
+void drawScene() {
+    rLoadIdentity();
+
+    float cameraX = player.x * 0.3f;
+    float cameraZ = CAMERA_DISTANCE;
+    float cameraLookY = cameraY + 100;
+
+    rLookAt(cameraX, cameraY + CAMERA_HEIGHT_OFFSET, cameraZ,
+              cameraX * 0.5f, cameraLookY, 0,
+              0, 1, 0);
+    cameraEye.x = cameraX;
+    cameraEye.y = cameraY + CAMERA_HEIGHT_OFFSET;
+    cameraEye.z = cameraZ;
+
+    bakePlanetMeshes();
+    startSceneLists(rModelView());
+    drawBackground();
+
+    overdrawStage(overdraw, STAGE_PLANETS);
+    submitSceneList(LIST_PLANETS);
+
+    overdrawStage(overdraw, STAGE_PRINCES);
+    drawLittlePrince();
+    drawGhosts();
+    drawRemoteGhosts();
+}
+
+// Draw the scene at the governed fraction of the window's resolution and
+// upscale it to fill the window, so fill-bound frames get cheaper with the
+// square of the scale; the HUD is drawn over it at full resolution. The
+// overdraw heatmap counts at full resolution in the window's stencil.
+void drawScaledScene() {
+    int scale = overdraw.enabled ? 100 : quality.renderScalePercent;
+    if (scale >= 100) {
+        rClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawScene();
+        return;
+    }
+
+    int width = std::max(1, windowWidth * scale / 100);
+    int height = std::max(1, windowHeight * scale / 100);
+    rBeginOffscreen(width, height);
+    rClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawScene();
+    sceneTexture = rCaptureFrame(sceneTexture, width, height);
+    rEndOffscreen();
+    rViewport(0, 0, windowWidth, windowHeight);
+    rDrawFullscreen(sceneTexture);
+    scaledFrames++;
+}
+
+// A game over screen with nothing else going on: the overdraw heatmap
+// needs real draws, and ghost racing keeps sending and receiving ticks
+bool screenIsIdle() {
+    return !gameRunning && !overdraw.enabled && ghostListenPort == 0 && ghostSendPort == 0;
+}
+
+// Keep the scene just drawn for the idle frames that follow
+void captureIdleScene() {
+    idleScreen.texture = rCaptureFrame(idleScreen.texture, windowWidth, windowHeight);
+    idleScreen.tick = simulationTick;
+    idleScreen.width = windowWidth;
+    idleScreen.height = windowHeight;
+    idleScreen.backend = rGetBackend();
+    idleScreen.captures++;
+    // The software renderer sizes its copy of the frame on first use
+    allowAllocations(frameAllocations, 1);
+}
+
+// Restart a tick loop that went to sleep on the game over screen
+void wakeFromIdle() {
+    if (!idleScreen.sleeping) return;
+    idleScreen.sleeping = false;
+    glutTimerFunc(16, update, 0);
+    glutPostRedisplay();
+}
+
+void reportIdleStats() {
+    if (idleScreen.captures == 0) return;
+    std::cerr << "idle: " << idleScreen.frames << " frames drawn from " << idleScreen.captures
+              << " captured scenes" << std::endl;
+}
+
+// Last frame's writes per pixel by stage, over the heatmap; a longer
+// window goes to stderr every OVERDRAW_REPORT_FRAMES frames
+void drawOverdrawReport() {
+    rColor3f(1.0f, 1.0f, 1.0f);
+    char line[96];
+    float y = 10;
+    for (int i = DRAW_STAGES - 1; i >= 0; i--) {
+        snprintf(line, sizeof(line), "%s: %.2f avg, %d peak", drawStageName(i), overdraw.average[i], overdraw.peak[i]);
+        drawText(10, y, line);
+        y += 20;
+    }
+    snprintf(line, sizeof(line), "Overdraw: %.2f writes/pixel, peak %d", overdraw.frameAverage, overdraw.framePeak);
+    drawText(10, y, line);
+
+    if (overdraw.windowFrames >= OVERDRAW_REPORT_FRAMES) {
+        overdrawReport(overdraw);
+    }
+}
+
+void reportBackendFrameTime() {
+    if (backendFrameCount > 0) {
+        std::cerr << rBackendName(rGetBackend()) << " backend: " << backendFrameTime / backendFrameCount
+                  << " ms/frame over " << backendFrameCount << " frames";
+        if (scaledFrames > 0) std::cerr << ", " << scaledFrames << " upscaled from a lower resolution";
+        std::cerr << std::endl;
+    }
+    backendFrameTime = 0;
+    backendFrameCount = 0;
+    scaledFrames = 0;
+}
+
+static void reportRig(const char* name, const TransformTree& tree) {
+    unsigned long long total = tree.evaluations + tree.reuses;
+    if (total == 0) return;
+    std::cerr << "transforms " << name << ": " << tree.nodes.size() << " nodes, " << tree.evaluations
+              << " evaluated, " << tree.reuses << " reused (" << 100.0 * tree.reuses / total << "%)" << std::endl;
+}
+
+// How much matrix work the cached world matrices saved
+void reportTransformStats() {
+    reportRig("planets", planetRig.tree);
+    reportRig("roses", roseRig.tree);
+    reportRig("foxes", foxRig.tree);
+    reportRig("prince", princeRig);
+}
+
+size_t activeParticles(size_t total) {
+    return total * quality.particlePercent / 100;
+}
+
+void applyQualitySettings() {
+    const QualityKnobSteps* k = QUALITY_KNOBS;
+    quality.renderScalePercent = (int)k[KNOB_RENDER_SCALE].values[governor.knobStep[KNOB_RENDER_SCALE]];
+    if (fixedRenderScale > 0) quality.renderScalePercent = fixedRenderScale;
+    quality.nebulaPuffs = (int)k[KNOB_NEBULA].values[governor.knobStep[KNOB_NEBULA]];
+    quality.particlePercent = (int)k[KNOB_PARTICLES].values[governor.knobStep[KNOB_PARTICLES]];
+    quality.tessellationPercent = (int)k[KNOB_TESSELLATION].values[governor.knobStep[KNOB_TESSELLATION]];
+    quality.decorationDistance = k[KNOB_DRAW_DISTANCE].values[governor.knobStep[KNOB_DRAW_DISTANCE]];
+    rSetTessellation(quality.tessellationPercent);
+
+    // The next frame bakes meshes for the new tessellation
+    allowAllocations(frameAllocations, 1);
+}
+
+static void logQualityChange(const char* action, int knob, int fromStep, double averageMs) {
+    const QualityKnobSteps& k = QUALITY_KNOBS[knob];
+    std::cerr << "quality: " << action << " " << k.name << " " << k.values[fromStep]
+              << " -> " << k.values[governor.knobStep[knob]] << " (avg " << averageMs
+              << " ms, budget " << frameBudgetMs << " ms)" << std::endl;
+}
+
+// Average frame time over a window, then step one knob down when over
+// budget, or back up after several windows comfortably under it.
+void governorRecordFrame(double frameMs) {
+    if (frameBudgetMs <= 0) return;
+
+    governor.windowTime += frameMs;
+    governor.windowFrames++;
+    if (governor.windowFrames < GOVERNOR_WINDOW_FRAMES) return;
+
+    double averageMs = governor.windowTime / governor.windowFrames;
+    governor.windowTime = 0;
+    governor.windowFrames = 0;
+
+    if (averageMs > frameBudgetMs) {
+        governor.calmWindows = 0;
+        for (int tried = 0; tried < QUALITY_KNOB_COUNT; tried++) {
+            int knob = governor.nextKnob;
+            governor.nextKnob = (governor.nextKnob + 1) % QUALITY_KNOB_COUNT;
+            if (knob == KNOB_RENDER_SCALE && fixedRenderScale > 0) continue;
+            if (governor.knobStep[knob] + 1 < QUALITY_KNOBS[knob].steps) {
+                governor.knobStep[knob]++;
+                governor.history.push_back(knob);
+                applyQualitySettings();
+                logQualityChange("lower", knob, governor.knobStep[knob] - 1, averageMs);
+                return;
+            }
+        }
+    } else if (averageMs < frameBudgetMs * GOVERNOR_RESTORE_RATIO && !governor.history.empty()) {
+        governor.calmWindows++;
+        if (governor.calmWindows >= GOVERNOR_CALM_WINDOWS) {
+            governor.calmWindows = 0;
+            int knob = governor.history.back();
+            governor.history.pop_back();
+            governor.knobStep[knob]--;
+            governor.nextKnob = knob;
+            applyQualitySettings();
+            logQualityChange("raise", knob, governor.knobStep[knob] + 1, averageMs);
+        }
+    } else {
+        governor.calmWindows = 0;
+    }
+}
+
+void toggleRenderBackend() {
+    reportBackendFrameTime();
+    rSetBackend(rGetBackend() == RENDER_LEGACY ? RENDER_SHADER : RENDER_LEGACY);
+    std::cerr << "Renderer: " << rBackendName(rGetBackend()) << std::endl;
+    allowAllocations(frameAllocations, 1);
+}
+
+void toggleOverdraw() {
+    if (rGetBackend() == RENDER_SOFTWARE) {
+        std::cerr << "overdraw: needs a stencil buffer, which the software renderer does not have" << std::endl;
+        overdraw.enabled = false;
+        return;
+    }
+    GLint stencilBits = 0;
+    glGetIntegerv(GL_STENCIL_BITS, &stencilBits);
+    if (stencilBits < 8) {
+        std::cerr << "overdraw: needs an 8-bit stencil buffer, window has " << stencilBits << " bits" << std::endl;
+        overdraw.enabled = false;
+        return;
+    }
+    if (overdraw.enabled) overdrawReport(overdraw);
+    overdraw.enabled = !overdraw.enabled;
+    allowAllocations(frameAllocations, 1);
+    std::cerr << "overdraw heatmap " << (overdraw.enabled ? "on" : "off") << std::endl;
+}
+
+// Milliseconds since the first call, on a monotonic clock
+double nowMs() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Input handlers only record events; the simulation applies them in order
+void queueInput(int action, bool pressed) {
+    if (inputQueueCount == INPUT_QUEUE_SIZE) {
+        // Full: drop the oldest event rather than the newest state
+        inputQueueHead = (inputQueueHead + 1) % INPUT_QUEUE_SIZE;
+        inputQueueCount--;
+    }
+    InputEvent& e = inputQueue[(inputQueueHead + inputQueueCount) % INPUT_QUEUE_SIZE];
+    e.action = action;
+    e.pressed = pressed;
+    e.time = nowMs();
+    inputQueueCount++;
+}
+
+void consumeInputEvents(bool& leftTapped, bool& rightTapped) {
+    double now = nowMs();
+    while (inputQueueCount > 0) {
+        const InputEvent& e = inputQueue[inputQueueHead];
+        inputQueueHead = (inputQueueHead + 1) % INPUT_QUEUE_SIZE;
+        inputQueueCount--;
+
+        switch (e.action) {
+            case INPUT_LEFT:
+                leftKey = e.pressed;
+                if (e.pressed) leftTapped = true;
+                break;
+            case INPUT_RIGHT:
+                rightKey = e.pressed;
+                if (e.pressed) rightTapped = true;
+                break;
+            case INPUT_JUMP:
+                if (e.pressed) jumpRequested = true;
+                break;
+        }
+
+        recordLatency(inputToSimulation, now - e.time);
+        if (pendingPresentCount < INPUT_QUEUE_SIZE) {
+            pendingPresentTimes[pendingPresentCount++] = e.time;
+        }
+    }
+}
+
+void recordLatency(LatencySamples& samples, double ms) {
+    samples.samples[samples.next] = ms;
+    samples.next = (samples.next + 1) % LATENCY_SAMPLES;
+    if (samples.count < LATENCY_SAMPLES) samples.count++;
+}
+
+static void reportLatencyPercentiles(const char* name, const LatencySamples& samples) {
+    if (samples.count == 0) return;
+    std::vector<double> sorted(samples.samples, samples.samples + samples.count);
+    std::sort(sorted.begin(), sorted.end());
+    std::cerr << name << " latency: p50 " << sorted[sorted.size() * 50 / 100]
+              << " ms, p95 " << sorted[sorted.size() * 95 / 100]
+              << " ms, p99 " << sorted[sorted.size() * 99 / 100]
+              << " ms (" << samples.count << " events)" << std::endl;
+}
+
+void reportInputLatency() {
+    reportLatencyPercentiles("input-to-simulation", inputToSimulation);
+    reportLatencyPercentiles("input-to-present", inputToPresent);
+}
+
+// Deterministic generator for everything the simulation randomizes, so a
+// snapshot (which includes its state) replays exactly. Same LCG as the C
+// library reference rand().
+// One seed drives both the simulation's random stream and the chapter
+// layouts
+void seedRandom(unsigned int seed) {
+    randomState = seed;
+    levelSeed = seed;
+}
+
+int gameRand() {
+    randomState = randomState * 1103515245u + 12345u;
+    return (int)((randomState >> 16) & 0x7fff);
+}
+
+static void writeTable(SnapshotWriter& w, const ArchetypeTable& table) {
+    w.column(table.position);
+    w.column(table.velocity);
+    w.column(table.spin);
+    w.column(table.extent);
+    w.column(table.glow);
+    w.column(table.kind);
+}
+
+static void readTable(SnapshotReader& r, ArchetypeTable& table) {
+    r.column(table.position);
+    r.column(table.velocity);
+    r.column(table.spin);
+    r.column(table.extent);
+    r.column(table.glow);
+    r.column(table.kind);
+}
+
+// Field by field: a Player has padding after its bools, and what is in it
+// would otherwise reach the state hash and the rewind deltas
+static void writePlayer(SnapshotWriter& w, const Player& p) {
+    w.value(p.x);
+    w.value(p.y);
+    w.value(p.z);
+    w.value(p.vx);
+    w.value(p.vy);
+    w.value(p.onGround);
+    w.value(p.jumpCount);
+    w.value(p.lastPlanetIndex);
+    w.value(p.planetsExplored);
+    w.value(p.combo);
+    w.value(p.comboTimer);
+    w.value(p.rotation);
+    w.value(p.bobOffset);
+    w.value(p.timeInSpace);
+    w.value(p.driftingIntoSpace);
+    w.value(p.alive);
+    w.value(p.score);
+}
+
+static void readPlayer(SnapshotReader& r, Player& p) {
+    r.value(p.x);
+    r.value(p.y);
+    r.value(p.z);
+    r.value(p.vx);
+    r.value(p.vy);
+    r.value(p.onGround);
+    r.value(p.jumpCount);
+    r.value(p.lastPlanetIndex);
+    r.value(p.planetsExplored);
+    r.value(p.combo);
+    r.value(p.comboTimer);
+    r.value(p.rotation);
+    r.value(p.bobOffset);
+    r.value(p.timeInSpace);
+    r.value(p.driftingIntoSpace);
+    r.value(p.alive);
+    r.value(p.score);
+}
+
+// Everything stepSimulation() reads or writes. Background stars are derived
+// from the camera height and the high score survives rewinds, so neither is
+// included.
+void saveGameState(Snapshot& out) {
+    SnapshotWriter w(out);
+    w.value(simulationTick);
+    w.value(randomState);
+    w.value(gameRunning);
+    w.value(playerCount);
+    for (int i = 0; i < playerCount; i++) writePlayer(w, players[i]);
+    w.value(cameraY);
+    w.value(currentLevel);
+    w.value(gameTime);
+    w.value(currentScrollSpeed);
+    w.value(planetsVisited);
+    w.value(totalPlanetsExplored);
+    w.value(explorationBoostTimer);
+    writeTable(w, planets);
+    writeTable(w, roses);
+    writeTable(w, foxes);
+    w.value(decorationRegions);
+    writeTable(w, shootingStars);
+    writeTable(w, rosePetals);
+    writeTable(w, stardust);
+}
+
+void loadGameState(const Snapshot& in) {
+    SnapshotReader r(in);
+    r.value(simulationTick);
+    r.value(randomState);
+    r.value(gameRunning);
+    r.value(playerCount);
+    for (int i = 0; i < playerCount; i++) readPlayer(r, players[i]);
+    r.value(cameraY);
+    r.value(currentLevel);
+    r.value(gameTime);
+    r.value(currentScrollSpeed);
+    r.value(planetsVisited);
+    r.value(totalPlanetsExplored);
+    r.value(explorationBoostTimer);
+    readTable(r, planets);
+    readTable(r, roses);
+    readTable(r, foxes);
+    r.value(decorationRegions);
+    readTable(r, shootingStars);
+    readTable(r, rosePetals);
+    readTable(r, stardust);
+}
+
+// Snapshot the tick just simulated into the rewind ring and, when tracing,
+// log its hash so two runs can be diffed for the first diverging tick
+void recordRewindFrame() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    saveGameState(tickState);
+    pushRewindFrame(rewindBuffer, tickState);
+    rewindCaptureTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    rewindCaptureCount++;
+
+    if (stateTrace.is_open()) {
+        stateTrace << simulationTick << " " << std::hex << snapshotHash(tickState) << std::dec << "\n";
+    }
+}
+
+bool rewindOneTick() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!popRewindFrame(rewindBuffer, tickState)) return false;
+    loadGameState(tickState);
+    rewindRestoreTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    rewindRestoreCount++;
+    return true;
+}
+
+void reportRewindStats() {
+    if (rewindCaptureCount == 0) return;
+    saveGameState(tickState);
+    std::cerr << "rewind: " << rewindBuffer.count << " ticks in " << rewindBufferBytes(rewindBuffer) / 1024
+              << " KB (" << rewindBuffer.count * tickState.size() / 1024 << " KB uncompressed), capture "
+              << rewindCaptureTime / rewindCaptureCount << " us";
+    if (rewindRestoreCount > 0) std::cerr << ", restore " << rewindRestoreTime / rewindRestoreCount << " us";
+    std::cerr << std::endl;
+}
+
+// Simulate without a window or GL context. Every player is a bot and the
+// run ends when they are all out, the last chapter is done or the tick
+// limit is reached.
+int runHeadless() {
+    humanPlayers = 0;
+    initSimulation();
+    startGhostLink();
+
+    // Streaming ghosts to a live game runs at the game's pace, not flat out
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point nextTick = start;
+    while (gameRunning && simulationTick < headlessTicks) {
+        beginAllocationPeriod(tickAllocations);
+        stepSimulation();
+        sendGhostFrame();
+        endAllocationPeriod(tickAllocations);
+        if (ghostConnected(ghostLink)) {
+            nextTick += std::chrono::milliseconds(16);
+            std::this_thread::sleep_until(nextTick);
+        }
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    int survivors = 0;
+    int bestScore = 0;
+    int bestPlanets = 0;
+    for (int i = 0; i < playerCount; i++) {
+        if (players[i].alive) survivors++;
+        bestScore = std::max(bestScore, players[i].score);
+        bestPlanets = std::max(bestPlanets, players[i].planetsExplored);
+    }
+
+    std::cout << "headless: " << playerCount << " players, " << simulationTick << " ticks in " << elapsedMs << " ms ("
+              << (simulationTick > 0 ? elapsedMs * 1000 / simulationTick : 0) << " us/tick)" << std::endl;
+    std::cout << "chapter " << std::min(currentLevel, MAX_LEVELS) << ", " << survivors << " still in the race, best score "
+              << bestScore << ", most planets this chapter " << bestPlanets << std::endl;
+    stopChapterWorker();
+    reportPrefetchStats();
+    reportGhostStats();
+    reportArenaStats();
+    stopTelemetry();
+    stopAudio();
+    return reportAllocations();
+}
+
+// The last frame as a binary PPM, top row first
+static bool writeFrameDump(const std::string& path) {
+    std::vector<unsigned char> rgb(windowWidth * windowHeight * 3);
+    rReadPixels(0, 0, windowWidth, windowHeight, &rgb[0]);
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out << "P6\n" << windowWidth << " " << windowHeight << "\n255\n";
+    for (int y = windowHeight - 1; y >= 0; y--) {
+        out.write((const char*)&rgb[y * windowWidth * 3], windowWidth * 3);
+    }
+    return out.good();
+}
+
+// Draw every tick into the software renderer's memory framebuffer instead
+// of a window, with bots playing as in a headless run. Each raster thread
+// count replays the same ticks from the same starting state, with the
+// governor off, so their frame rates compare like for like.
+int runSoftware() {
+    humanPlayers = 0;
+    frameBudgetMs = 0;
+    rInitSoftware(WINDOW_WIDTH, WINDOW_HEIGHT);
+    requestedBackend = RENDER_SOFTWARE;
+    init();
+    reshape(WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    std::vector<int> threadCounts;
+    if (rasterThreads > 0) {
+        threadCounts.push_back(rasterThreads);
+    } else {
+        int cores = std::max(1, (int)std::thread::hardware_concurrency());
+        for (int n = 1; n < cores; n *= 2) threadCounts.push_back(n);
+        threadCounts.push_back(cores);
+    }
+
+    Snapshot start;
+    saveGameState(start);
+    for (size_t pass = 0; pass < threadCounts.size(); pass++) {
+        rSetRasterThreads(threadCounts[pass]);
+        loadGameState(start);
+        clearRewindBuffer(rewindBuffer);
+        reportBackendFrameTime();
+
+        std::chrono::steady_clock::time_point passStart = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < softwareFrames; frame++) {
+            beginAllocationPeriod(tickAllocations);
+            if (gameRunning) {
+                stepSimulation();
+                recordRewindFrame();
+            }
+            endAllocationPeriod(tickAllocations);
+            display();
+        }
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - passStart).count();
+
+        std::cout << "software: " << threadCounts[pass] << " raster threads, " << softwareFrames << " frames of "
+                  << windowWidth << "x" << windowHeight << " in " << elapsedMs << " ms ("
+                  << softwareFrames * 1000.0 / elapsedMs << " fps, " << elapsedMs / softwareFrames << " ms/frame)" << std::endl;
+        rReportRasterStats(softwareFrames);
+        reportSceneListStats();
+        reportPlanetBatchStats();
+    }
+
+    if (!frameDumpPath.empty()) {
+        if (writeFrameDump(frameDumpPath)) std::cerr << "software: last frame written to " << frameDumpPath << std::endl;
+        else std::cerr << "software: cannot write " << frameDumpPath << std::endl;
+    }
+    rStopRasterThreads();
+    stopChapterWorker();
+    reportImpostorStats();
+    reportStarFieldStats(starField);
+    reportIdleStats();
+    reportArenaStats();
+    stopTelemetry();
+    stopAudio();
+    return reportAllocations();
+}
+
+// The constants chapter layouts are generated and checked against, and
+// the jump every reachability check is measured with
+void initLevelRules() {
+    levelRules.planetsPerLevel = PLANETS_PER_LEVEL;
+    levelRules.zRange = PLATFORM_Z_RANGE;
+    levelRules.gravity = GRAVITY;
+    levelRules.jumpForce = JUMP_FORCE;
+    levelRules.moveSpeed = MOVE_SPEED;
+    levelRules.jumpBoost = JUMP_BOOST;
+    levelRules.baseScrollSpeed = BASE_SCROLL_SPEED;
+    levelRules.scrollPerLevel = SPEED_MULTIPLIER;
+    levelRules.cameraLead = 240;
+    levelRules.landingMargin = 10;
+
+    // Count the ticks the drift timer allows, with the same float steps
+    float timeInSpace = 0;
+    levelRules.maxAirTicks = 0;
+    while (!(timeInSpace + 0.016f > 3.0f)) {
+        timeInSpace += 0.016f;
+        levelRules.maxAirTicks++;
+    }
+
+    buildJumpArc(levelRules, jumpArc);
+}
+
+// With the current physics every generated chapter is solvable, so the
+// validator first feeds the check two hand-built climbs it must reject: one
+// with a gap no jump clears, one with its upper half far off to the side.
+// Both must come out of repairChapter() solvable.
+static bool checkChapterRepair() {
+    const int count = 12;
+    const char* names[2] = {"vertical gap", "sideways gap"};
+    PlanetSpec layout[count];
+    float camera[count];
+    int heap[count];
+    int slot[count];
+    ChapterScratch scratch = {camera, heap, slot};
+    bool passed = true;
+
+    for (int kind = 0; kind < 2; kind++) {
+        for (int i = 0; i < count; i++) {
+            PlanetSpec p = {0, 50.0f + i * 70, 0, 80, 50, 0};
+            if (i >= count / 2) {
+                if (kind == 0) p.y += jumpArc.apex + 100;
+                else p.x += 1000;
+            }
+            layout[i] = p;
+        }
+
+        bool rejected = !isChapterSolvable(levelRules, jumpArc, 1, layout, count, scratch);
+        int moved = repairChapter(levelRules, jumpArc, 1, layout, count, scratch);
+        bool repaired = moved >= 0 && isChapterSolvable(levelRules, jumpArc, 1, layout, count, scratch);
+        std::cout << "repair check, " << names[kind] << ": " << (rejected ? "rejected" : "NOT rejected") << ", "
+                  << (repaired ? "repaired" : "NOT repaired");
+        if (repaired) std::cout << " by moving " << moved << " planets";
+        std::cout << std::endl;
+        passed = passed && rejected && repaired;
+    }
+    return passed;
+}
+
+// Check every chapter of a range of level seeds, starting at --seed, on
+// all cores. Workers claim seeds in blocks from a shared counter and keep
+// their own tallies, so they only meet once per block.
+int runSeedValidator() {
+    initLevelRules();
+    if (!checkChapterRepair()) return 1;
+
+    int threads = validatorThreads > 0 ? validatorThreads : (int)std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+
+    const int BLOCK = 256;
+    std::atomic<int> nextSeed(0);
+    std::vector<std::vector<long long> > tallies(threads, std::vector<long long>(MAX_LEVELS * CHAPTER_STATUSES, 0));
+    std::vector<long long> firstUnsolvable(threads, -1);
+    unsigned firstSeed = levelSeed;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int w = 0; w < threads; w++) {
+        workers.push_back(std::thread([&, w]() {
+            int maxCount = chapterPlanetCount(levelRules, MAX_LEVELS);
+            std::vector<PlanetSpec> layout(maxCount);
+            std::vector<float> camera(maxCount);
+            std::vector<int> heap(maxCount);
+            std::vector<int> slot(maxCount);
+            ChapterScratch scratch = {&camera[0], &heap[0], &slot[0]};
+            std::vector<long long>& tally = tallies[w];
+
+            for (;;) {
+                int begin = nextSeed.fetch_add(BLOCK);
+                if (begin >= validateSeeds) break;
+                int end = std::min(validateSeeds, begin + BLOCK);
+                for (int i = begin; i < end; i++) {
+                    unsigned seed = firstSeed + (unsigned)i;
+                    for (int level = 1; level <= MAX_LEVELS; level++) {
+                        ChapterStatus status = buildChapter(levelRules, jumpArc, seed, level, &layout[0], scratch);
+                        tally[(level - 1) * CHAPTER_STATUSES + status]++;
+                        if (status == CHAPTER_UNSOLVABLE && firstUnsolvable[w] < 0) firstUnsolvable[w] = seed;
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    static const char* statusNames[CHAPTER_STATUSES] = {"solvable", "repaired", "regenerated", "unsolvable"};
+    long long unsolvable = 0;
+    long long example = -1;
+    for (int level = 1; level <= MAX_LEVELS; level++) {
+        std::cout << "chapter " << level << ":";
+        for (int s = 0; s < CHAPTER_STATUSES; s++) {
+            long long n = 0;
+            for (int w = 0; w < threads; w++) n += tallies[w][(level - 1) * CHAPTER_STATUSES + s];
+            std::cout << " " << n << " " << statusNames[s];
+            if (s == CHAPTER_UNSOLVABLE) unsolvable += n;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << validateSeeds << " seeds from " << firstSeed << " on " << threads << " threads in " << elapsed
+              << " s (" << (elapsed > 0 ? validateSeeds / elapsed : 0) << " seeds/s)" << std::endl;
+    for (int w = 0; w < threads; w++) {
+        if (firstUnsolvable[w] >= 0 && (example < 0 || firstUnsolvable[w] < example)) example = firstUnsolvable[w];
+    }
+    if (example >= 0) {
+        std::cout << "first unsolvable seed found: " << example << std::endl;
+    }
+    return unsolvable > 0 ? 1 : 0;
+}
+
+// Flush the event log and report how much of it made it to disk
+void stopTelemetry() {
+    if (!telemetryEnabled()) return;
+    telemetryStop();
+    std::cerr << "telemetry: " << telemetryWritten() << " events written, " << telemetryDropped() << " dropped" << std::endl;
+}
+
+// Let the last sounds play out and report how the mixer kept up
+void stopAudio() {
+    if (!audioEnabled()) return;
+    audioStop();
+    AudioStats stats = audioStats();
+    std::cerr << "audio: " << stats.played << " sounds played (" << stats.dropped << " dropped, " << stats.stolen
+              << " cut off), " << stats.buffers << " buffers of " << AUDIO_BUFFER_FRAMES * 1000.0 / AUDIO_SAMPLE_RATE
+              << " ms with " << stats.underruns << " underruns";
+    if (stats.buffers > 0) std::cerr << ", " << stats.mixMs * 1000 / stats.buffers << " us mixing each";
+    if (stats.played > 0) {
+        std::cerr << ", latency " << stats.latencyMs / stats.played << " ms (worst " << stats.worstLatencyMs << " ms)";
+    }
+    std::cerr << std::endl;
+}
+
+// Arena chunks plus any column that still grows on the heap
+unsigned entityHeapAllocations() {
+    return levelArenas[0].heapChunks + levelArenas[1].heapChunks + worldArena.heapChunks + columnHeapAllocations;
+}
+
+static void reportArena(const Arena& arena) {
+    std::cerr << "arena " << arena.name << ": " << arena.used / 1024.0 << " KB in " << arena.allocations
+              << " allocations, peak " << arena.highWater / 1024.0 << " KB, " << arena.resets << " resets, "
+              << arena.heapChunks << " heap chunks" << std::endl;
+}
+
+// Exit status for --check-allocations: 1 if any steady-state frame or
+// tick allocated
+int reportAllocations() {
+    reportAllocationPeriod(frameAllocations);
+    reportAllocationPeriod(tickAllocations);
+    if (!checkAllocations) return 0;
+
+    reportAllocationSites(10);
+    return frameAllocations.steadyAllocating > 0 || tickAllocations.steadyAllocating > 0;
+}
+
+void reportArenaStats() {
+    reportArena(levelArenas[0]);
+    reportArena(levelArenas[1]);
+    reportArena(worldArena);
+    std::cerr << "entity heap allocations during play: " << entityHeapAllocations() - entityHeapBaseline << std::endl;
+}
+
+void startGhostLink() {
+    if (ghostListenPort > 0) {
+        if (ghostListen(ghostLink, ghostListenPort)) {
+            std::cerr << "ghost: waiting for a sender on 127.0.0.1:" << ghostListenPort << std::endl;
+        } else {
+            std::cerr << "ghost: cannot listen on port " << ghostListenPort << std::endl;
+        }
+    } else if (ghostSendPort > 0) {
+        if (ghostConnect(ghostLink, ghostSendPort)) {
+            std::cerr << "ghost: streaming to 127.0.0.1:" << ghostSendPort << std::endl;
+        } else {
+            std::cerr << "ghost: nothing listening on port " << ghostSendPort << std::endl;
+        }
+    }
+}
+
+void sendGhostFrame() {
+    if (ghostSendPort == 0 || !ghostConnected(ghostLink)) return;
+
+    static GhostFrame frame;
+    frame.tick = simulationTick;
+    frame.sendMicros = ghostClockMicros();
+    frame.count = std::min(playerCount, GHOST_MAX_PLAYERS);
+    for (int i = 0; i < frame.count; i++) {
+        const Player& p = players[i];
+        GhostState& s = frame.players[i];
+        s.x = p.x;
+        s.y = p.y;
+        s.z = p.z;
+        s.rotation = p.rotation;
+        s.bobOffset = p.bobOffset;
+        s.onGround = p.onGround;
+        s.alive = p.alive;
+    }
+    ghostSend(ghostLink, frame);
+}
+
+static void recordGhostArrival(const GhostFrame& frame) {
+    recordLatency(ghostNetworkLatency, (unsigned)(ghostClockMicros() - frame.sendMicros) / 1000.0);
+}
+
+void receiveGhostFrames() {
+    if (ghostListenPort == 0) return;
+    ghostReceive(ghostLink, ghostBuffer, recordGhostArrival);
+}
+
+// Remote princes, drawn a few ticks behind the stream and interpolated
+// between ticks at the display rate
+void drawRemoteGhosts() {
+    if (ghostListenPort == 0) return;
+
+    double now = nowMs();
+    double elapsedTicks = lastGhostSampleMs > 0 ? (now - lastGhostSampleMs) / 16.0 : 0;
+    lastGhostSampleMs = now;
+    ghostViewValid = sampleGhosts(ghostBuffer, elapsedTicks, ghostView);
+    if (!ghostViewValid) return;
+    recordLatency(ghostDisplayLatency, (unsigned)(ghostClockMicros() - ghostView.sendMicros) / 1000.0);
+
+    static Player ghost;
+    for (int i = 0; i < ghostView.count; i++) {
+        const GhostState& s = ghostView.players[i];
+        if (!s.alive || s.y < cameraY - 100 || s.y > cameraY + 600) continue;
+        ghost.x = s.x;
+        ghost.y = s.y;
+        ghost.z = s.z;
+        ghost.rotation = s.rotation;
+        ghost.bobOffset = s.bobOffset;
+        ghost.onGround = s.onGround;
+        drawPrinceCharacter(ghost, gameTime * SCARF_WAVE_SPEED + i);
+    }
+}
+
+void reportGhostStats() {
+    if (ghostLink.packets == 0) return;
+    std::cerr << "ghost: " << ghostLink.packets << " ticks, " << (double)ghostLink.bytes / ghostLink.packets
+              << " bytes/tick " << (ghostSendPort > 0 ? "sent" : "received");
+    if (ghostListenPort > 0) {
+        std::cerr << ", " << ghostBuffer.underruns << " underruns, " << ghostBuffer.skips << " skips";
+    } else {
+        std::cerr << ", " << ghostLink.dropped << " dropped while the receiver lagged";
+    }
+    std::cerr << std::endl;
+    reportLatencyPercentiles("ghost network", ghostNetworkLatency);
+    reportLatencyPercentiles("ghost end-to-end", ghostDisplayLatency);
 }
 
 // Input handlers
 void keyPressed(unsigned char key, int x, int y) {
+    wakeFromIdle();
     if (key == ' ') {
-        spaceKey = true;
+        queueInput(INPUT_JUMP, true);
         if (!gameRunning) {
             resetGame();
         }
     }
+    if (key == 'b' || key == 'B') {
+        toggleRenderBackend();
+    }
+    if (key == 'r' || key == 'R') {
+        rewindHeld = true;
+    }
+    if (key == 'o' || key == 'O') {
+        toggleOverdraw();
+    }
     if (key == 27) {
-        exit(0);
+        reportInputLatency();
+        reportRewindStats();
+        reportTransformStats();
+        reportImpostorStats();
+        reportStarFieldStats(starField);
+        reportSceneListStats();
+        reportPlanetBatchStats();
+        reportIdleStats();
+        overdrawReport(overdraw);
+        stopChapterWorker();
+        reportPrefetchStats();
+        reportGhostStats();
+        reportArenaStats();
+        stopTelemetry();
+        stopAudio();
+        exit(reportAllocations());
     }
 }
 
 void keyReleased(unsigned char key, int x, int y) {
+    wakeFromIdle();
     if (key == ' ') {
-        spaceKey = false;
+        queueInput(INPUT_JUMP, false);
+    }
+    if (key == 'r' || key == 'R') {
+        rewindHeld = false;
     }
 }
 
 void specialKeyPressed(int key, int x, int y) {
+    wakeFromIdle();
     switch (key) {
         case GLUT_KEY_LEFT:
-            leftKey = true;
+            queueInput(INPUT_LEFT, true);
             break;
         case GLUT_KEY_RIGHT:
-            rightKey = true;
+            queueInput(INPUT_RIGHT, true);
+            break;
+        case GLUT_KEY_F5:
+            saveGameState(quickSave);
+            std::cerr << "Saved state at tick " << simulationTick << " (" << quickSave.size() << " bytes)" << std::endl;
+            break;
+        case GLUT_KEY_F9:
+            if (!quickSave.empty()) {
+                loadGameState(quickSave);
+                clearRewindBuffer(rewindBuffer);
+                std::cerr << "Loaded state from tick " << simulationTick << std::endl;
+            }
             break;
     }
 }
 
 void specialKeyReleased(int key, int x, int y) {
+    wakeFromIdle();
     switch (key) {
         case GLUT_KEY_LEFT:
-            leftKey = false;
+            queueInput(INPUT_LEFT, false);
             break;
         case GLUT_KEY_RIGHT:
-            rightKey = false;
+            queueInput(INPUT_RIGHT, false);
             break;
     }
 }
 
 void reshape(int w, int h) {
-    glViewport(0, 0, w, h);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(50.0, (double)w / (double)h, 1.0, 2000.0);
-    glMatrixMode(GL_MODELVIEW);
+    windowWidth = w;
+    windowHeight = h;
+    rViewport(0, 0, w, h);
+    rMatrixMode(GL_PROJECTION);
+    rLoadIdentity();
+    rPerspective(50.0, (double)w / (double)h, 1.0, 2000.0);
+    rMatrixMode(GL_MODELVIEW);
 }
 
 int main(int argc, char** argv) {
-    srand(static_cast<unsigned int>(time(NULL)));
+    seedRandom(static_cast<unsigned int>(time(NULL)));
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--shader") requestedBackend = RENDER_SHADER;
+        else if (arg == "--legacy") requestedBackend = RENDER_LEGACY;
+        else if (arg.compare(0, 15, "--frame-budget=") == 0) frameBudgetMs = atof(arg.c_str() + 15);
+        else if (arg.compare(0, 15, "--render-scale=") == 0) fixedRenderScale = std::max(25, std::min(100, atoi(arg.c_str() + 15)));
+        else if (arg.compare(0, 7, "--seed=") == 0) seedRandom(strtoul(arg.c_str() + 7, NULL, 10));
+        else if (arg.compare(0, 14, "--trace-state=") == 0) stateTrace.open(arg.c_str() + 14);
+        else if (arg.compare(0, 10, "--players=") == 0) playerCount = std::max(1, std::min(MAX_PLAYERS, atoi(arg.c_str() + 10)));
+        else if (arg == "--headless") headless = true;
+        else if (arg == "--software") softwareRun = true;
+        else if (arg.compare(0, 17, "--raster-threads=") == 0) rasterThreads = std::max(1, atoi(arg.c_str() + 17));
+        else if (arg.compare(0, 15, "--draw-threads=") == 0) drawThreads = std::max(1, atoi(arg.c_str() + 15));
+        else if (arg.compare(0, 9, "--frames=") == 0) softwareFrames = std::max(1, atoi(arg.c_str() + 9));
+        else if (arg.compare(0, 13, "--frame-dump=") == 0) frameDumpPath = arg.substr(13);
+        else if (arg == "--overdraw") overdraw.enabled = true;
+        else if (arg == "--check-allocations") checkAllocations = true;
+        else if (arg.compare(0, 8, "--ticks=") == 0) headlessTicks = atoi(arg.c_str() + 8);
+        else if (arg.compare(0, 14, "--decorations=") == 0) decorationMultiplier = std::max(1, std::min(MAX_DECORATION_MULTIPLIER, atoi(arg.c_str() + 14)));
+        else if (arg.compare(0, 17, "--validate-seeds=") == 0) validateSeeds = atoi(arg.c_str() + 17);
+        else if (arg.compare(0, 10, "--threads=") == 0) validatorThreads = atoi(arg.c_str() + 10);
+        else if (arg.compare(0, 15, "--ghost-listen=") == 0) ghostListenPort = atoi(arg.c_str() + 15);
+        else if (arg.compare(0, 13, "--ghost-send=") == 0) ghostSendPort = atoi(arg.c_str() + 13);
+        else if (arg.compare(0, 12, "--telemetry=") == 0 && !telemetryStart(arg.c_str() + 12)) {
+            std::cerr << "telemetry: cannot write " << arg.c_str() + 12 << std::endl;
+        } else if (arg.compare(0, 8, "--audio=") == 0) {
+            std::string sink = arg.substr(8);
+            if (!audioStart(sink == "null" ? AUDIO_SINK_NULL : AUDIO_SINK_FILE, sink.c_str())) {
+                std::cerr << "audio: cannot write " << sink << std::endl;
+            }
+        }
+    }
+
+    atexit(audioStop);
+    if (checkAllocations && !setAllocationAttribution(true)) {
+        std::cerr << "allocations: call sites are not available on this platform" << std::endl;
+    }
+    if (validateSeeds > 0) {
+        return runSeedValidator();
+    }
+    atexit(stopChapterWorker);
+    atexit(stopSceneListThreads);
+    if (headless) {
+        return runHeadless();
+    }
+    if (softwareRun) {
+        return runSoftware();
+    }
 
     glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH | GLUT_STENCIL);
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
     glutInitWindowPosition(100, 100);
     glutCreateWindow("Le Petit Prince: A Journey Among the Stars");
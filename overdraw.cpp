@@ -0,0 +1,155 @@
+#include "overdraw.h"
+#include "renderer.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+static const char* const STAGE_NAMES[DRAW_STAGES] = {
+    "sky", "nebula", "particles", "decorations", "planets", "princes", "hud"
+};
+
+// Heatmap colour for 0, 1, ... 7 or more writes per pixel
+static const int HEAT_LEVELS = 8;
+static const float HEAT_COLORS[HEAT_LEVELS][3] = {
+    {0.0f, 0.0f, 0.0f},
+    {0.0f, 0.0f, 0.6f},
+    {0.0f, 0.5f, 1.0f},
+    {0.0f, 0.8f, 0.2f},
+    {1.0f, 1.0f, 0.0f},
+    {1.0f, 0.5f, 0.0f},
+    {1.0f, 0.0f, 0.0f},
+    {1.0f, 1.0f, 1.0f}
+};
+
+const char* drawStageName(int stage) {
+    return stage >= 0 && stage < DRAW_STAGES ? STAGE_NAMES[stage] : "?";
+}
+
+void overdrawBeginFrame(OverdrawProfiler& profiler, int width, int height) {
+    if (!profiler.enabled) return;
+
+    if (width != profiler.width || height != profiler.height) {
+        profiler.width = width;
+        profiler.height = height;
+        profiler.counts.resize((size_t)width * height);
+        profiler.previous.resize((size_t)width * height);
+    }
+    std::fill(profiler.previous.begin(), profiler.previous.end(), 0);
+    for (int i = 0; i < DRAW_STAGES; i++) {
+        profiler.average[i] = 0;
+        profiler.peak[i] = 0;
+    }
+    profiler.stage = STAGE_SKY;
+
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_STENCIL_TEST);
+    glStencilMask(0xff);
+    glStencilFunc(GL_ALWAYS, 0, 0xff);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+}
+
+void overdrawStage(OverdrawProfiler& profiler, int stage) {
+    if (!profiler.enabled || profiler.counts.empty()) return;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, profiler.width, profiler.height, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &profiler.counts[0]);
+
+    // Counts only grow within a frame, so the difference from the last
+    // read is what this stage wrote
+    unsigned long long sum = 0;
+    int peak = 0;
+    size_t pixels = profiler.counts.size();
+    for (size_t i = 0; i < pixels; i++) {
+        int written = profiler.counts[i] - profiler.previous[i];
+        sum += written;
+        if (written > peak) peak = written;
+    }
+    profiler.average[profiler.stage] += (double)sum / pixels;
+    if (peak > profiler.peak[profiler.stage]) profiler.peak[profiler.stage] = peak;
+
+    profiler.counts.swap(profiler.previous);
+    profiler.stage = stage;
+}
+
+void overdrawEndFrame(OverdrawProfiler& profiler) {
+    if (!profiler.enabled || profiler.counts.empty()) return;
+    overdrawStage(profiler, profiler.stage);
+
+    // After the last read the frame's totals are in previous
+    unsigned long long sum = 0;
+    int peak = 0;
+    for (size_t i = 0; i < profiler.previous.size(); i++) {
+        sum += profiler.previous[i];
+        if (profiler.previous[i] > peak) peak = profiler.previous[i];
+    }
+    profiler.frameAverage = (double)sum / profiler.previous.size();
+    profiler.framePeak = peak;
+
+    for (int i = 0; i < DRAW_STAGES; i++) {
+        profiler.windowAverage[i] += profiler.average[i];
+        if (profiler.peak[i] > profiler.windowPeak[i]) profiler.windowPeak[i] = profiler.peak[i];
+    }
+    profiler.windowFrameAverage += profiler.frameAverage;
+    if (peak > profiler.windowFramePeak) profiler.windowFramePeak = peak;
+    profiler.windowFrames++;
+
+    // Paint the heatmap with one full-screen quad per level, letting the
+    // stencil test pick the pixels that were written that many times
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    rDisable(GL_LIGHTING);
+    rDisable(GL_DEPTH_TEST);
+    rDisable(GL_BLEND);
+
+    rMatrixMode(GL_PROJECTION);
+    rPushMatrix();
+    rLoadIdentity();
+    rMatrixMode(GL_MODELVIEW);
+    rPushMatrix();
+    rLoadIdentity();
+
+    for (int level = 0; level < HEAT_LEVELS; level++) {
+        // GL_LEQUAL passes when level <= the stored count
+        glStencilFunc(level < HEAT_LEVELS - 1 ? GL_EQUAL : GL_LEQUAL, level, 0xff);
+        rColor3f(HEAT_COLORS[level][0], HEAT_COLORS[level][1], HEAT_COLORS[level][2]);
+        rBegin(GL_QUADS);
+        rVertex3f(-1, -1, 0);
+        rVertex3f(1, -1, 0);
+        rVertex3f(1, 1, 0);
+        rVertex3f(-1, 1, 0);
+        rEnd();
+    }
+
+    rPopMatrix();
+    rMatrixMode(GL_PROJECTION);
+    rPopMatrix();
+    rMatrixMode(GL_MODELVIEW);
+
+    glDisable(GL_STENCIL_TEST);
+    rEnable(GL_DEPTH_TEST);
+    rEnable(GL_LIGHTING);
+}
+
+void overdrawReport(OverdrawProfiler& profiler) {
+    if (profiler.windowFrames == 0) return;
+
+    std::cerr << std::fixed << std::setprecision(2)
+              << "overdraw over " << profiler.windowFrames << " frames: "
+              << profiler.windowFrameAverage / profiler.windowFrames << " writes/pixel, peak "
+              << profiler.windowFramePeak << std::endl;
+    for (int i = 0; i < DRAW_STAGES; i++) {
+        std::cerr << "  " << std::setw(12) << std::left << drawStageName(i) << std::right
+                  << profiler.windowAverage[i] / profiler.windowFrames << " avg, "
+                  << profiler.windowPeak[i] << " peak" << std::endl;
+    }
+    std::cerr.unsetf(std::ios::floatfield);
+    std::cerr << std::setprecision(6);
+
+    for (int i = 0; i < DRAW_STAGES; i++) {
+        profiler.windowAverage[i] = 0;
+        profiler.windowPeak[i] = 0;
+    }
+    profiler.windowFrameAverage = 0;
+    profiler.windowFramePeak = 0;
+    profiler.windowFrames = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <vector>
+
+// Overdraw profiling. While enabled every fragment that passes the depth
+// test increments the stencil buffer, so at the end of a frame each pixel
+// holds how many times it was written. Reading the stencil back between
+// draw stages attributes those writes to the stage that made them; the
+// final counts are shown as a heatmap over the frame.
+
+enum DrawStage {
+    STAGE_SKY = 0,                // gradient quads
+    STAGE_NEBULA,                 // blended nebula puffs
+    STAGE_PARTICLES,              // stars, shooting stars, stardust, petals
+    STAGE_DECORATIONS,            // roses and foxes, meshes and impostors
+    STAGE_PLANETS,
+    STAGE_PRINCES,                // the prince, bots and remote ghosts
+    STAGE_HUD,
+    DRAW_STAGES
+};
+
+const int OVERDRAW_REPORT_FRAMES = 120;
+
+struct OverdrawProfiler {
+    bool enabled;
+    int width, height;
+    int stage;                        // stage new fragments are counted against
+    std::vector<unsigned char> counts;
+    std::vector<unsigned char> previous;
+
+    // Last frame: writes per pixel on average and at the worst pixel
+    double average[DRAW_STAGES];
+    int peak[DRAW_STAGES];
+    double frameAverage;
+    int framePeak;
+
+    // Sums over the current report window
+    double windowAverage[DRAW_STAGES];
+    int windowPeak[DRAW_STAGES];
+    double windowFrameAverage;
+    int windowFramePeak;
+    int windowFrames;
+
+    OverdrawProfiler() : enabled(false), width(0), height(0), stage(STAGE_SKY),
+                         frameAverage(0), framePeak(0), windowFrameAverage(0), windowFramePeak(0), windowFrames(0) {
+        for (int i = 0; i < DRAW_STAGES; i++) {
+            average[i] = 0;
+            peak[i] = 0;
+            windowAverage[i] = 0;
+            windowPeak[i] = 0;
+        }
+    }
+};
+
+const char* drawStageName(int stage);
+
+// Clear the counts and start counting in STAGE_SKY. Does nothing unless
+// the profiler is enabled; the framebuffer needs a stencil buffer.
+void overdrawBeginFrame(OverdrawProfiler& profiler, int width, int height);
+
+// Attribute everything drawn since the last marker to the current stage
+// and count from here on against `stage`
+void overdrawStage(OverdrawProfiler& profiler, int stage);
+
+// Close the last stage, stop counting and draw the heatmap over the frame
+void overdrawEndFrame(OverdrawProfiler& profiler);
+
+// Print per-stage averages and peaks over the window to stderr and start
+// a new window
+void overdrawReport(OverdrawProfiler& profiler);
+
+#endif
@@ -0,0 +1,1645 @@
+#include "renderer.h"
+#include "softraster.h"
+#include "software_font.h"
+#include <GL/freeglut_ext.h>
+#include <GL/glext.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RENDERER_SSE 1
+#endif
+
+// GL 2.0+ entry points used by the shader backend. opengl32 on Windows only
+// exports 1.1, so everything newer is looked up at runtime.
+struct ShaderGL {
+    PFNGLGENVERTEXARRAYSPROC GenVertexArrays;
+    PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+    PFNGLGENBUFFERSPROC GenBuffers;
+    PFNGLBINDBUFFERPROC BindBuffer;
+    PFNGLBUFFERDATAPROC BufferData;
+    PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+    PFNGLVERTEXATTRIB4FPROC VertexAttrib4f;
+    PFNGLVERTEXATTRIB1FPROC VertexAttrib1f;
+    PFNGLVERTEXATTRIBDIVISORPROC VertexAttribDivisor;
+    PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+    PFNGLCREATESHADERPROC CreateShader;
+    PFNGLSHADERSOURCEPROC ShaderSource;
+    PFNGLCOMPILESHADERPROC CompileShader;
+    PFNGLGETSHADERIVPROC GetShaderiv;
+    PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+    PFNGLDELETESHADERPROC DeleteShader;
+    PFNGLCREATEPROGRAMPROC CreateProgram;
+    PFNGLATTACHSHADERPROC AttachShader;
+    PFNGLLINKPROGRAMPROC LinkProgram;
+    PFNGLGETPROGRAMIVPROC GetProgramiv;
+    PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+    PFNGLUSEPROGRAMPROC UseProgram;
+    PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+    PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+    PFNGLUNIFORMMATRIX3FVPROC UniformMatrix3fv;
+    PFNGLUNIFORM4FVPROC Uniform4fv;
+    PFNGLUNIFORM3FPROC Uniform3f;
+    PFNGLUNIFORM1IPROC Uniform1i;
+    PFNGLUNIFORM1FPROC Uniform1f;
+    PFNGLGENFRAMEBUFFERSPROC GenFramebuffers;
+    PFNGLBINDFRAMEBUFFERPROC BindFramebuffer;
+    PFNGLGENRENDERBUFFERSPROC GenRenderbuffers;
+    PFNGLBINDRENDERBUFFERPROC BindRenderbuffer;
+    PFNGLRENDERBUFFERSTORAGEPROC RenderbufferStorage;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC FramebufferRenderbuffer;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC CheckFramebufferStatus;
+};
+
+// Unit mesh cached in a vertex buffer for the shader backend, or in memory
+// for the software one
+struct ShaderMesh {
+    int kind;
+    float paramA, paramB;
+    int paramC, paramD;
+    GLuint vao, vbo;
+    int count;
+    std::vector<MeshVertex> vertices;
+};
+
+// Mesh kept by rStoreMesh(). The vertices stay in memory for the legacy and
+// software backends; the vertex array also reads the instance buffer.
+struct StoredMesh {
+    GLuint vao, vbo;
+    std::vector<MeshVertex> vertices;
+};
+
+// Vertex in clip space on the software backend, before the divide by w
+struct ClipVertex {
+    float x, y, z, w;
+    float r, g, b, a;
+    float u, v;
+};
+
+enum ShaderMeshKind {
+    SHADER_MESH_SPHERE = 0,
+    SHADER_MESH_CUBE,
+    SHADER_MESH_TORUS
+};
+
+// Lighting and colour state matches the GL_LIGHT0 + GL_COLOR_MATERIAL setup
+// so both backends produce the same image. Instanced draws place each
+// instance with aInstance and aInstanceScale; everything else leaves them
+// at their identity defaults.
+static const char* VERTEX_SHADER_SOURCE =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 aPosition;\n"
+    "layout(location = 1) in vec3 aNormal;\n"
+    "layout(location = 2) in vec4 aColor;\n"
+    "layout(location = 3) in mat4 aInstance;\n"
+    "layout(location = 7) in float aInstanceScale;\n"
+    "uniform mat4 uProjection;\n"
+    "uniform mat4 uModelView;\n"
+    "uniform mat3 uNormalMatrix;\n"
+    "uniform vec3 uMeshScale;\n"
+    "uniform int uLighting;\n"
+    "uniform float uPointSize;\n"
+    "uniform vec4 uSceneAmbient;\n"
+    "uniform vec4 uLightAmbient;\n"
+    "uniform vec4 uLightDiffuse;\n"
+    "uniform vec4 uLightPosition;\n"
+    "out vec4 vColor;\n"
+    "void main() {\n"
+    "    vec4 eye = uModelView * (aInstance * vec4(aPosition * uMeshScale * aInstanceScale, 1.0));\n"
+    "    gl_Position = uProjection * eye;\n"
+    "    gl_PointSize = uPointSize;\n"
+    "    if (uLighting != 0) {\n"
+    "        vec3 n = uNormalMatrix * (transpose(inverse(mat3(aInstance))) * aNormal);\n"
+    "        vec3 l = normalize(uLightPosition.xyz - eye.xyz * uLightPosition.w);\n"
+    "        float diffuse = max(dot(n, l), 0.0);\n"
+    "        vec3 lit = aColor.rgb * (uSceneAmbient.rgb + uLightAmbient.rgb) + aColor.rgb * uLightDiffuse.rgb * diffuse;\n"
+    "        vColor = vec4(clamp(lit, 0.0, 1.0), aColor.a);\n"
+    "    } else {\n"
+    "        vColor = aColor;\n"
+    "    }\n"
+    "}\n";
+
+static const char* FRAGMENT_SHADER_SOURCE =
+    "#version 330 core\n"
+    "in vec4 vColor;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragColor = vColor;\n"
+    "}\n";
+
+// Unlit textured sprites, tinted by the current colour and cut out at half
+// alpha like the legacy path's alpha test
+static const char* SPRITE_VERTEX_SOURCE =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 aPosition;\n"
+    "layout(location = 1) in vec2 aTexCoord;\n"
+    "uniform mat4 uProjection;\n"
+    "uniform mat4 uModelView;\n"
+    "out vec2 vTexCoord;\n"
+    "void main() {\n"
+    "    gl_Position = uProjection * uModelView * vec4(aPosition, 1.0);\n"
+    "    vTexCoord = aTexCoord;\n"
+    "}\n";
+
+static const char* SPRITE_FRAGMENT_SOURCE =
+    "#version 330 core\n"
+    "in vec2 vTexCoord;\n"
+    "uniform sampler2D uTexture;\n"
+    "uniform vec4 uColor;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    vec4 texel = texture(uTexture, vTexCoord) * uColor;\n"
+    "    if (texel.a < 0.5) discard;\n"
+    "    fragColor = texel;\n"
+    "}\n";
+
+// Default GL_LIGHT_MODEL_AMBIENT
+static const float SCENE_AMBIENT[4] = {0.2f, 0.2f, 0.2f, 1.0f};
+
+static int backend = RENDER_LEGACY;
+static bool shaderAvailable = false;
+static ShaderGL gl3;
+
+static GLenum matrixMode = GL_MODELVIEW;
+static std::vector<Mat4> modelViewStack(1, mat4Identity());
+static std::vector<Mat4> projectionStack(1, mat4Identity());
+static float currentColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+static bool lightingEnabled = false;
+static float currentPointSize = 1.0f;
+static int tessellationPercent = 100;
+static float lightAmbient[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+static float lightDiffuse[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+static float lightPosition[4] = {0.0f, 0.0f, 1.0f, 0.0f};
+
+static GLuint program = 0;
+static bool programBound = false;
+static GLint uProjection, uModelView, uNormalMatrix, uMeshScale, uLighting, uPointSize;
+static GLint uSceneAmbient, uLightAmbient, uLightDiffuse, uLightPosition;
+static GLuint streamVao = 0, streamVbo = 0;
+static GLuint spriteProgram = 0;
+static GLint uSpriteProjection, uSpriteModelView, uSpriteColor;
+static GLuint spriteVao = 0, spriteVbo = 0;
+static GLuint offscreenFbo = 0, offscreenColor = 0, offscreenDepth = 0;
+static int offscreenWidth = 0, offscreenHeight = 0;
+static std::vector<ShaderMesh> shaderMeshes;
+static std::vector<StoredMesh> storedMeshes;
+static GLuint instanceVbo = 0;
+static std::vector<MeshVertex> scaledVertices;    // a stored mesh at an instance's scale, legacy backend
+static std::vector<MeshVertex> immediateVertices;
+static GLenum immediateMode = GL_TRIANGLES;
+
+// The software backend cuts immediate mode and vertex streams short at
+// this many vertices, on a whole primitive, rather than growing its
+// buffers mid-game
+const int MAX_STREAM_VERTICES = 32768;
+static unsigned long long droppedVertices = 0;
+
+static bool depthTestEnabled = false;
+static bool blendEnabled = false;
+static float currentLineWidth = 1.0f;
+static int viewport[4] = {0, 0, 0, 0};
+static float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+static SoftRaster softRaster;
+static RasterTarget windowTarget, offscreenTarget;
+static std::vector<ClipVertex> clipVertices;
+
+// Matrix helpers
+Mat4 mat4Identity() {
+    Mat4 r;
+    for (int i = 0; i < 16; i++) {
+        r.m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+    return r;
+}
+
+// Each result column is a's columns weighted by one column of b: four
+// broadcasts and multiply-adds per column with SSE
+Mat4 mat4Multiply(const Mat4& a, const Mat4& b) {
+    Mat4 r;
+#ifdef RENDERER_SSE
+    __m128 a0 = _mm_loadu_ps(a.m);
+    __m128 a1 = _mm_loadu_ps(a.m + 4);
+    __m128 a2 = _mm_loadu_ps(a.m + 8);
+    __m128 a3 = _mm_loadu_ps(a.m + 12);
+    for (int c = 0; c < 4; c++) {
+        const float* col = b.m + c * 4;
+        __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(col[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(col[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(col[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(col[3])));
+        _mm_storeu_ps(r.m + c * 4, sum);
+    }
+#else
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) {
+            r.m[c * 4 + row] = a.m[row] * b.m[c * 4] + a.m[4 + row] * b.m[c * 4 + 1] +
+                               a.m[8 + row] * b.m[c * 4 + 2] + a.m[12 + row] * b.m[c * 4 + 3];
+        }
+    }
+#endif
+    return r;
+}
+
+Mat4 mat4Translate(float x, float y, float z) {
+    Mat4 r = mat4Identity();
+    r.m[12] = x;
+    r.m[13] = y;
+    r.m[14] = z;
+    return r;
+}
+
+// Rotation by angle degrees about an axis, as glRotatef
+Mat4 mat4Rotate(float angle, float x, float y, float z) {
+    float len = sqrt(x * x + y * y + z * z);
+    if (len > 0) {
+        x /= len;
+        y /= len;
+        z /= len;
+    }
+    float rad = angle * 3.14159265f / 180.0f;
+    float c = cos(rad);
+    float s = sin(rad);
+    float t = 1.0f - c;
+
+    Mat4 r = mat4Identity();
+    r.m[0] = x * x * t + c;
+    r.m[1] = y * x * t + z * s;
+    r.m[2] = x * z * t - y * s;
+    r.m[4] = x * y * t - z * s;
+    r.m[5] = y * y * t + c;
+    r.m[6] = y * z * t + x * s;
+    r.m[8] = x * z * t + y * s;
+    r.m[9] = y * z * t - x * s;
+    r.m[10] = z * z * t + c;
+    return r;
+}
+
+Mat4 mat4Scale(float x, float y, float z) {
+    Mat4 r = mat4Identity();
+    r.m[0] = x;
+    r.m[5] = y;
+    r.m[10] = z;
+    return r;
+}
+
+// Same matrix as glOrtho
+Mat4 mat4Ortho(float left, float right, float bottom, float top, float zNear, float zFar) {
+    Mat4 r = mat4Identity();
+    r.m[0] = 2.0f / (right - left);
+    r.m[5] = 2.0f / (top - bottom);
+    r.m[10] = -2.0f / (zFar - zNear);
+    r.m[12] = -(right + left) / (right - left);
+    r.m[13] = -(top + bottom) / (top - bottom);
+    r.m[14] = -(zFar + zNear) / (zFar - zNear);
+    return r;
+}
+
+void bakeReset(BakeTransform& xf) {
+    xf.model = mat4Identity();
+    xf.normal = mat4Identity();
+}
+
+void bakeTranslate(BakeTransform& xf, float x, float y, float z) {
+    xf.model = mat4Multiply(xf.model, mat4Translate(x, y, z));
+}
+
+void bakeRotate(BakeTransform& xf, float angle, float x, float y, float z) {
+    Mat4 r = mat4Rotate(angle, x, y, z);
+    xf.model = mat4Multiply(xf.model, r);
+    xf.normal = mat4Multiply(xf.normal, r);
+}
+
+void bakeScale(BakeTransform& xf, float x, float y, float z) {
+    xf.model = mat4Multiply(xf.model, mat4Scale(x, y, z));
+    xf.normal = mat4Multiply(xf.normal, mat4Scale(1.0f / x, 1.0f / y, 1.0f / z));
+}
+
+static void bakeVertex(std::vector<MeshVertex>& out, const BakeTransform& xf,
+                       float px, float py, float pz, float nx, float ny, float nz, const float color[4]) {
+    const float* m = xf.model.m;
+    const float* n = xf.normal.m;
+    MeshVertex v;
+    v.x = m[0] * px + m[4] * py + m[8] * pz + m[12];
+    v.y = m[1] * px + m[5] * py + m[9] * pz + m[13];
+    v.z = m[2] * px + m[6] * py + m[10] * pz + m[14];
+    v.nx = n[0] * nx + n[4] * ny + n[8] * nz;
+    v.ny = n[1] * nx + n[5] * ny + n[9] * nz;
+    v.nz = n[2] * nx + n[6] * ny + n[10] * nz;
+    v.r = color[0];
+    v.g = color[1];
+    v.b = color[2];
+    v.a = color[3];
+    out.push_back(v);
+}
+
+// Bake a cube as glutSolidCube(size) would draw it
+void bakeCube(std::vector<MeshVertex>& out, const BakeTransform& xf, float size, const float color[4]) {
+    static const float faces[6][9] = {
+        // normal, u axis, v axis
+        { 1, 0, 0,   0, 1, 0,   0, 0, 1},
+        {-1, 0, 0,   0, 0, 1,   0, 1, 0},
+        { 0, 1, 0,   0, 0, 1,   1, 0, 0},
+        { 0,-1, 0,   1, 0, 0,   0, 0, 1},
+        { 0, 0, 1,   1, 0, 0,   0, 1, 0},
+        { 0, 0,-1,   0, 1, 0,   1, 0, 0}
+    };
+    float h = size / 2;
+
+    for (int f = 0; f < 6; f++) {
+        const float* n = faces[f];
+        const float* u = faces[f] + 3;
+        const float* v = faces[f] + 6;
+        float corners[4][3];
+        const float su[4] = {-1, 1, 1, -1};
+        const float sv[4] = {-1, -1, 1, 1};
+        for (int c = 0; c < 4; c++) {
+            for (int k = 0; k < 3; k++) {
+                corners[c][k] = (n[k] + u[k] * su[c] + v[k] * sv[c]) * h;
+            }
+        }
+        const int order[6] = {0, 1, 2, 0, 2, 3};
+        for (int k = 0; k < 6; k++) {
+            const float* p = corners[order[k]];
+            bakeVertex(out, xf, p[0], p[1], p[2], n[0], n[1], n[2], color);
+        }
+    }
+}
+
+// Bake a sphere with the same slice/stack layout as glutSolidSphere (poles on z)
+void bakeSphere(std::vector<MeshVertex>& out, const BakeTransform& xf, float radius, int slices, int stacks, const float color[4]) {
+    for (int i = 0; i < stacks; i++) {
+        float phi0 = 3.14159265f * i / stacks;
+        float phi1 = 3.14159265f * (i + 1) / stacks;
+        for (int j = 0; j < slices; j++) {
+            float theta0 = 2.0f * 3.14159265f * j / slices;
+            float theta1 = 2.0f * 3.14159265f * (j + 1) / slices;
+
+            float s0 = sin(phi0), c0 = cos(phi0);
+            float s1 = sin(phi1), c1 = cos(phi1);
+            float ct0 = cos(theta0), st0 = sin(theta0);
+            float ct1 = cos(theta1), st1 = sin(theta1);
+            float n[4][3] = {
+                {s0 * ct0, s0 * st0, c0},
+                {s1 * ct0, s1 * st0, c1},
+                {s1 * ct1, s1 * st1, c1},
+                {s0 * ct1, s0 * st1, c0}
+            };
+
+            int tris[2][3] = {{0, 1, 2}, {0, 2, 3}};
+            for (int t = 0; t < 2; t++) {
+                // Skip the degenerate half of each quad at the poles
+                if (t == 0 && i == stacks - 1) continue;
+                if (t == 1 && i == 0) continue;
+                for (int k = 0; k < 3; k++) {
+                    const float* d = n[tris[t][k]];
+                    bakeVertex(out, xf, d[0] * radius, d[1] * radius, d[2] * radius, d[0], d[1], d[2], color);
+                }
+            }
+        }
+    }
+}
+
+// Bake a torus as glutSolidTorus would draw it (ring around z)
+void bakeTorus(std::vector<MeshVertex>& out, const BakeTransform& xf, float innerRadius, float outerRadius, int sides, int rings, const float color[4]) {
+    for (int i = 0; i < rings; i++) {
+        float theta0 = 2.0f * 3.14159265f * i / rings;
+        float theta1 = 2.0f * 3.14159265f * (i + 1) / rings;
+        for (int j = 0; j < sides; j++) {
+            float phi0 = 2.0f * 3.14159265f * j / sides;
+            float phi1 = 2.0f * 3.14159265f * (j + 1) / sides;
+
+            float thetas[4] = {theta0, theta1, theta1, theta0};
+            float phis[4] = {phi0, phi0, phi1, phi1};
+            float p[4][3], n[4][3];
+            for (int k = 0; k < 4; k++) {
+                float ct = cos(thetas[k]), st = sin(thetas[k]);
+                float cp = cos(phis[k]), sp = sin(phis[k]);
+                float ring = outerRadius + innerRadius * cp;
+                p[k][0] = ring * ct;
+                p[k][1] = ring * st;
+                p[k][2] = innerRadius * sp;
+                n[k][0] = cp * ct;
+                n[k][1] = cp * st;
+                n[k][2] = sp;
+            }
+
+            const int order[6] = {0, 1, 2, 0, 2, 3};
+            for (int k = 0; k < 6; k++) {
+                int c = order[k];
+                bakeVertex(out, xf, p[c][0], p[c][1], p[c][2], n[c][0], n[c][1], n[c][2], color);
+            }
+        }
+    }
+}
+
+// Shader backend setup
+static bool loadShaderGL() {
+#define LOAD_GL(name, type) \
+    gl3.name = (type)glutGetProcAddress("gl" #name); \
+    if (!gl3.name) return false;
+
+    LOAD_GL(GenVertexArrays, PFNGLGENVERTEXARRAYSPROC);
+    LOAD_GL(BindVertexArray, PFNGLBINDVERTEXARRAYPROC);
+    LOAD_GL(GenBuffers, PFNGLGENBUFFERSPROC);
+    LOAD_GL(BindBuffer, PFNGLBINDBUFFERPROC);
+    LOAD_GL(BufferData, PFNGLBUFFERDATAPROC);
+    LOAD_GL(VertexAttribPointer, PFNGLVERTEXATTRIBPOINTERPROC);
+    LOAD_GL(EnableVertexAttribArray, PFNGLENABLEVERTEXATTRIBARRAYPROC);
+    LOAD_GL(VertexAttrib4f, PFNGLVERTEXATTRIB4FPROC);
+    LOAD_GL(VertexAttrib1f, PFNGLVERTEXATTRIB1FPROC);
+    LOAD_GL(VertexAttribDivisor, PFNGLVERTEXATTRIBDIVISORPROC);
+    LOAD_GL(DrawArraysInstanced, PFNGLDRAWARRAYSINSTANCEDPROC);
+    LOAD_GL(CreateShader, PFNGLCREATESHADERPROC);
+    LOAD_GL(ShaderSource, PFNGLSHADERSOURCEPROC);
+    LOAD_GL(CompileShader, PFNGLCOMPILESHADERPROC);
+    LOAD_GL(GetShaderiv, PFNGLGETSHADERIVPROC);
+    LOAD_GL(GetShaderInfoLog, PFNGLGETSHADERINFOLOGPROC);
+    LOAD_GL(DeleteShader, PFNGLDELETESHADERPROC);
+    LOAD_GL(CreateProgram, PFNGLCREATEPROGRAMPROC);
+    LOAD_GL(AttachShader, PFNGLATTACHSHADERPROC);
+    LOAD_GL(LinkProgram, PFNGLLINKPROGRAMPROC);
+    LOAD_GL(GetProgramiv, PFNGLGETPROGRAMIVPROC);
+    LOAD_GL(GetProgramInfoLog, PFNGLGETPROGRAMINFOLOGPROC);
+    LOAD_GL(UseProgram, PFNGLUSEPROGRAMPROC);
+    LOAD_GL(GetUniformLocation, PFNGLGETUNIFORMLOCATIONPROC);
+    LOAD_GL(UniformMatrix4fv, PFNGLUNIFORMMATRIX4FVPROC);
+    LOAD_GL(UniformMatrix3fv, PFNGLUNIFORMMATRIX3FVPROC);
+    LOAD_GL(Uniform4fv, PFNGLUNIFORM4FVPROC);
+    LOAD_GL(Uniform3f, PFNGLUNIFORM3FPROC);
+    LOAD_GL(Uniform1i, PFNGLUNIFORM1IPROC);
+    LOAD_GL(Uniform1f, PFNGLUNIFORM1FPROC);
+    LOAD_GL(GenFramebuffers, PFNGLGENFRAMEBUFFERSPROC);
+    LOAD_GL(BindFramebuffer, PFNGLBINDFRAMEBUFFERPROC);
+    LOAD_GL(GenRenderbuffers, PFNGLGENRENDERBUFFERSPROC);
+    LOAD_GL(BindRenderbuffer, PFNGLBINDRENDERBUFFERPROC);
+    LOAD_GL(RenderbufferStorage, PFNGLRENDERBUFFERSTORAGEPROC);
+    LOAD_GL(FramebufferRenderbuffer, PFNGLFRAMEBUFFERRENDERBUFFERPROC);
+    LOAD_GL(CheckFramebufferStatus, PFNGLCHECKFRAMEBUFFERSTATUSPROC);
+
+#undef LOAD_GL
+    return true;
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = gl3.CreateShader(type);
+    gl3.ShaderSource(shader, 1, &source, NULL);
+    gl3.CompileShader(shader);
+
+    GLint ok = 0;
+    gl3.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        gl3.GetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cerr << "Shader compile failed: " << log << std::endl;
+        gl3.DeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static GLuint linkProgram(const char* vertexSource, const char* fragmentSource) {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (!vs || !fs) return 0;
+
+    GLuint linked = gl3.CreateProgram();
+    gl3.AttachShader(linked, vs);
+    gl3.AttachShader(linked, fs);
+    gl3.LinkProgram(linked);
+    gl3.DeleteShader(vs);
+    gl3.DeleteShader(fs);
+
+    GLint ok = 0;
+    gl3.GetProgramiv(linked, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        gl3.GetProgramInfoLog(linked, sizeof(log), NULL, log);
+        std::cerr << "Shader link failed: " << log << std::endl;
+        return 0;
+    }
+    return linked;
+}
+
+static bool buildShaderProgram() {
+    program = linkProgram(VERTEX_SHADER_SOURCE, FRAGMENT_SHADER_SOURCE);
+    spriteProgram = linkProgram(SPRITE_VERTEX_SOURCE, SPRITE_FRAGMENT_SOURCE);
+    if (!program || !spriteProgram) return false;
+
+    uProjection = gl3.GetUniformLocation(program, "uProjection");
+    uModelView = gl3.GetUniformLocation(program, "uModelView");
+    uNormalMatrix = gl3.GetUniformLocation(program, "uNormalMatrix");
+    uMeshScale = gl3.GetUniformLocation(program, "uMeshScale");
+    uLighting = gl3.GetUniformLocation(program, "uLighting");
+    uPointSize = gl3.GetUniformLocation(program, "uPointSize");
+    uSceneAmbient = gl3.GetUniformLocation(program, "uSceneAmbient");
+    uLightAmbient = gl3.GetUniformLocation(program, "uLightAmbient");
+    uLightDiffuse = gl3.GetUniformLocation(program, "uLightDiffuse");
+    uLightPosition = gl3.GetUniformLocation(program, "uLightPosition");
+    uSpriteProjection = gl3.GetUniformLocation(spriteProgram, "uProjection");
+    uSpriteModelView = gl3.GetUniformLocation(spriteProgram, "uModelView");
+    uSpriteColor = gl3.GetUniformLocation(spriteProgram, "uColor");
+    return true;
+}
+
+static void setVertexLayout(bool perVertexColor) {
+    gl3.EnableVertexAttribArray(0);
+    gl3.VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*)0);
+    gl3.EnableVertexAttribArray(1);
+    gl3.VertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*)(3 * sizeof(float)));
+    if (perVertexColor) {
+        gl3.EnableVertexAttribArray(2);
+        gl3.VertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*)(6 * sizeof(float)));
+    }
+}
+
+void rInit() {
+    immediateVertices.reserve(MAX_STREAM_VERTICES);
+    shaderAvailable = false;
+    // There is no GL context behind the software backend
+    if (backend == RENDER_SOFTWARE) return;
+    if (!loadShaderGL()) {
+        std::cerr << "Shader backend unavailable: GL 3.3 entry points missing" << std::endl;
+        return;
+    }
+    if (!buildShaderProgram()) {
+        std::cerr << "Shader backend unavailable: GLSL 330 program failed" << std::endl;
+        return;
+    }
+
+    gl3.GenVertexArrays(1, &streamVao);
+    gl3.GenBuffers(1, &streamVbo);
+    gl3.BindVertexArray(streamVao);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, streamVbo);
+    setVertexLayout(true);
+
+    gl3.GenVertexArrays(1, &spriteVao);
+    gl3.GenBuffers(1, &spriteVbo);
+    gl3.BindVertexArray(spriteVao);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, spriteVbo);
+    gl3.EnableVertexAttribArray(0);
+    gl3.VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (const void*)0);
+    gl3.EnableVertexAttribArray(1);
+    gl3.VertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (const void*)(3 * sizeof(float)));
+    gl3.BindVertexArray(0);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Draws without an instance buffer see one instance at the identity
+    gl3.GenBuffers(1, &instanceVbo);
+    for (int c = 0; c < 4; c++) gl3.VertexAttrib4f(3 + c, c == 0, c == 1, c == 2, c == 3);
+    gl3.VertexAttrib1f(7, 1.0f);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    shaderAvailable = true;
+}
+
+bool rShaderBackendAvailable() {
+    return shaderAvailable;
+}
+
+// Switch backends between frames. GL state that only one backend keeps up to
+// date is re-synced from the CPU copy.
+void rSetBackend(int newBackend) {
+    if (newBackend == RENDER_SHADER && !shaderAvailable) {
+        std::cerr << "Shader backend unavailable, staying on " << rBackendName(backend) << std::endl;
+        return;
+    }
+    // Without a window there is nothing to switch to, and with one the
+    // software backend was never set up
+    if ((newBackend == RENDER_SOFTWARE) != (softRaster.target != 0)) {
+        std::cerr << rBackendName(newBackend) << " backend unavailable, staying on " << rBackendName(backend) << std::endl;
+        return;
+    }
+    backend = newBackend;
+
+    if (backend == RENDER_LEGACY) {
+        // Client-side vertex arrays break if a buffer is still bound
+        if (shaderAvailable) {
+            gl3.UseProgram(0);
+            gl3.BindVertexArray(0);
+            gl3.BindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        programBound = false;
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(projectionStack.back().m);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadMatrixf(modelViewStack.back().m);
+        glMatrixMode(matrixMode);
+        glColor4fv(currentColor);
+        glPointSize(currentPointSize);
+    }
+}
+
+int rGetBackend() {
+    return backend;
+}
+
+const char* rBackendName(int which) {
+    if (which == RENDER_SOFTWARE) return "software";
+    return which == RENDER_SHADER ? "shader" : "legacy";
+}
+
+void rInitSoftware(int width, int height) {
+    resizeRasterTarget(windowTarget, width, height);
+    reserveRasterQueue(softRaster, windowTarget);
+    clipVertices.resize(MAX_STREAM_VERTICES);
+    setRasterTarget(softRaster, &windowTarget);
+    backend = RENDER_SOFTWARE;
+    viewport[0] = 0;
+    viewport[1] = 0;
+    viewport[2] = width;
+    viewport[3] = height;
+}
+
+void rSetRasterThreads(int threads) {
+    setRasterThreads(softRaster, threads);
+}
+
+void rStopRasterThreads() {
+    stopRasterThreads(softRaster);
+}
+
+void rReportRasterStats(unsigned frames) {
+    reportRasterStats(softRaster, frames);
+    if (droppedVertices > 0) {
+        std::cerr << "software: " << droppedVertices << " vertices dropped past the " << MAX_STREAM_VERTICES
+                  << "-vertex stream limit" << std::endl;
+    }
+    droppedVertices = 0;
+}
+
+// Framebuffer
+void rClearColor(float r, float g, float b, float a) {
+    clearColor[0] = r;
+    clearColor[1] = g;
+    clearColor[2] = b;
+    clearColor[3] = a;
+    if (backend != RENDER_SOFTWARE) glClearColor(r, g, b, a);
+}
+
+void rClear(GLbitfield mask) {
+    if (backend == RENDER_SOFTWARE) {
+        rasterClear(softRaster, (mask & GL_COLOR_BUFFER_BIT) != 0, clearColor, (mask & GL_DEPTH_BUFFER_BIT) != 0, 1.0f);
+        return;
+    }
+    glClear(mask);
+}
+
+void rViewport(int x, int y, int width, int height) {
+    viewport[0] = x;
+    viewport[1] = y;
+    viewport[2] = width;
+    viewport[3] = height;
+    if (backend != RENDER_SOFTWARE) glViewport(x, y, width, height);
+}
+
+void rBlendFunc(GLenum source, GLenum destination) {
+    if (backend != RENDER_SOFTWARE) glBlendFunc(source, destination);
+}
+
+void rReadPixels(int x, int y, int width, int height, unsigned char* rgb) {
+    if (backend == RENDER_SOFTWARE) {
+        readRasterPixels(softRaster, x, y, width, height, rgb);
+        return;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+}
+
+void rFinish() {
+    if (backend == RENDER_SOFTWARE) flushRaster(softRaster);
+    else glFinish();
+}
+
+void rPresent() {
+    if (backend == RENDER_SOFTWARE) flushRaster(softRaster);
+    else glutSwapBuffers();
+}
+
+// Matrix stack
+static std::vector<Mat4>& currentStack() {
+    return matrixMode == GL_PROJECTION ? projectionStack : modelViewStack;
+}
+
+void rMatrixMode(GLenum mode) {
+    matrixMode = mode;
+    if (backend == RENDER_LEGACY) glMatrixMode(mode);
+}
+
+void rLoadIdentity() {
+    currentStack().back() = mat4Identity();
+    if (backend == RENDER_LEGACY) glLoadIdentity();
+}
+
+// Replace the current matrix, typically with view * a cached world matrix
+void rLoadMatrix(const Mat4& matrix) {
+    currentStack().back() = matrix;
+    if (backend == RENDER_LEGACY) glLoadMatrixf(matrix.m);
+}
+
+void rPushMatrix() {
+    std::vector<Mat4>& stack = currentStack();
+    stack.push_back(stack.back());
+    if (backend == RENDER_LEGACY) glPushMatrix();
+}
+
+void rPopMatrix() {
+    std::vector<Mat4>& stack = currentStack();
+    if (stack.size() > 1) stack.pop_back();
+    if (backend == RENDER_LEGACY) glPopMatrix();
+}
+
+void rTranslatef(float x, float y, float z) {
+    Mat4& top = currentStack().back();
+    top = mat4Multiply(top, mat4Translate(x, y, z));
+    if (backend == RENDER_LEGACY) glTranslatef(x, y, z);
+}
+
+void rRotatef(float angle, float x, float y, float z) {
+    Mat4& top = currentStack().back();
+    top = mat4Multiply(top, mat4Rotate(angle, x, y, z));
+    if (backend == RENDER_LEGACY) glRotatef(angle, x, y, z);
+}
+
+void rScalef(float x, float y, float z) {
+    Mat4& top = currentStack().back();
+    top = mat4Multiply(top, mat4Scale(x, y, z));
+    if (backend == RENDER_LEGACY) glScalef(x, y, z);
+}
+
+// Same matrix as gluLookAt
+void rLookAt(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ,
+             float upX, float upY, float upZ) {
+    float f[3] = {centerX - eyeX, centerY - eyeY, centerZ - eyeZ};
+    float fl = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    f[0] /= fl; f[1] /= fl; f[2] /= fl;
+
+    float s[3] = {f[1] * upZ - f[2] * upY, f[2] * upX - f[0] * upZ, f[0] * upY - f[1] * upX};
+    float sl = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+    s[0] /= sl; s[1] /= sl; s[2] /= sl;
+
+    float u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0]};
+
+    Mat4 view = mat4Identity();
+    view.m[0] = s[0]; view.m[4] = s[1]; view.m[8] = s[2];
+    view.m[1] = u[0]; view.m[5] = u[1]; view.m[9] = u[2];
+    view.m[2] = -f[0]; view.m[6] = -f[1]; view.m[10] = -f[2];
+
+    Mat4& top = currentStack().back();
+    top = mat4Multiply(mat4Multiply(top, view), mat4Translate(-eyeX, -eyeY, -eyeZ));
+    if (backend == RENDER_LEGACY) gluLookAt(eyeX, eyeY, eyeZ, centerX, centerY, centerZ, upX, upY, upZ);
+}
+
+// Same matrix as gluPerspective
+void rPerspective(float fovY, float aspect, float zNear, float zFar) {
+    float f = 1.0f / tan(fovY * 3.14159265f / 360.0f);
+    Mat4 p;
+    for (int i = 0; i < 16; i++) p.m[i] = 0;
+    p.m[0] = f / aspect;
+    p.m[5] = f;
+    p.m[10] = (zFar + zNear) / (zNear - zFar);
+    p.m[11] = -1.0f;
+    p.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+
+    Mat4& top = currentStack().back();
+    top = mat4Multiply(top, p);
+    if (backend == RENDER_LEGACY) gluPerspective(fovY, aspect, zNear, zFar);
+}
+
+const Mat4& rModelView() {
+    return modelViewStack.back();
+}
+
+// Render state
+// The shader and software backends always take the ambient and diffuse
+// material from the current colour, as GL_COLOR_MATERIAL is set up here.
+void rEnable(GLenum cap) {
+    if (cap == GL_LIGHTING) lightingEnabled = true;
+    if (cap == GL_DEPTH_TEST) depthTestEnabled = true;
+    if (cap == GL_BLEND) blendEnabled = true;
+    if (backend == RENDER_SOFTWARE) return;
+    glEnable(cap);
+    if (cap == GL_COLOR_MATERIAL) glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+}
+
+void rDisable(GLenum cap) {
+    if (cap == GL_LIGHTING) lightingEnabled = false;
+    if (cap == GL_DEPTH_TEST) depthTestEnabled = false;
+    if (cap == GL_BLEND) blendEnabled = false;
+    if (backend == RENDER_SOFTWARE) return;
+    glDisable(cap);
+}
+
+void rColor3f(float r, float g, float b) {
+    rColor4f(r, g, b, 1.0f);
+}
+
+void rColor4f(float r, float g, float b, float a) {
+    currentColor[0] = r;
+    currentColor[1] = g;
+    currentColor[2] = b;
+    currentColor[3] = a;
+    if (backend == RENDER_LEGACY) glColor4f(r, g, b, a);
+}
+
+void rPointSize(float size) {
+    currentPointSize = size;
+    if (backend == RENDER_LEGACY) glPointSize(size);
+}
+
+void rLineWidth(float width) {
+    currentLineWidth = width;
+    if (backend != RENDER_SOFTWARE) glLineWidth(width);
+}
+
+// GL_LIGHT0 setup. The position is transformed by the current modelview, as
+// glLightfv does, and kept in eye space for the shader.
+void rLight(const float ambient[4], const float diffuse[4], const float position[4]) {
+    const float* m = modelViewStack.back().m;
+    for (int i = 0; i < 4; i++) {
+        lightAmbient[i] = ambient[i];
+        lightDiffuse[i] = diffuse[i];
+        lightPosition[i] = m[i] * position[0] + m[4 + i] * position[1] + m[8 + i] * position[2] + m[12 + i] * position[3];
+    }
+    programBound = false;
+    if (backend == RENDER_SOFTWARE) return;
+
+    glLightfv(GL_LIGHT0, GL_AMBIENT, ambient);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse);
+    glLightfv(GL_LIGHT0, GL_POSITION, position);
+}
+
+// Inverse-transpose of the modelview's upper 3x3, deliberately not
+// normalized, column-major
+static void normalMatrix(const float* m, float normal[9]) {
+    float a = m[0], b = m[4], c = m[8];
+    float d = m[1], e = m[5], f = m[9];
+    float g = m[2], h = m[6], i = m[10];
+    float c00 = e * i - f * h, c01 = f * g - d * i, c02 = d * h - e * g;
+    float c10 = c * h - b * i, c11 = a * i - c * g, c12 = b * g - a * h;
+    float c20 = b * f - c * e, c21 = c * d - a * f, c22 = a * e - b * d;
+    float det = a * c00 + b * c01 + c * c02;
+    float inv = det != 0 ? 1.0f / det : 0.0f;
+    normal[0] = c00 * inv; normal[1] = c10 * inv; normal[2] = c20 * inv;
+    normal[3] = c01 * inv; normal[4] = c11 * inv; normal[5] = c21 * inv;
+    normal[6] = c02 * inv; normal[7] = c12 * inv; normal[8] = c22 * inv;
+}
+
+// Shader backend draw path
+static void shaderPrepareDraw(float scaleX, float scaleY, float scaleZ) {
+    if (!programBound) {
+        gl3.UseProgram(program);
+        gl3.Uniform4fv(uSceneAmbient, 1, SCENE_AMBIENT);
+        gl3.Uniform4fv(uLightAmbient, 1, lightAmbient);
+        gl3.Uniform4fv(uLightDiffuse, 1, lightDiffuse);
+        gl3.Uniform4fv(uLightPosition, 1, lightPosition);
+        programBound = true;
+    }
+
+    const float* m = modelViewStack.back().m;
+    float normal[9];
+    normalMatrix(m, normal);
+
+    gl3.UniformMatrix4fv(uProjection, 1, GL_FALSE, projectionStack.back().m);
+    gl3.UniformMatrix4fv(uModelView, 1, GL_FALSE, m);
+    gl3.UniformMatrix3fv(uNormalMatrix, 1, GL_FALSE, normal);
+    gl3.Uniform3f(uMeshScale, scaleX, scaleY, scaleZ);
+    gl3.Uniform1i(uLighting, lightingEnabled ? 1 : 0);
+    gl3.Uniform1f(uPointSize, currentPointSize);
+}
+
+static void shaderDrawStream(GLenum mode, const MeshVertex* vertices, int count) {
+    if (count <= 0) return;
+    shaderPrepareDraw(1.0f, 1.0f, 1.0f);
+    gl3.BindVertexArray(streamVao);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, streamVbo);
+    gl3.BufferData(GL_ARRAY_BUFFER, count * sizeof(MeshVertex), vertices, GL_STREAM_DRAW);
+    glDrawArrays(mode, 0, count);
+}
+
+static const ShaderMesh& findShaderMesh(int kind, float paramA, float paramB, int paramC, int paramD) {
+    for (size_t i = 0; i < shaderMeshes.size(); i++) {
+        const ShaderMesh& mesh = shaderMeshes[i];
+        if (mesh.kind == kind && mesh.paramA == paramA && mesh.paramB == paramB &&
+            mesh.paramC == paramC && mesh.paramD == paramD) {
+            return mesh;
+        }
+    }
+
+    std::vector<MeshVertex> vertices;
+    BakeTransform xf;
+    bakeReset(xf);
+    const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    switch (kind) {
+        case SHADER_MESH_SPHERE: bakeSphere(vertices, xf, 1.0f, paramC, paramD, white); break;
+        case SHADER_MESH_CUBE: bakeCube(vertices, xf, 1.0f, white); break;
+        case SHADER_MESH_TORUS: bakeTorus(vertices, xf, paramA, paramB, paramC, paramD, white); break;
+    }
+
+    ShaderMesh mesh;
+    mesh.kind = kind;
+    mesh.paramA = paramA;
+    mesh.paramB = paramB;
+    mesh.paramC = paramC;
+    mesh.paramD = paramD;
+    mesh.count = vertices.size();
+    if (backend == RENDER_SOFTWARE) {
+        mesh.vao = mesh.vbo = 0;
+        mesh.vertices.swap(vertices);
+        shaderMeshes.push_back(mesh);
+        return shaderMeshes.back();
+    }
+    gl3.GenVertexArrays(1, &mesh.vao);
+    gl3.GenBuffers(1, &mesh.vbo);
+    gl3.BindVertexArray(mesh.vao);
+    gl3.BindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    gl3.BufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), &vertices[0], GL_STATIC_DRAW);
+    setVertexLayout(false);
+    shaderMeshes.push_back(mesh);
+    return shaderMeshes.back();
+}
+
+// Unit meshes take their colour from the current colour (attribute 2 is not
+// an array for them), like GLUT shapes under GL_COLOR_MATERIAL.
+static void shaderDrawMesh(const ShaderMesh& mesh, float scale) {
+    shaderPrepareDraw(scale, scale, scale);
+    gl3.BindVertexArray(mesh.vao);
+    gl3.VertexAttrib4f(2, currentColor[0], currentColor[1], currentColor[2], currentColor[3]);
+    glDrawArrays(GL_TRIANGLES, 0, mesh.count);
+}
+
+// Software backend draw path. Vertices are transformed and lit on the CPU
+// exactly as the shader does it, clipped against the near and far planes,
+// and handed to the rasterizer in window coordinates; the rasterizer clips
+// to the viewport.
+static int softwareFlags() {
+    return (depthTestEnabled ? RASTER_DEPTH_TEST : 0) | (blendEnabled ? RASTER_BLEND : 0);
+}
+
+static void softwareScissor(int scissor[4]) {
+    const RasterTarget& t = *softRaster.target;
+    scissor[0] = std::max(viewport[0], 0);
+    scissor[1] = std::max(viewport[1], 0);
+    scissor[2] = std::min(viewport[0] + viewport[2], t.width);
+    scissor[3] = std::min(viewport[1] + viewport[3], t.height);
+}
+
+// Unit meshes pass their colour in meshColor; streams carry their own.
+// Returns how many vertices were transformed: as many whole primitives of
+// mode as fit.
+static int softwareTransform(GLenum mode, const MeshVertex* vertices, int count, float scale, const float* meshColor) {
+    if (count > (int)clipVertices.size()) {
+        int perPrimitive = mode == GL_TRIANGLES ? 3 : mode == GL_LINES ? 2 : 1;
+        int kept = (int)clipVertices.size() / perPrimitive * perPrimitive;
+        droppedVertices += count - kept;
+        count = kept;
+    }
+    const Mat4& modelView = modelViewStack.back();
+    Mat4 mvp = mat4Multiply(projectionStack.back(), modelView);
+    const float* m = modelView.m;
+    const float* p = mvp.m;
+    float n[9];
+    normalMatrix(m, n);
+    float ambient[3], diffuse[3];
+    for (int c = 0; c < 3; c++) {
+        ambient[c] = SCENE_AMBIENT[c] + lightAmbient[c];
+        diffuse[c] = lightDiffuse[c];
+    }
+
+    for (int i = 0; i < count; i++) {
+        const MeshVertex& v = vertices[i];
+        float x = v.x * scale, y = v.y * scale, z = v.z * scale;
+        ClipVertex& out = clipVertices[i];
+        out.x = p[0] * x + p[4] * y + p[8] * z + p[12];
+        out.y = p[1] * x + p[5] * y + p[9] * z + p[13];
+        out.z = p[2] * x + p[6] * y + p[10] * z + p[14];
+        out.w = p[3] * x + p[7] * y + p[11] * z + p[15];
+        out.u = out.v = 0;
+
+        const float* color = meshColor ? meshColor : &v.r;
+        out.a = color[3];
+        if (!lightingEnabled) {
+            out.r = color[0];
+            out.g = color[1];
+            out.b = color[2];
+            continue;
+        }
+
+        float ex = m[0] * x + m[4] * y + m[8] * z + m[12];
+        float ey = m[1] * x + m[5] * y + m[9] * z + m[13];
+        float ez = m[2] * x + m[6] * y + m[10] * z + m[14];
+        float nx = n[0] * v.nx + n[3] * v.ny + n[6] * v.nz;
+        float ny = n[1] * v.nx + n[4] * v.ny + n[7] * v.nz;
+        float nz = n[2] * v.nx + n[5] * v.ny + n[8] * v.nz;
+        float lx = lightPosition[0] - ex * lightPosition[3];
+        float ly = lightPosition[1] - ey * lightPosition[3];
+        float lz = lightPosition[2] - ez * lightPosition[3];
+        float length = sqrt(lx * lx + ly * ly + lz * lz);
+        float lambert = length > 0 ? std::max((nx * lx + ny * ly + nz * lz) / length, 0.0f) : 0.0f;
+        float lit[3];
+        for (int c = 0; c < 3; c++) lit[c] = std::min(color[c] * ambient[c] + color[c] * diffuse[c] * lambert, 1.0f);
+        out.r = lit[0];
+        out.g = lit[1];
+        out.b = lit[2];
+    }
+    return count;
+}
+
+static RasterVertex toWindow(const ClipVertex& v) {
+    RasterVertex out;
+    out.invW = 1.0f / v.w;
+    out.x = viewport[0] + (v.x * out.invW + 1.0f) * 0.5f * viewport[2];
+    out.y = viewport[1] + (v.y * out.invW + 1.0f) * 0.5f * viewport[3];
+    out.z = (v.z * out.invW + 1.0f) * 0.5f;
+    out.r = v.r;
+    out.g = v.g;
+    out.b = v.b;
+    out.a = v.a;
+    out.u = v.u;
+    out.v = v.v;
+    return out;
+}
+
+static ClipVertex lerpClip(const ClipVertex& a, const ClipVertex& b, float t) {
+    const float* pa = &a.x;
+    const float* pb = &b.x;
+    ClipVertex out;
+    float* po = &out.x;
+    for (int i = 0; i < 10; i++) po[i] = pa[i] + (pb[i] - pa[i]) * t;
+    return out;
+}
+
+// Distance inside the near (side 1) or far (side -1) plane
+static float planeDistance(const ClipVertex& v, float side) {
+    return v.w + side * v.z;
+}
+
+// One Sutherland-Hodgman pass; a triangle clipped by two planes has at
+// most five corners
+static int clipPolygon(const ClipVertex* in, int count, float side, ClipVertex* out) {
+    int produced = 0;
+    for (int i = 0; i < count; i++) {
+        const ClipVertex& a = in[i];
+        const ClipVertex& b = in[(i + 1) % count];
+        float da = planeDistance(a, side), db = planeDistance(b, side);
+        if (da >= 0) out[produced++] = a;
+        if ((da >= 0) != (db >= 0)) out[produced++] = lerpClip(a, b, da / (da - db));
+    }
+    return produced;
+}
+
+static void softwareTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, int flags, int texture,
+                             const int scissor[4]) {
+    // Wholly outside one side of the view volume
+    for (int axis = 0; axis < 3; axis++) {
+        float pa = (&a.x)[axis], pb = (&b.x)[axis], pc = (&c.x)[axis];
+        if (pa > a.w && pb > b.w && pc > c.w) return;
+        if (pa < -a.w && pb < -b.w && pc < -c.w) return;
+    }
+
+    bool inside = planeDistance(a, 1) >= 0 && planeDistance(b, 1) >= 0 && planeDistance(c, 1) >= 0 &&
+                  planeDistance(a, -1) >= 0 && planeDistance(b, -1) >= 0 && planeDistance(c, -1) >= 0;
+    if (inside) {
+        rasterTriangle(softRaster, toWindow(a), toWindow(b), toWindow(c), flags, texture, scissor);
+        return;
+    }
+
+    ClipVertex corners[3] = {a, b, c}, nearClipped[4], clipped[5];
+    int count = clipPolygon(corners, 3, 1, nearClipped);
+    count = clipPolygon(nearClipped, count, -1, clipped);
+    if (count < 3) return;
+    RasterVertex first = toWindow(clipped[0]);
+    for (int i = 1; i + 1 < count; i++) {
+        rasterTriangle(softRaster, first, toWindow(clipped[i]), toWindow(clipped[i + 1]), flags, texture, scissor);
+    }
+}
+
+// A screen-aligned rectangle from two corners' worth of attributes, for
+// points and wide lines
+static void softwareQuad(const RasterVertex corners[4], int flags, const int scissor[4]) {
+    rasterTriangle(softRaster, corners[0], corners[1], corners[2], flags, -1, scissor);
+    rasterTriangle(softRaster, corners[0], corners[2], corners[3], flags, -1, scissor);
+}
+
+// Aliased points are squares of the rounded point size
+static void softwarePoint(const ClipVertex& v, int flags, const int scissor[4]) {
+    if (planeDistance(v, 1) < 0 || planeDistance(v, -1) < 0) return;
+    RasterVertex centre = toWindow(v);
+    float half = std::max(1.0f, floorf(currentPointSize + 0.5f)) * 0.5f;
+    const float offsets[4][2] = {{-half, -half}, {half, -half}, {half, half}, {-half, half}};
+    RasterVertex corners[4];
+    for (int i = 0; i < 4; i++) {
+        corners[i] = centre;
+        corners[i].x += offsets[i][0];
+        corners[i].y += offsets[i][1];
+    }
+    softwareQuad(corners, flags, scissor);
+}
+
+static void softwareLine(ClipVertex a, ClipVertex b, int flags, const int scissor[4]) {
+    for (float side = 1; side >= -1; side -= 2) {
+        float da = planeDistance(a, side), db = planeDistance(b, side);
+        if (da < 0 && db < 0) return;
+        if (da < 0) a = lerpClip(a, b, da / (da - db));
+        else if (db < 0) b = lerpClip(b, a, db / (db - da));
+    }
+
+    RasterVertex ends[2] = {toWindow(a), toWindow(b)};
+    float dx = ends[1].x - ends[0].x, dy = ends[1].y - ends[0].y;
+    float length = sqrt(dx * dx + dy * dy);
+    if (length == 0) return;
+    float half = std::max(1.0f, floorf(currentLineWidth + 0.5f)) * 0.5f;
+    float ox = -dy / length * half, oy = dx / length * half;
+
+    RasterVertex corners[4] = {ends[0], ends[1], ends[1], ends[0]};
+    corners[0].x -= ox; corners[0].y -= oy;
+    corners[1].x -= ox; corners[1].y -= oy;
+    corners[2].x += ox; corners[2].y += oy;
+    corners[3].x += ox; corners[3].y += oy;
+    softwareQuad(corners, flags, scissor);
+}
+
+// The game draws triangles, points and lines; other modes are ignored
+static void softwareDraw(GLenum mode, int count, int texture) {
+    int flags = softwareFlags();
+    if (texture >= 0) flags |= RASTER_ALPHA_CUTOUT;
+    int scissor[4];
+    softwareScissor(scissor);
+    const ClipVertex* v = &clipVertices[0];
+
+    if (mode == GL_TRIANGLES) {
+        for (int i = 0; i + 2 < count; i += 3) softwareTriangle(v[i], v[i + 1], v[i + 2], flags, texture, scissor);
+    } else if (mode == GL_POINTS) {
+        for (int i = 0; i < count; i++) softwarePoint(v[i], flags, scissor);
+    } else if (mode == GL_LINES) {
+        for (int i = 0; i + 1 < count; i += 2) softwareLine(v[i], v[i + 1], flags, scissor);
+    }
+}
+
+static void softwareDrawStream(GLenum mode, const MeshVertex* vertices, int count) {
+    if (count <= 0) return;
+    softwareDraw(mode, softwareTransform(mode, vertices, count, 1.0f, 0), -1);
+}
+
+// Client-side vertex arrays on the legacy backend
+static void legacyDrawArrays(GLenum mode, const MeshVertex* vertices, int count) {
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), &vertices->x);
+    glNormalPointer(GL_FLOAT, sizeof(MeshVertex), &vertices->nx);
+    glColorPointer(4, GL_FLOAT, sizeof(MeshVertex), &vertices->r);
+
+    glDrawArrays(mode, 0, count);
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glColor4fv(currentColor);
+}
+
+static void drawCachedMesh(int kind, float paramA, float paramB, int paramC, int paramD, float scale) {
+    const ShaderMesh& mesh = findShaderMesh(kind, paramA, paramB, paramC, paramD);
+    if (backend == RENDER_SHADER) {
+        shaderDrawMesh(mesh, scale);
+        return;
+    }
+    softwareDraw(GL_TRIANGLES, softwareTransform(GL_TRIANGLES, &mesh.vertices[0], mesh.count, scale, currentColor), -1);
+}
+
+// Immediate mode
+void rBegin(GLenum mode) {
+    if (backend == RENDER_LEGACY) {
+        glBegin(mode);
+        return;
+    }
+    immediateMode = mode;
+    immediateVertices.clear();
+}
+
+void rVertex3f(float x, float y, float z) {
+    if (backend == RENDER_LEGACY) {
+        glVertex3f(x, y, z);
+        return;
+    }
+    // GL's default current normal is (0, 0, 1)
+    if (backend == RENDER_SOFTWARE && immediateVertices.size() == (size_t)MAX_STREAM_VERTICES) {
+        droppedVertices++;
+        return;
+    }
+    MeshVertex v = {x, y, z, 0.0f, 0.0f, 1.0f,
+                    currentColor[0], currentColor[1], currentColor[2], currentColor[3]};
+    immediateVertices.push_back(v);
+}
+
+void rEnd() {
+    if (backend == RENDER_LEGACY) {
+        glEnd();
+        return;
+    }
+
+    if (immediateMode == GL_QUADS) {
+        // Core profile has no quads; split each into two triangles in place
+        size_t quads = immediateVertices.size() / 4;
+        if (backend == RENDER_SOFTWARE && quads > (size_t)MAX_STREAM_VERTICES / 6) {
+            droppedVertices += (quads - MAX_STREAM_VERTICES / 6) * 4;
+            quads = MAX_STREAM_VERTICES / 6;
+        }
+        immediateVertices.resize(quads * 6);
+        for (size_t q = quads; q-- > 0;) {
+            MeshVertex v0 = immediateVertices[q * 4];
+            MeshVertex v1 = immediateVertices[q * 4 + 1];
+            MeshVertex v2 = immediateVertices[q * 4 + 2];
+            MeshVertex v3 = immediateVertices[q * 4 + 3];
+            MeshVertex* out = &immediateVertices[q * 6];
+            out[0] = v0; out[1] = v1; out[2] = v2;
+            out[3] = v0; out[4] = v2; out[5] = v3;
+        }
+        immediateMode = GL_TRIANGLES;
+    }
+
+    if (immediateVertices.empty()) return;
+    if (backend == RENDER_SOFTWARE) {
+        softwareDrawStream(immediateMode, &immediateVertices[0], immediateVertices.size());
+    } else {
+        shaderDrawStream(immediateMode, &immediateVertices[0], immediateVertices.size());
+    }
+}
+
+// GLUT shapes
+void rSetTessellation(int percent) {
+    tessellationPercent = percent;
+}
+
+// Never drops below minimum, and never goes above what was asked for
+int rTessellate(int segments, int minimum) {
+    int scaled = segments * tessellationPercent / 100;
+    if (scaled < minimum) scaled = minimum;
+    return scaled < segments ? scaled : segments;
+}
+
+void rSolidSphere(float radius, int slices, int stacks) {
+    slices = rTessellate(slices, 4);
+    stacks = rTessellate(stacks, 3);
+    if (backend == RENDER_LEGACY) {
+        glutSolidSphere(radius, slices, stacks);
+        return;
+    }
+    drawCachedMesh(SHADER_MESH_SPHERE, 0, 0, slices, stacks, radius);
+}
+
+void rSolidCube(float size) {
+    if (backend == RENDER_LEGACY) {
+        glutSolidCube(size);
+        return;
+    }
+    drawCachedMesh(SHADER_MESH_CUBE, 0, 0, 0, 0, size);
+}
+
+void rSolidTorus(float innerRadius, float outerRadius, int sides, int rings) {
+    sides = rTessellate(sides, 4);
+    rings = rTessellate(rings, 6);
+    if (backend == RENDER_LEGACY) {
+        glutSolidTorus(innerRadius, outerRadius, sides, rings);
+        return;
+    }
+    drawCachedMesh(SHADER_MESH_TORUS, innerRadius, outerRadius, sides, rings, 1.0f);
+}
+
+// Pre-baked vertex arrays with per-vertex colour
+void rDrawVertices(GLenum mode, const MeshVertex* vertices, int count) {
+    if (count <= 0) return;
+    if (backend == RENDER_SHADER) {
+        shaderDrawStream(mode, vertices, count);
+        return;
+    }
+    if (backend == RENDER_SOFTWARE) {
+        softwareDrawStream(mode, vertices, count);
+        return;
+    }
+
+    legacyDrawArrays(mode, vertices, count);
+}
+
+// Stored meshes and instancing
+int rStoreMesh(int mesh, const MeshVertex* vertices, int count) {
+    if (mesh == 0) {
+        StoredMesh created;
+        created.vao = created.vbo = 0;
+        if (shaderAvailable) {
+            gl3.GenVertexArrays(1, &created.vao);
+            gl3.GenBuffers(1, &created.vbo);
+            gl3.BindVertexArray(created.vao);
+            gl3.BindBuffer(GL_ARRAY_BUFFER, created.vbo);
+            setVertexLayout(true);
+
+            // A column of the instance's matrix per attribute, then its scale
+            gl3.BindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+            for (int c = 0; c < 4; c++) {
+                gl3.EnableVertexAttribArray(3 + c);
+                gl3.VertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (const void*)(c * 4 * sizeof(float)));
+                gl3.VertexAttribDivisor(3 + c, 1);
+            }
+            gl3.EnableVertexAttribArray(7);
+            gl3.VertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (const void*)(16 * sizeof(float)));
+            gl3.VertexAttribDivisor(7, 1);
+            gl3.BindVertexArray(0);
+            gl3.BindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        storedMeshes.push_back(created);
+        mesh = (int)storedMeshes.size();
+    }
+
+    StoredMesh& stored = storedMeshes[mesh - 1];
+    stored.vertices.assign(vertices, vertices + count);
+    if (stored.vbo) {
+        gl3.BindBuffer(GL_ARRAY_BUFFER, stored.vbo);
+        gl3.BufferData(GL_ARRAY_BUFFER, count * sizeof(MeshVertex), vertices, GL_STATIC_DRAW);
+        gl3.BindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    return mesh;
+}
+
+void rDrawInstances(int mesh, const MeshInstance* instances, int count) {
+    if (mesh <= 0 || count <= 0) return;
+    const StoredMesh& stored = storedMeshes[mesh - 1];
+    int vertexCount = (int)stored.vertices.size();
+    if (vertexCount == 0) return;
+
+    if (backend == RENDER_SHADER) {
+        shaderPrepareDraw(1.0f, 1.0f, 1.0f);
+        gl3.BindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        gl3.BufferData(GL_ARRAY_BUFFER, count * sizeof(MeshInstance), instances, GL_STREAM_DRAW);
+        gl3.BindVertexArray(stored.vao);
+        gl3.DrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, count);
+        return;
+    }
+
+    Mat4 view = modelViewStack.back();
+    for (int i = 0; i < count; i++) {
+        const MeshInstance& instance = instances[i];
+        modelViewStack.back() = mat4Multiply(view, instance.model);
+        if (backend == RENDER_SOFTWARE) {
+            softwareDraw(GL_TRIANGLES, softwareTransform(GL_TRIANGLES, &stored.vertices[0], vertexCount, instance.scale, 0), -1);
+            continue;
+        }
+
+        // Fixed-function would scale the normals along with a glScalef
+        const MeshVertex* vertices = &stored.vertices[0];
+        if (instance.scale != 1.0f) {
+            scaledVertices.assign(stored.vertices.begin(), stored.vertices.end());
+            for (int k = 0; k < vertexCount; k++) {
+                scaledVertices[k].x *= instance.scale;
+                scaledVertices[k].y *= instance.scale;
+                scaledVertices[k].z *= instance.scale;
+            }
+            vertices = &scaledVertices[0];
+        }
+        glLoadMatrixf(modelViewStack.back().m);
+        legacyDrawArrays(GL_TRIANGLES, vertices, vertexCount);
+    }
+    modelViewStack.back() = view;
+    if (backend == RENDER_LEGACY) glLoadMatrixf(view.m);
+}
+
+// Textures and sprites
+// Software textures are numbered from 1, so 0 still means none
+GLuint rCreateTexture(int width, int height, const unsigned char* rgba) {
+    if (backend == RENDER_SOFTWARE) return createRasterTexture(softRaster, width, height, rgba) + 1;
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+void rDrawSprites(GLuint texture, const SpriteVertex* vertices, int count) {
+    if (count <= 0) return;
+
+    if (backend == RENDER_SOFTWARE) {
+        if (texture == 0) return;
+        // Unlit and tinted: the current colour, with the texture coordinates
+        // carried through the transform in place of a normal
+        bool lighting = lightingEnabled;
+        lightingEnabled = false;
+        if (count > MAX_STREAM_VERTICES) {
+            droppedVertices += count - MAX_STREAM_VERTICES;
+            count = MAX_STREAM_VERTICES;
+        }
+        immediateVertices.clear();
+        for (int i = 0; i < count; i++) {
+            const SpriteVertex& s = vertices[i];
+            MeshVertex v = {s.x, s.y, s.z, 0.0f, 0.0f, 1.0f,
+                            currentColor[0], currentColor[1], currentColor[2], currentColor[3]};
+            immediateVertices.push_back(v);
+        }
+        count = softwareTransform(GL_TRIANGLES, &immediateVertices[0], count, 1.0f, 0);
+        for (int i = 0; i < count; i++) {
+            clipVertices[i].u = vertices[i].u;
+            clipVertices[i].v = vertices[i].v;
+        }
+        softwareDraw(GL_TRIANGLES, count, texture - 1);
+        lightingEnabled = lighting;
+        return;
+    }
+
+    if (backend == RENDER_SHADER) {
+        gl3.UseProgram(spriteProgram);
+        programBound = false;
+        gl3.UniformMatrix4fv(uSpriteProjection, 1, GL_FALSE, projectionStack.back().m);
+        gl3.UniformMatrix4fv(uSpriteModelView, 1, GL_FALSE, modelViewStack.back().m);
+        gl3.Uniform4fv(uSpriteColor, 1, currentColor);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        gl3.BindVertexArray(spriteVao);
+        gl3.BindBuffer(GL_ARRAY_BUFFER, spriteVbo);
+        gl3.BufferData(GL_ARRAY_BUFFER, count * sizeof(SpriteVertex), vertices, GL_STREAM_DRAW);
+        glDrawArrays(GL_TRIANGLES, 0, count);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0.5f);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(SpriteVertex), &vertices->x);
+    glTexCoordPointer(2, GL_FLOAT, sizeof(SpriteVertex), &vertices->u);
+    glDrawArrays(GL_TRIANGLES, 0, count);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_ALPHA_TEST);
+    glDisable(GL_TEXTURE_2D);
+    if (lightingEnabled) glEnable(GL_LIGHTING);
+}
+
+GLuint rCaptureFrame(GLuint texture, int width, int height) {
+    if (backend == RENDER_SOFTWARE) {
+        if (texture == 0) {
+            texture = createRasterTexture(softRaster, 0, 0, 0) + 1;
+        }
+        copyRasterTarget(softRaster, texture - 1, width, height);
+        return texture;
+    }
+
+    if (texture == 0) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 0, 0, width, height, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+void rDrawFullscreen(GLuint texture) {
+    // Copied or stretched straight into the target without rasterizing
+    if (backend == RENDER_SOFTWARE && texture != 0 && viewport[0] == 0 && viewport[1] == 0) {
+        rasterBlit(softRaster, texture - 1, viewport[2], viewport[3]);
+        return;
+    }
+
+    static const SpriteVertex quad[6] = {
+        {-1.0f, -1.0f, 0.0f, 0.0f, 0.0f}, {1.0f, -1.0f, 0.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 1.0f, 1.0f},
+        {-1.0f, -1.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f, 1.0f, 1.0f}, {-1.0f, 1.0f, 0.0f, 0.0f, 1.0f}
+    };
+    GLenum mode = matrixMode;
+    rMatrixMode(GL_PROJECTION);
+    rPushMatrix();
+    rLoadIdentity();
+    rMatrixMode(GL_MODELVIEW);
+    rPushMatrix();
+    rLoadIdentity();
+
+    bool depthTest = depthTestEnabled;
+    float color[4] = {currentColor[0], currentColor[1], currentColor[2], currentColor[3]};
+    rDisable(GL_DEPTH_TEST);
+    rColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    rDrawSprites(texture, quad, 6);
+    rColor4f(color[0], color[1], color[2], color[3]);
+    if (depthTest) rEnable(GL_DEPTH_TEST);
+
+    rPopMatrix();
+    rMatrixMode(GL_PROJECTION);
+    rPopMatrix();
+    rMatrixMode(mode);
+}
+
+// Offscreen target
+bool rBeginOffscreen(int width, int height) {
+    if (backend == RENDER_SOFTWARE) {
+        if (width != offscreenTarget.width || height != offscreenTarget.height) {
+            setRasterTarget(softRaster, &windowTarget);
+            resizeRasterTarget(offscreenTarget, width, height);
+            reserveRasterQueue(softRaster, offscreenTarget);
+        }
+        setRasterTarget(softRaster, &offscreenTarget);
+        rViewport(0, 0, width, height);
+        return true;
+    }
+    if (!shaderAvailable) {
+        glViewport(0, 0, width, height);
+        return false;
+    }
+
+    if (!offscreenFbo || width != offscreenWidth || height != offscreenHeight) {
+        if (!offscreenFbo) {
+            gl3.GenFramebuffers(1, &offscreenFbo);
+            gl3.GenRenderbuffers(1, &offscreenColor);
+            gl3.GenRenderbuffers(1, &offscreenDepth);
+        }
+        gl3.BindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+        gl3.RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        gl3.BindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+        gl3.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        gl3.BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        gl3.BindFramebuffer(GL_FRAMEBUFFER, offscreenFbo);
+        gl3.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+        gl3.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+        offscreenWidth = width;
+        offscreenHeight = height;
+    }
+
+    gl3.BindFramebuffer(GL_FRAMEBUFFER, offscreenFbo);
+    if (gl3.CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        gl3.BindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+void rEndOffscreen() {
+    if (backend == RENDER_SOFTWARE) setRasterTarget(softRaster, &windowTarget);
+    else if (shaderAvailable) gl3.BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Bitmap fonts only exist on the fixed-function raster path, so text is drawn
+// there in both GL backends with the program unbound. The software backend
+// draws its own fixed-width font, with the baseline at the same place.
+void rBitmapText(float x, float y, int windowWidth, int windowHeight, const char* text) {
+    if (backend == RENDER_SOFTWARE) {
+        int scissor[4];
+        softwareScissor(scissor);
+        int px = (int)floorf(viewport[0] + x * viewport[2] / windowWidth);
+        int py = (int)floorf(viewport[1] + y * viewport[3] / windowHeight) - SOFTWARE_FONT_BASELINE;
+        int flags = blendEnabled ? RASTER_BLEND : 0;
+        for (const char* c = text; *c != '\0'; c++, px += SOFTWARE_FONT_WIDTH) {
+            rasterGlyph(softRaster, px, py, *c, currentColor, flags, scissor);
+        }
+        rEnable(GL_DEPTH_TEST);
+        rEnable(GL_LIGHTING);
+        return;
+    }
+
+    if (programBound) {
+        gl3.UseProgram(0);
+        gl3.BindVertexArray(0);
+        programBound = false;
+    }
+    glColor4fv(currentColor);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, windowWidth, 0, windowHeight);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+
+    glRasterPos2f(x, y);
+    for (const char* c = text; *c != '\0'; c++) {
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+    }
+
+    rEnable(GL_DEPTH_TEST);
+    rEnable(GL_LIGHTING);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
@@ -0,0 +1,162 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <GL/glut.h>
+#include <vector>
+
+// Rendering backends selectable at runtime
+enum RenderBackend {
+    RENDER_LEGACY = 0,   // fixed-function OpenGL 1.x, immediate mode and GLUT shapes
+    RENDER_SHADER,       // GLSL 330 core program with buffer-backed meshes
+    RENDER_SOFTWARE      // tile-based CPU rasterizer into a memory framebuffer, no GL at all
+};
+
+// Column-major 4x4 matrix, same layout as OpenGL
+struct Mat4 {
+    float m[16];
+};
+
+// Interleaved vertex for baked meshes (position, normal, colour)
+struct MeshVertex {
+    float x, y, z;
+    float nx, ny, nz;
+    float r, g, b, a;
+};
+
+// Textured quad corner for sprites and impostors
+struct SpriteVertex {
+    float x, y, z;
+    float u, v;
+};
+
+// One placement of a stored mesh. Its vertices are scaled by scale, but not
+// its normals, like the size of a GLUT shape; model then places it on top
+// of the current modelview.
+struct MeshInstance {
+    Mat4 model;
+    float scale;
+};
+
+// Modelling transform used while baking meshes. The normal matrix is kept
+// unnormalized so baked lighting matches fixed-function without GL_NORMALIZE.
+struct BakeTransform {
+    Mat4 model;
+    Mat4 normal;
+};
+
+// Matrix helpers
+Mat4 mat4Identity();
+Mat4 mat4Multiply(const Mat4& a, const Mat4& b);
+Mat4 mat4Translate(float x, float y, float z);
+Mat4 mat4Rotate(float angle, float x, float y, float z);
+Mat4 mat4Scale(float x, float y, float z);
+Mat4 mat4Ortho(float left, float right, float bottom, float top, float zNear, float zFar);
+
+// Mesh baking
+void bakeReset(BakeTransform& xf);
+void bakeTranslate(BakeTransform& xf, float x, float y, float z);
+void bakeRotate(BakeTransform& xf, float angle, float x, float y, float z);
+void bakeScale(BakeTransform& xf, float x, float y, float z);
+void bakeCube(std::vector<MeshVertex>& out, const BakeTransform& xf, float size, const float color[4]);
+void bakeSphere(std::vector<MeshVertex>& out, const BakeTransform& xf, float radius, int slices, int stacks, const float color[4]);
+void bakeTorus(std::vector<MeshVertex>& out, const BakeTransform& xf, float innerRadius, float outerRadius, int sides, int rings, const float color[4]);
+
+// Backend control. rInit() needs a current GL context.
+void rInit();
+bool rShaderBackendAvailable();
+void rSetBackend(int backend);
+int rGetBackend();
+const char* rBackendName(int backend);
+
+// Software backend: selects it with a memory framebuffer of the given size
+// in place of a window. Nothing touches GL afterwards, so this is called
+// instead of creating a window, and before rInit().
+void rInitSoftware(int width, int height);
+void rSetRasterThreads(int threads);
+void rStopRasterThreads();
+void rReportRasterStats(unsigned frames);
+
+// Framebuffer. The software backend only blends with GL_SRC_ALPHA,
+// GL_ONE_MINUS_SRC_ALPHA; rPresent() swaps the window's buffers, or just
+// completes the memory framebuffer.
+void rClearColor(float r, float g, float b, float a);
+void rClear(GLbitfield mask);
+void rViewport(int x, int y, int width, int height);
+void rBlendFunc(GLenum source, GLenum destination);
+void rReadPixels(int x, int y, int width, int height, unsigned char* rgb);   // tightly packed GL_RGB
+void rFinish();
+void rPresent();
+
+// Fixed-function style interface shared by all backends. Matrices are
+// always tracked on the CPU; the legacy backend also forwards every call.
+void rMatrixMode(GLenum mode);
+void rLoadIdentity();
+void rLoadMatrix(const Mat4& matrix);
+void rPushMatrix();
+void rPopMatrix();
+void rTranslatef(float x, float y, float z);
+void rRotatef(float angle, float x, float y, float z);
+void rScalef(float x, float y, float z);
+void rLookAt(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ,
+             float upX, float upY, float upZ);
+void rPerspective(float fovY, float aspect, float zNear, float zFar);
+const Mat4& rModelView();
+
+void rEnable(GLenum cap);
+void rDisable(GLenum cap);
+void rColor3f(float r, float g, float b);
+void rColor4f(float r, float g, float b, float a);
+void rPointSize(float size);
+void rLineWidth(float width);
+void rLight(const float ambient[4], const float diffuse[4], const float position[4]);
+
+void rBegin(GLenum mode);
+void rVertex3f(float x, float y, float z);
+void rEnd();
+
+// Scales the segment counts of GLUT spheres and tori (100 = as requested)
+void rSetTessellation(int percent);
+
+// Segments a shape that asks for this many gets at the current
+// tessellation, and never fewer than minimum
+int rTessellate(int segments, int minimum);
+
+void rSolidSphere(float radius, int slices, int stacks);
+void rSolidCube(float size);
+void rSolidTorus(float innerRadius, float outerRadius, int sides, int rings);
+void rDrawVertices(GLenum mode, const MeshVertex* vertices, int count);
+
+// Triangles with per-vertex colour kept by the renderer, in a vertex buffer
+// on the shader backend. Replaces the vertices of mesh, which is created
+// when 0. Returns the mesh.
+int rStoreMesh(int mesh, const MeshVertex* vertices, int count);
+
+// Draw a stored mesh once per instance: a single instanced draw call on the
+// shader backend, a loop over the instances on the others
+void rDrawInstances(int mesh, const MeshInstance* instances, int count);
+
+// RGBA8 texture, linear filtered and clamped
+GLuint rCreateTexture(int width, int height, const unsigned char* rgba);
+
+// Unlit textured triangles tinted by the current colour; texels below half
+// alpha are cut out, so sprites need no sorting
+void rDrawSprites(GLuint texture, const SpriteVertex* vertices, int count);
+
+// Copy the colour buffer's bottom-left width x height pixels into texture,
+// which is created when 0. Returns the texture.
+GLuint rCaptureFrame(GLuint texture, int width, int height);
+
+// Draw a texture over the whole viewport, unlit and without depth testing,
+// e.g. a frame kept by rCaptureFrame()
+void rDrawFullscreen(GLuint texture);
+
+// Render into an offscreen colour + depth target of the given size until
+// rEndOffscreen(). Without framebuffer objects this falls back to the back
+// buffer and returns false.
+bool rBeginOffscreen(int width, int height);
+void rEndOffscreen();
+
+// Bitmap text at window coordinates, drawn in the current colour
+void rBitmapText(float x, float y, int windowWidth, int windowHeight, const char* text);
+
+#endif
@@ -0,0 +1,179 @@
+#include "snapshot.h"
+
+static void writeCount(Snapshot& out, size_t n) {
+    while (n >= 0x80) {
+        out.push_back((unsigned char)(n | 0x80));
+        n >>= 7;
+    }
+    out.push_back((unsigned char)n);
+}
+
+static size_t readCount(const Snapshot& in, size_t& at) {
+    size_t n = 0;
+    int shift = 0;
+    while (in[at] & 0x80) {
+        n |= (size_t)(in[at++] & 0x7f) << shift;
+        shift += 7;
+    }
+    n |= (size_t)in[at++] << shift;
+    return n;
+}
+
+static inline unsigned char baseByte(const Snapshot& base, size_t i) {
+    return i < base.size() ? base[i] : 0;
+}
+
+// Header is the length of the new snapshot, then (unchanged run, changed
+// run, XORed bytes of the changed run) until the end
+void encodeDelta(const Snapshot& base, const Snapshot& current, Snapshot& delta) {
+    delta.clear();
+    size_t size = current.size();
+    writeCount(delta, size);
+
+    size_t overlap = base.size() < size ? base.size() : size;
+    size_t i = 0;
+    while (i < size) {
+        // Skip unchanged bytes a word at a time where both snapshots overlap
+        size_t same = i;
+        while (same + 8 <= overlap && memcmp(&current[same], &base[same], 8) == 0) same += 8;
+        while (same < size && current[same] == baseByte(base, same)) same++;
+        if (same == size) break;
+
+        // A changed run ends at the first two unchanged bytes in a row, so a
+        // single equal byte inside a float does not split the run
+        size_t changed = same;
+        while (changed < size) {
+            if (current[changed] == baseByte(base, changed) &&
+                (changed + 1 == size || current[changed + 1] == baseByte(base, changed + 1))) break;
+            changed++;
+        }
+
+        writeCount(delta, same - i);
+        writeCount(delta, changed - same);
+        for (size_t k = same; k < changed; k++) {
+            delta.push_back(current[k] ^ baseByte(base, k));
+        }
+        i = changed;
+    }
+}
+
+void applyDelta(const Snapshot& base, const Snapshot& delta, Snapshot& current) {
+    size_t at = 0;
+    size_t size = readCount(delta, at);
+
+    current.resize(size);
+    size_t copied = base.size() < size ? base.size() : size;
+    if (copied > 0) memcpy(&current[0], &base[0], copied);
+    if (size > copied) memset(&current[copied], 0, size - copied);
+
+    size_t i = 0;
+    while (at < delta.size()) {
+        i += readCount(delta, at);
+        size_t changed = readCount(delta, at);
+        for (size_t k = 0; k < changed; k++) {
+            current[i++] ^= delta[at++];
+        }
+    }
+}
+
+unsigned long long snapshotHash(const Snapshot& snapshot) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        hash ^= snapshot[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void initRewindBuffer(RewindBuffer& buffer, int capacity, int keyframeInterval) {
+    buffer.frames.assign(capacity, RewindFrame());
+    buffer.keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    clearRewindBuffer(buffer);
+}
+
+// A run of unchanged bytes between changed ones is at least two bytes
+// long, which pays for its count; long runs of changed bytes cost an extra
+// count byte per 128. Add the size header and the first run's counts.
+size_t rewindFrameBytes(size_t stateBytes) {
+    return stateBytes + stateBytes / 64 + 16;
+}
+
+void reserveRewindBuffer(RewindBuffer& buffer, size_t stateBytes) {
+    size_t bytes = rewindFrameBytes(stateBytes);
+    for (size_t i = 0; i < buffer.frames.size(); i++) {
+        buffer.frames[i].data.reserve(bytes);
+    }
+}
+
+void clearRewindBuffer(RewindBuffer& buffer) {
+    buffer.newest = -1;
+    buffer.count = 0;
+    buffer.lastKeySlot = -1;
+    buffer.sinceKeyframe = 0;
+}
+
+void pushRewindFrame(RewindBuffer& buffer, const Snapshot& state) {
+    int capacity = (int)buffer.frames.size();
+    if (capacity == 0) return;
+
+    int slot = (buffer.newest + 1) % capacity;
+    RewindFrame& frame = buffer.frames[slot];
+
+    // Overwriting the keyframe we encode against forces a new keyframe
+    if (slot == buffer.lastKeySlot) buffer.lastKeySlot = -1;
+
+    frame.sequence = buffer.nextSequence++;
+    if (buffer.lastKeySlot < 0 || buffer.sinceKeyframe >= buffer.keyframeInterval) {
+        frame.data = state;
+        frame.keyframe = true;
+        frame.keySlot = slot;
+        frame.keySequence = frame.sequence;
+        buffer.lastKeySlot = slot;
+        buffer.sinceKeyframe = 1;
+    } else {
+        const RewindFrame& key = buffer.frames[buffer.lastKeySlot];
+        encodeDelta(key.data, state, frame.data);
+        frame.keyframe = false;
+        frame.keySlot = buffer.lastKeySlot;
+        frame.keySequence = key.sequence;
+        buffer.sinceKeyframe++;
+    }
+
+    buffer.newest = slot;
+    if (buffer.count < capacity) buffer.count++;
+}
+
+bool popRewindFrame(RewindBuffer& buffer, Snapshot& state) {
+    if (buffer.count == 0) return false;
+
+    int capacity = (int)buffer.frames.size();
+    const RewindFrame& frame = buffer.frames[buffer.newest];
+    const RewindFrame& key = buffer.frames[frame.keySlot];
+    bool valid = frame.keyframe || key.sequence == frame.keySequence;
+
+    if (valid) {
+        if (frame.keyframe) state = frame.data;
+        else applyDelta(key.data, frame.data, state);
+    }
+
+    // Frames pushed after a rewind continue from this point
+    if (frame.keyframe) {
+        buffer.lastKeySlot = -1;
+    } else {
+        buffer.sinceKeyframe--;
+    }
+
+    buffer.newest = (buffer.newest - 1 + capacity) % capacity;
+    buffer.count--;
+    if (!valid) clearRewindBuffer(buffer);
+    return valid;
+}
+
+size_t rewindBufferBytes(const RewindBuffer& buffer) {
+    int capacity = (int)buffer.frames.size();
+    size_t bytes = 0;
+    for (int i = 0; i < buffer.count; i++) {
+        bytes += buffer.frames[(buffer.newest - i + capacity) % capacity].data.size();
+    }
+    return bytes;
+}
@@ -0,0 +1,108 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+// Flat byte image of the game state. Values are copied raw, so snapshots
+// are only meaningful to the build that wrote them.
+typedef std::vector<unsigned char> Snapshot;
+
+// Appends trivially copyable values to a snapshot
+struct SnapshotWriter {
+    Snapshot& out;
+
+    explicit SnapshotWriter(Snapshot& _out) : out(_out) { out.clear(); }
+
+    void bytes(const void* data, size_t size) {
+        size_t at = out.size();
+        out.resize(at + size);
+        if (size > 0) memcpy(&out[at], data, size);
+    }
+
+    template <typename T> void value(const T& v) { bytes(&v, sizeof(T)); }
+
+    // Row count followed by the rows, for any contiguous container
+    template <typename C> void column(const C& rows) {
+        unsigned count = (unsigned)rows.size();
+        value(count);
+        if (count > 0) bytes(&rows[0], count * sizeof(rows[0]));
+    }
+};
+
+// Reads values back in the order they were written
+struct SnapshotReader {
+    const Snapshot& in;
+    size_t at;
+
+    explicit SnapshotReader(const Snapshot& _in) : in(_in), at(0) {}
+
+    void bytes(void* data, size_t size) {
+        if (size > 0) memcpy(data, &in[at], size);
+        at += size;
+    }
+
+    template <typename T> void value(T& v) { bytes(&v, sizeof(T)); }
+
+    template <typename C> void column(C& rows) {
+        unsigned count = 0;
+        value(count);
+        rows.resize(count);
+        if (count > 0) bytes(&rows[0], count * sizeof(rows[0]));
+    }
+};
+
+// Delta against a base snapshot: the XOR of the two, stored as alternating
+// runs of unchanged bytes and literal changed bytes
+void encodeDelta(const Snapshot& base, const Snapshot& current, Snapshot& delta);
+void applyDelta(const Snapshot& base, const Snapshot& delta, Snapshot& current);
+
+// FNV-1a hash of a snapshot, for comparing runs tick by tick
+unsigned long long snapshotHash(const Snapshot& snapshot);
+
+// One tick in the rewind ring. Keyframes hold a full snapshot, every other
+// frame a delta against the most recent keyframe, so restoring any frame
+// decodes at most one delta.
+struct RewindFrame {
+    Snapshot data;
+    bool keyframe;
+    int keySlot;               // slot of the keyframe a delta was encoded against
+    unsigned keySequence;      // sequence number that keyframe had when encoded
+    unsigned sequence;         // increases with every frame pushed
+};
+
+// Fixed-capacity ring of the most recent ticks. Slots keep their buffers
+// between laps, so recording does not allocate once the ring is warm.
+struct RewindBuffer {
+    std::vector<RewindFrame> frames;
+    int keyframeInterval;
+    int newest;                // slot of the newest frame, -1 when empty
+    int count;
+    int lastKeySlot;           // -1 when the next frame must be a keyframe
+    int sinceKeyframe;
+    unsigned nextSequence;
+
+    RewindBuffer() : keyframeInterval(1), newest(-1), count(0), lastKeySlot(-1),
+                     sinceKeyframe(0), nextSequence(0) {}
+};
+
+void initRewindBuffer(RewindBuffer& buffer, int capacity, int keyframeInterval);
+
+// Largest a keyframe or delta of a state of stateBytes can get
+size_t rewindFrameBytes(size_t stateBytes);
+
+// Size every slot for states up to stateBytes, so recording them never
+// allocates, not even on the first lap
+void reserveRewindBuffer(RewindBuffer& buffer, size_t stateBytes);
+void clearRewindBuffer(RewindBuffer& buffer);
+void pushRewindFrame(RewindBuffer& buffer, const Snapshot& state);
+
+// Remove the newest frame and decode it into state. Returns false when the
+// ring is empty or the frame's keyframe has already been overwritten.
+bool popRewindFrame(RewindBuffer& buffer, Snapshot& state);
+
+// Bytes held by the ring, for reporting the compression ratio
+size_t rewindBufferBytes(const RewindBuffer& buffer);
+
+#endif
@@ -0,0 +1,718 @@
+#include "softraster.h"
+#include "software_font.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTRASTER_SSE2 1
+#endif
+
+// Four horizontally adjacent pixels at a time. Masks are all-ones lanes for
+// pixels that are still being drawn.
+#ifdef SOFTRASTER_SSE2
+// __m128 is not a class, so it is wrapped to give it operators
+struct Lanes {
+    __m128 v;
+};
+typedef __m128i PixelLanes;
+
+static inline Lanes wrap(__m128 v) {
+    Lanes r = {v};
+    return r;
+}
+static inline Lanes lanes(float v) { return wrap(_mm_set1_ps(v)); }
+static inline Lanes laneRamp(float start, float step) {
+    return wrap(_mm_set_ps(start + 3 * step, start + 2 * step, start + step, start));
+}
+static inline Lanes operator+(Lanes a, Lanes b) { return wrap(_mm_add_ps(a.v, b.v)); }
+static inline Lanes operator-(Lanes a, Lanes b) { return wrap(_mm_sub_ps(a.v, b.v)); }
+static inline Lanes operator*(Lanes a, Lanes b) { return wrap(_mm_mul_ps(a.v, b.v)); }
+static inline Lanes operator/(Lanes a, Lanes b) { return wrap(_mm_div_ps(a.v, b.v)); }
+static inline Lanes laneClamp01(Lanes a) { return wrap(_mm_min_ps(_mm_max_ps(a.v, _mm_setzero_ps()), _mm_set1_ps(1.0f))); }
+static inline Lanes laneLess(Lanes a, Lanes b) { return wrap(_mm_cmplt_ps(a.v, b.v)); }
+static inline Lanes laneLessEqual(Lanes a, Lanes b) { return wrap(_mm_cmple_ps(a.v, b.v)); }
+static inline Lanes laneAnd(Lanes a, Lanes b) { return wrap(_mm_and_ps(a.v, b.v)); }
+static inline Lanes laneSelect(Lanes mask, Lanes a, Lanes b) {
+    return wrap(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+}
+static inline bool laneAny(Lanes mask) { return _mm_movemask_ps(mask.v) != 0; }
+static inline int laneBits(Lanes mask) { return _mm_movemask_ps(mask.v); }
+static inline Lanes loadLanes(const float* p) { return wrap(_mm_loadu_ps(p)); }
+static inline void storeLanes(float* p, Lanes v) { _mm_storeu_ps(p, v.v); }
+
+// Pixels are RGBA8 with red in the low byte
+static inline PixelLanes packPixels(Lanes r, Lanes g, Lanes b, Lanes a) {
+    __m128 scale = _mm_set1_ps(255.0f);
+    __m128i ri = _mm_cvtps_epi32(_mm_mul_ps(laneClamp01(r).v, scale));
+    __m128i gi = _mm_cvtps_epi32(_mm_mul_ps(laneClamp01(g).v, scale));
+    __m128i bi = _mm_cvtps_epi32(_mm_mul_ps(laneClamp01(b).v, scale));
+    __m128i ai = _mm_cvtps_epi32(_mm_mul_ps(laneClamp01(a).v, scale));
+    return _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(bi, 16), _mm_slli_epi32(ai, 24)));
+}
+
+static inline void unpackPixels(PixelLanes p, Lanes& r, Lanes& g, Lanes& b, Lanes& a) {
+    __m128i byte = _mm_set1_epi32(0xff);
+    __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+    r = wrap(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, byte)), scale));
+    g = wrap(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), byte)), scale));
+    b = wrap(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), byte)), scale));
+    a = wrap(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(p, 24)), scale));
+}
+
+static inline PixelLanes loadPixels(const unsigned* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void storePixels(unsigned* p, PixelLanes source, PixelLanes old, Lanes mask) {
+    __m128i m = _mm_castps_si128(mask.v);
+    _mm_storeu_si128((__m128i*)p, _mm_or_si128(_mm_and_si128(m, source), _mm_andnot_si128(m, old)));
+}
+#else
+struct Lanes {
+    float v[4];
+};
+struct PixelLanes {
+    unsigned v[4];
+};
+
+static inline Lanes lanes(float f) {
+    Lanes r = {{f, f, f, f}};
+    return r;
+}
+static inline Lanes laneRamp(float start, float step) {
+    Lanes r = {{start, start + step, start + 2 * step, start + 3 * step}};
+    return r;
+}
+
+#define LANEWISE(expr) \
+    Lanes r; \
+    for (int i = 0; i < 4; i++) r.v[i] = (expr); \
+    return r;
+
+static inline Lanes operator+(Lanes a, Lanes b) { LANEWISE(a.v[i] + b.v[i]) }
+static inline Lanes operator-(Lanes a, Lanes b) { LANEWISE(a.v[i] - b.v[i]) }
+static inline Lanes operator*(Lanes a, Lanes b) { LANEWISE(a.v[i] * b.v[i]) }
+static inline Lanes operator/(Lanes a, Lanes b) { LANEWISE(a.v[i] / b.v[i]) }
+static inline Lanes laneClamp01(Lanes a) { LANEWISE(std::min(std::max(a.v[i], 0.0f), 1.0f)) }
+// Masks are 1 or 0 here; laneSelect only needs them to be truthy
+static inline Lanes laneLess(Lanes a, Lanes b) { LANEWISE(a.v[i] < b.v[i] ? 1.0f : 0.0f) }
+static inline Lanes laneLessEqual(Lanes a, Lanes b) { LANEWISE(a.v[i] <= b.v[i] ? 1.0f : 0.0f) }
+static inline Lanes laneAnd(Lanes a, Lanes b) { LANEWISE(a.v[i] != 0 && b.v[i] != 0 ? 1.0f : 0.0f) }
+static inline Lanes laneSelect(Lanes mask, Lanes a, Lanes b) { LANEWISE(mask.v[i] != 0 ? a.v[i] : b.v[i]) }
+
+#undef LANEWISE
+
+static inline int laneBits(Lanes mask) {
+    int bits = 0;
+    for (int i = 0; i < 4; i++) {
+        if (mask.v[i] != 0) bits |= 1 << i;
+    }
+    return bits;
+}
+static inline bool laneAny(Lanes mask) { return laneBits(mask) != 0; }
+static inline Lanes loadLanes(const float* p) {
+    Lanes r = {{p[0], p[1], p[2], p[3]}};
+    return r;
+}
+static inline void storeLanes(float* p, Lanes v) {
+    for (int i = 0; i < 4; i++) p[i] = v.v[i];
+}
+
+static inline PixelLanes packPixels(Lanes r, Lanes g, Lanes b, Lanes a) {
+    PixelLanes p;
+    for (int i = 0; i < 4; i++) {
+        unsigned ri = (unsigned)lrintf(std::min(std::max(r.v[i], 0.0f), 1.0f) * 255.0f);
+        unsigned gi = (unsigned)lrintf(std::min(std::max(g.v[i], 0.0f), 1.0f) * 255.0f);
+        unsigned bi = (unsigned)lrintf(std::min(std::max(b.v[i], 0.0f), 1.0f) * 255.0f);
+        unsigned ai = (unsigned)lrintf(std::min(std::max(a.v[i], 0.0f), 1.0f) * 255.0f);
+        p.v[i] = ri | (gi << 8) | (bi << 16) | (ai << 24);
+    }
+    return p;
+}
+
+static inline void unpackPixels(PixelLanes p, Lanes& r, Lanes& g, Lanes& b, Lanes& a) {
+    for (int i = 0; i < 4; i++) {
+        r.v[i] = (p.v[i] & 0xff) / 255.0f;
+        g.v[i] = ((p.v[i] >> 8) & 0xff) / 255.0f;
+        b.v[i] = ((p.v[i] >> 16) & 0xff) / 255.0f;
+        a.v[i] = (p.v[i] >> 24) / 255.0f;
+    }
+}
+
+static inline PixelLanes loadPixels(const unsigned* p) {
+    PixelLanes r = {{p[0], p[1], p[2], p[3]}};
+    return r;
+}
+static inline void storePixels(unsigned* p, PixelLanes source, PixelLanes old, Lanes mask) {
+    for (int i = 0; i < 4; i++) p[i] = mask.v[i] != 0 ? source.v[i] : old.v[i];
+}
+#endif
+
+static unsigned packColor(const float rgba[4]) {
+    unsigned packed = 0;
+    for (int c = 0; c < 4; c++) {
+        float v = std::min(std::max(rgba[c], 0.0f), 1.0f);
+        packed |= (unsigned)lrintf(v * 255.0f) << (c * 8);
+    }
+    return packed;
+}
+
+void resizeRasterTarget(RasterTarget& target, int width, int height) {
+    target.width = width;
+    target.height = height;
+    target.stride = (width + 3) & ~3;
+    target.tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    target.tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    target.color.assign((size_t)target.stride * height, 0);
+    target.depth.assign((size_t)target.stride * height, 1.0f);
+}
+
+void reserveRasterQueue(SoftRaster& raster, const RasterTarget& target) {
+    raster.primitives.reserve(RASTER_MAX_PRIMITIVES);
+    raster.entries.reserve(RASTER_MAX_BIN_ENTRIES);
+    raster.binned.reserve(RASTER_MAX_BIN_ENTRIES);
+    raster.binStart.reserve(target.tilesX * target.tilesY + 1);
+}
+
+void setRasterTarget(SoftRaster& raster, RasterTarget* target) {
+    if (raster.target == target) return;
+    flushRaster(raster);
+    raster.target = target;
+}
+
+void setRasterThreads(SoftRaster& raster, int threads) {
+    raster.threads = std::max(1, std::min(MAX_RASTER_THREADS, threads));
+    for (int i = 0; i < raster.threads - 1; i++) startWorker(raster.workers[i]);
+}
+
+void stopRasterThreads(SoftRaster& raster) {
+    for (int i = 0; i < MAX_RASTER_THREADS - 1; i++) stopWorker(raster.workers[i]);
+}
+
+int createRasterTexture(SoftRaster& raster, int width, int height, const unsigned char* rgba) {
+    raster.textures.push_back(RasterTexture());
+    RasterTexture& texture = raster.textures.back();
+    texture.width = width;
+    texture.height = height;
+    texture.texels.resize((size_t)width * height);
+    for (size_t i = 0; i < texture.texels.size(); i++) {
+        const unsigned char* t = rgba + i * 4;
+        texture.texels[i] = t[0] | (t[1] << 8) | (t[2] << 16) | ((unsigned)t[3] << 24);
+    }
+    return (int)raster.textures.size() - 1;
+}
+
+void rasterClear(SoftRaster& raster, bool color, const float rgba[4], bool depth, float z) {
+    // Whatever was queued has to land before the clear does
+    if (!raster.primitives.empty()) flushRaster(raster);
+    if (color) {
+        raster.clearColorPending = true;
+        raster.clearColor = packColor(rgba);
+    }
+    if (depth) {
+        raster.clearDepthPending = true;
+        raster.clearDepth = z;
+    }
+}
+
+static void binPrimitive(SoftRaster& raster, const RasterPrimitive& p) {
+    RasterTarget& t = *raster.target;
+    int tx0 = p.x0 / RASTER_TILE_SIZE, tx1 = (p.x1 - 1) / RASTER_TILE_SIZE;
+    int ty0 = p.y0 / RASTER_TILE_SIZE, ty1 = (p.y1 - 1) / RASTER_TILE_SIZE;
+    if ((int)raster.primitives.size() == RASTER_MAX_PRIMITIVES ||
+        (int)raster.entries.size() + (tx1 - tx0 + 1) * (ty1 - ty0 + 1) > RASTER_MAX_BIN_ENTRIES) {
+        flushRaster(raster);
+        raster.fullFlushes++;
+    }
+
+    int index = (int)raster.primitives.size();
+    raster.primitives.push_back(p);
+    bool testTiles = p.kind == RASTER_TRIANGLE && tx1 > tx0 && ty1 > ty0;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            if (testTiles) {
+                // Skip tiles wholly outside one edge: the tile corner that
+                // edge likes best is still outside
+                float cx0 = tx * RASTER_TILE_SIZE + 0.5f - p.originX;
+                float cy0 = ty * RASTER_TILE_SIZE + 0.5f - p.originY;
+                float cx1 = cx0 + RASTER_TILE_SIZE - 1, cy1 = cy0 + RASTER_TILE_SIZE - 1;
+                bool outside = false;
+                for (int e = 0; e < 3 && !outside; e++) {
+                    float best = p.edgeA[e] * (p.edgeA[e] > 0 ? cx1 : cx0) + p.edgeB[e] * (p.edgeB[e] > 0 ? cy1 : cy0) + p.edgeC[e];
+                    outside = best < 0;
+                }
+                if (outside) continue;
+            }
+            RasterBinEntry entry = {ty * t.tilesX + tx, index};
+            raster.entries.push_back(entry);
+        }
+    }
+}
+
+// Pixel centres covered by [lo, hi], clamped to [minimum, maximum)
+static int firstPixel(double lo, int minimum) {
+    return lo - 0.5 <= minimum ? minimum : (int)ceil(lo - 0.5);
+}
+static int endPixel(double hi, int maximum) {
+    return hi - 0.5 >= maximum - 1 ? maximum : (int)floor(hi - 0.5) + 1;
+}
+
+void rasterTriangle(SoftRaster& raster, const RasterVertex& a, const RasterVertex& b, const RasterVertex& c,
+                    int flags, int texture, const int scissor[4]) {
+    if (!raster.target) return;
+    const RasterVertex* v[3] = {&a, &b, &c};
+
+    double area = ((double)b.x - a.x) * ((double)c.y - a.y) - ((double)b.y - a.y) * ((double)c.x - a.x);
+    if (area == 0 || !(area == area)) return;
+
+    RasterPrimitive p;
+    p.kind = RASTER_TRIANGLE;
+    p.flags = flags;
+    p.texture = texture;
+    p.x0 = firstPixel(std::min(a.x, std::min(b.x, c.x)), scissor[0]);
+    p.y0 = firstPixel(std::min(a.y, std::min(b.y, c.y)), scissor[1]);
+    p.x1 = endPixel(std::max(a.x, std::max(b.x, c.x)), scissor[2]);
+    p.y1 = endPixel(std::max(a.y, std::max(b.y, c.y)), scissor[3]);
+    if (p.x0 >= p.x1 || p.y0 >= p.y1) return;
+    p.originX = a.x;
+    p.originY = a.y;
+
+    // Edge i faces vertex i and is scaled so it equals vertex i's
+    // barycentric weight; the sign flip makes the inside positive for
+    // either winding, since nothing is culled
+    double scale = 1.0 / area;
+    p.topLeft = 0;
+    for (int i = 0; i < 3; i++) {
+        const RasterVertex& from = *v[(i + 1) % 3];
+        const RasterVertex& to = *v[(i + 2) % 3];
+        double A = -((double)to.y - from.y) * scale;
+        double B = ((double)to.x - from.x) * scale;
+        double C = A * ((double)a.x - from.x) + B * ((double)a.y - from.y);
+        p.edgeA[i] = (float)A;
+        p.edgeB[i] = (float)B;
+        p.edgeC[i] = (float)C;
+        if (A > 0 || (A == 0 && B < 0)) p.topLeft |= 1 << i;
+    }
+
+    float values[3][RASTER_PLANES];
+    for (int i = 0; i < 3; i++) {
+        const RasterVertex& vi = *v[i];
+        values[i][RASTER_Z] = vi.z;
+        values[i][RASTER_INV_W] = vi.invW;
+        const float attributes[6] = {vi.r, vi.g, vi.b, vi.a, vi.u, vi.v};
+        for (int k = 0; k < 6; k++) values[i][2 + k] = attributes[k] * vi.invW;
+    }
+    for (int k = 0; k < RASTER_PLANES; k++) {
+        RasterPlane& plane = p.planes[k];
+        plane.base = values[0][k];
+        plane.dx = p.edgeA[0] * values[0][k] + p.edgeA[1] * values[1][k] + p.edgeA[2] * values[2][k];
+        plane.dy = p.edgeB[0] * values[0][k] + p.edgeB[1] * values[1][k] + p.edgeB[2] * values[2][k];
+    }
+
+    binPrimitive(raster, p);
+    raster.triangles++;
+}
+
+void rasterGlyph(SoftRaster& raster, int x, int y, char c, const float color[4], int flags, const int scissor[4]) {
+    if (!raster.target) return;
+    int glyph = (unsigned char)c - SOFTWARE_FONT_FIRST;
+    if (glyph <= 0 || glyph >= SOFTWARE_FONT_GLYPHS) return;    // blanks and anything unprintable
+
+    RasterPrimitive p;
+    p.kind = RASTER_GLYPH;
+    p.flags = flags;
+    p.texture = -1;
+    p.originX = (float)x;
+    p.originY = (float)y;
+    p.x0 = std::max(x, scissor[0]);
+    p.y0 = std::max(y, scissor[1]);
+    p.x1 = std::min(x + SOFTWARE_FONT_WIDTH, scissor[2]);
+    p.y1 = std::min(y + SOFTWARE_FONT_HEIGHT, scissor[3]);
+    if (p.x0 >= p.x1 || p.y0 >= p.y1) return;
+    p.glyph = glyph;
+    for (int i = 0; i < 4; i++) p.color[i] = color[i];
+
+    binPrimitive(raster, p);
+    raster.glyphs++;
+}
+
+void rasterBlit(SoftRaster& raster, int texture, int width, int height) {
+    if (!raster.target) return;
+    const RasterTexture& in = raster.textures[texture];
+    if (in.width <= 0 || in.height <= 0) return;
+
+    RasterPrimitive p;
+    p.kind = RASTER_BLIT;
+    p.flags = 0;
+    p.texture = texture;
+    p.originX = 0;
+    p.originY = 0;
+    p.x0 = 0;
+    p.y0 = 0;
+    p.x1 = std::min(width, raster.target->width);
+    p.y1 = std::min(height, raster.target->height);
+    if (p.x1 <= 0 || p.y1 <= 0) return;
+    binPrimitive(raster, p);
+}
+
+// GL_LINEAR with GL_CLAMP_TO_EDGE
+static void sampleTexture(const RasterTexture& texture, float u, float v, float out[4]) {
+    float fx = u * texture.width - 0.5f;
+    float fy = v * texture.height - 0.5f;
+    float flx = floorf(fx), fly = floorf(fy);
+    float wx = fx - flx, wy = fy - fly;
+    int x0 = std::max(0, std::min(texture.width - 1, (int)flx));
+    int x1 = std::max(0, std::min(texture.width - 1, (int)flx + 1));
+    int y0 = std::max(0, std::min(texture.height - 1, (int)fly));
+    int y1 = std::max(0, std::min(texture.height - 1, (int)fly + 1));
+    unsigned t00 = texture.texels[y0 * texture.width + x0], t10 = texture.texels[y0 * texture.width + x1];
+    unsigned t01 = texture.texels[y1 * texture.width + x0], t11 = texture.texels[y1 * texture.width + x1];
+    for (int c = 0; c < 4; c++) {
+        int s = c * 8;
+        float bottom = ((t00 >> s) & 0xff) * (1 - wx) + ((t10 >> s) & 0xff) * wx;
+        float top = ((t01 >> s) & 0xff) * (1 - wx) + ((t11 >> s) & 0xff) * wx;
+        out[c] = (bottom * (1 - wy) + top * wy) / 255.0f;
+    }
+}
+
+static Lanes insideEdge(Lanes e, bool topLeft) {
+    // Pixels exactly on an edge belong to the triangle on its top or left
+    // side, so shared edges are drawn once
+    return topLeft ? laneLessEqual(lanes(0), e) : laneLess(lanes(0), e);
+}
+
+static void drawTriangle(RasterTarget& t, const RasterPrimitive& p, const RasterTexture* texture,
+                         int tileX0, int tileY0, int tileX1, int tileY1) {
+    int xMin = std::max(p.x0, tileX0), xMax = std::min(p.x1, tileX1);
+    int yMin = std::max(p.y0, tileY0), yMax = std::min(p.y1, tileY1);
+    if (xMin >= xMax || yMin >= yMax) return;
+    int xStart = xMin & ~3;
+
+    bool depthTest = (p.flags & RASTER_DEPTH_TEST) != 0;
+    bool blend = (p.flags & RASTER_BLEND) != 0;
+    bool cutout = (p.flags & RASTER_ALPHA_CUTOUT) != 0;
+    int planes = texture ? RASTER_PLANES : RASTER_PLANES - 2;
+    bool topLeft[3] = {(p.topLeft & 1) != 0, (p.topLeft & 2) != 0, (p.topLeft & 4) != 0};
+
+    Lanes edgeStep[3], planeStep[RASTER_PLANES];
+    for (int e = 0; e < 3; e++) edgeStep[e] = lanes(4 * p.edgeA[e]);
+    for (int k = 0; k < planes; k++) planeStep[k] = lanes(4 * p.planes[k].dx);
+    Lanes columns = laneRamp(0.0f, 1.0f);
+    Lanes one = lanes(1.0f);
+
+    for (int y = yMin; y < yMax; y++) {
+        float py = y + 0.5f - p.originY;
+        float px = xStart + 0.5f - p.originX;
+        Lanes edge[3], plane[RASTER_PLANES];
+        for (int e = 0; e < 3; e++) {
+            edge[e] = laneRamp(p.edgeA[e] * px + p.edgeB[e] * py + p.edgeC[e], p.edgeA[e]);
+        }
+        for (int k = 0; k < planes; k++) {
+            const RasterPlane& pl = p.planes[k];
+            plane[k] = laneRamp(pl.base + pl.dx * px + pl.dy * py, pl.dx);
+        }
+
+        unsigned* colorRow = &t.color[(size_t)y * t.stride];
+        float* depthRow = &t.depth[(size_t)y * t.stride];
+        for (int x = xStart; x < xMax; x += 4) {
+            Lanes mask = laneAnd(laneAnd(insideEdge(edge[0], topLeft[0]), insideEdge(edge[1], topLeft[1])),
+                                 insideEdge(edge[2], topLeft[2]));
+            if (x < xMin || x + 4 > xMax) {
+                Lanes column = lanes((float)x) + columns;
+                mask = laneAnd(mask, laneAnd(laneLessEqual(lanes((float)xMin), column), laneLess(column, lanes((float)xMax))));
+            }
+
+            Lanes z = plane[RASTER_Z];
+            Lanes oldDepth = lanes(0);
+            if (laneAny(mask) && depthTest) {
+                oldDepth = loadLanes(depthRow + x);
+                mask = laneAnd(mask, laneLess(z, oldDepth));
+            }
+
+            if (laneAny(mask)) {
+                Lanes w = one / plane[RASTER_INV_W];
+                Lanes r = plane[2] * w, g = plane[3] * w, b = plane[4] * w, a = plane[5] * w;
+
+                if (texture) {
+                    float us[4], vs[4], rs[4], gs[4], bs[4], as[4];
+                    storeLanes(us, plane[6] * w);
+                    storeLanes(vs, plane[7] * w);
+                    int bits = laneBits(mask);
+                    for (int i = 0; i < 4; i++) {
+                        float texel[4] = {0, 0, 0, 0};
+                        if (bits & (1 << i)) sampleTexture(*texture, us[i], vs[i], texel);
+                        rs[i] = texel[0];
+                        gs[i] = texel[1];
+                        bs[i] = texel[2];
+                        as[i] = texel[3];
+                    }
+                    r = r * loadLanes(rs);
+                    g = g * loadLanes(gs);
+                    b = b * loadLanes(bs);
+                    a = a * loadLanes(as);
+                    if (cutout) mask = laneAnd(mask, laneLessEqual(lanes(0.5f), a));
+                }
+
+                PixelLanes old = loadPixels(colorRow + x);
+                if (blend) {
+                    Lanes dr, dg, db, da;
+                    unpackPixels(old, dr, dg, db, da);
+                    a = laneClamp01(a);
+                    Lanes keep = one - a;
+                    r = r * a + dr * keep;
+                    g = g * a + dg * keep;
+                    b = b * a + db * keep;
+                    a = a * a + da * keep;
+                }
+                storePixels(colorRow + x, packPixels(r, g, b, a), old, mask);
+                if (depthTest) storeLanes(depthRow + x, laneSelect(mask, z, oldDepth));
+            }
+
+            for (int e = 0; e < 3; e++) edge[e] = edge[e] + edgeStep[e];
+            for (int k = 0; k < planes; k++) plane[k] = plane[k] + planeStep[k];
+        }
+    }
+}
+
+// Text is drawn with the depth test off, like the bitmap text it replaces
+static void drawGlyph(RasterTarget& t, const RasterPrimitive& p, int tileX0, int tileY0, int tileX1, int tileY1) {
+    int xMin = std::max(p.x0, tileX0), xMax = std::min(p.x1, tileX1);
+    int yMin = std::max(p.y0, tileY0), yMax = std::min(p.y1, tileY1);
+    unsigned packed = packColor(p.color);
+    float alpha = std::min(std::max(p.color[3], 0.0f), 1.0f);
+    bool blend = (p.flags & RASTER_BLEND) != 0 && alpha < 1.0f;
+
+    for (int y = yMin; y < yMax; y++) {
+        unsigned bits = SOFTWARE_FONT[p.glyph][y - (int)p.originY];
+        unsigned* row = &t.color[(size_t)y * t.stride];
+        for (int x = xMin; x < xMax; x++) {
+            if (!(bits & (1u << (x - (int)p.originX)))) continue;
+            if (!blend) {
+                row[x] = packed;
+                continue;
+            }
+            unsigned old = row[x], mixed = 0;
+            for (int c = 0; c < 4; c++) {
+                float source = c < 3 ? std::min(std::max(p.color[c], 0.0f), 1.0f) : alpha;
+                float dest = ((old >> (c * 8)) & 0xff) / 255.0f;
+                mixed |= (unsigned)lrintf((source * alpha + dest * (1 - alpha)) * 255.0f) << (c * 8);
+            }
+            row[x] = mixed;
+        }
+    }
+}
+
+// Blend two packed RGBA8 pixels, weight 0..256 towards b, two channels at
+// a time in the gaps between them
+static inline unsigned lerpPixel(unsigned a, unsigned b, unsigned weight) {
+    unsigned redBlue = ((a & 0x00ff00ffu) * (256 - weight) + (b & 0x00ff00ffu) * weight) >> 8;
+    unsigned greenAlpha = ((a >> 8) & 0x00ff00ffu) * (256 - weight) + ((b >> 8) & 0x00ff00ffu) * weight;
+    return (redBlue & 0x00ff00ffu) | (greenAlpha & 0xff00ff00u);
+}
+
+// Blend two rows of packed pixels, weight 0..256 towards b, with the same
+// rounding as lerpPixel()
+static void lerpRow(const unsigned* a, const unsigned* b, unsigned weight, unsigned* out, int count) {
+    int i = 0;
+#ifdef SOFTRASTER_SSE2
+    __m128i zero = _mm_setzero_si128();
+    __m128i weightA = _mm_set1_epi16((short)(256 - weight)), weightB = _mm_set1_epi16((short)weight);
+    for (; i + 4 <= count; i += 4) {
+        __m128i pa = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i pb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), weightA),
+                                    _mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), weightB));
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), weightA),
+                                     _mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), weightB));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+    }
+#endif
+    for (; i < count; i++) out[i] = lerpPixel(a[i], b[i], weight);
+}
+
+// Texel coordinates are 16.16 fixed point, sampled at pixel centres like
+// GL_LINEAR with GL_CLAMP_TO_EDGE
+static void resampleRow(const unsigned* source, int maxX, int startX, int stepX, unsigned* out, int count) {
+    int sx = startX;
+    for (int i = 0; i < count; i++, sx += stepX) {
+        int x0 = std::max(0, std::min(maxX, sx >> 16));
+        int x1 = std::min(maxX, x0 + 1);
+        out[i] = lerpPixel(source[x0], source[x1], sx < 0 ? 0 : (sx >> 8) & 0xff);
+    }
+}
+
+// Texel rows are resampled across the tile once each and kept while the
+// tile's pixel rows still fall between them; each pixel row is then one
+// blend of two of those
+static void drawBlit(RasterTarget& t, const RasterPrimitive& p, const RasterTexture& in,
+                     int tileX0, int tileY0, int tileX1, int tileY1) {
+    int xMin = std::max(p.x0, tileX0), xMax = std::min(p.x1, tileX1);
+    int yMin = std::max(p.y0, tileY0), yMax = std::min(p.y1, tileY1);
+    int count = xMax - xMin;
+    if (count <= 0) return;
+
+    if (in.width == p.x1 && in.height == p.y1) {
+        for (int y = yMin; y < yMax; y++) {
+            const unsigned* source = &in.texels[(size_t)y * in.width];
+            std::copy(source + xMin, source + xMax, &t.color[(size_t)y * t.stride + xMin]);
+        }
+        return;
+    }
+
+    int stepX = (int)(((long long)in.width << 16) / p.x1);
+    int stepY = (int)(((long long)in.height << 16) / p.y1);
+    int startX = stepX / 2 - 0x8000 + xMin * stepX;
+    int maxY = in.height - 1;
+
+    unsigned rows[2][RASTER_TILE_SIZE];
+    int rowSource[2] = {-1, -1};
+    for (int y = yMin; y < yMax; y++) {
+        int sy = stepY / 2 - 0x8000 + y * stepY;
+        int source[2];
+        source[0] = std::max(0, std::min(maxY, sy >> 16));
+        source[1] = std::min(maxY, source[0] + 1);
+
+        const unsigned* resampled[2];
+        for (int k = 0; k < 2; k++) {
+            int slot = rowSource[0] == source[k] ? 0 : rowSource[1] == source[k] ? 1 : -1;
+            if (slot < 0) {
+                // Replace whichever row the other source is not using
+                slot = rowSource[0] == source[1 - k] ? 1 : 0;
+                resampleRow(&in.texels[(size_t)source[k] * in.width], in.width - 1, startX, stepX, rows[slot], count);
+                rowSource[slot] = source[k];
+            }
+            resampled[k] = rows[slot];
+        }
+        lerpRow(resampled[0], resampled[1], sy < 0 ? 0 : (sy >> 8) & 0xff, &t.color[(size_t)y * t.stride + xMin], count);
+    }
+}
+
+static void drawTile(SoftRaster& raster, int tile) {
+    RasterTarget& t = *raster.target;
+    int x0 = (tile % t.tilesX) * RASTER_TILE_SIZE;
+    int y0 = (tile / t.tilesX) * RASTER_TILE_SIZE;
+    int x1 = std::min(x0 + RASTER_TILE_SIZE, t.width);
+    int y1 = std::min(y0 + RASTER_TILE_SIZE, t.height);
+
+    // A blit over the whole tile first thing replaces the cleared colour
+    bool covered = false;
+    if (raster.binStart[tile] < raster.binStart[tile + 1]) {
+        const RasterPrimitive& p = raster.primitives[raster.binned[raster.binStart[tile]]];
+        covered = p.kind == RASTER_BLIT && p.x0 <= x0 && p.y0 <= y0 && p.x1 >= x1 && p.y1 >= y1;
+    }
+
+    for (int y = y0; y < y1; y++) {
+        size_t row = (size_t)y * t.stride;
+        if (raster.clearColorPending && !covered) std::fill(t.color.begin() + row + x0, t.color.begin() + row + x1, raster.clearColor);
+        if (raster.clearDepthPending) std::fill(t.depth.begin() + row + x0, t.depth.begin() + row + x1, raster.clearDepth);
+    }
+
+    for (int i = raster.binStart[tile]; i < raster.binStart[tile + 1]; i++) {
+        const RasterPrimitive& p = raster.primitives[raster.binned[i]];
+        if (p.kind == RASTER_GLYPH) {
+            drawGlyph(t, p, x0, y0, x1, y1);
+        } else if (p.kind == RASTER_BLIT) {
+            drawBlit(t, p, raster.textures[p.texture], x0, y0, x1, y1);
+        } else {
+            const RasterTexture* texture = p.texture >= 0 ? &raster.textures[p.texture] : 0;
+            drawTriangle(t, p, texture, x0, y0, x1, y1);
+        }
+    }
+}
+
+// Every thread, the caller included, claims tiles until none are left
+static void rasterJob(void* arg) {
+    SoftRaster& raster = *static_cast<SoftRaster*>(arg);
+    int tiles = raster.target->tilesX * raster.target->tilesY;
+    for (;;) {
+        int tile = raster.nextTile.fetch_add(1, std::memory_order_relaxed);
+        if (tile >= tiles) return;
+        drawTile(raster, tile);
+    }
+}
+
+void flushRaster(SoftRaster& raster) {
+    if (!raster.target) return;
+    if (raster.primitives.empty() && !raster.clearColorPending && !raster.clearDepthPending) return;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    RasterTarget& t = *raster.target;
+    int tiles = t.tilesX * t.tilesY;
+
+    // Counting sort: tally each tile, turn the tallies into end offsets,
+    // then fill backwards so every offset walks down to its tile's start
+    std::vector<int>& bins = raster.binStart;
+    bins.assign(tiles + 1, 0);
+    for (size_t i = 0; i < raster.entries.size(); i++) bins[raster.entries[i].tile]++;
+    int total = 0;
+    for (int i = 0; i < tiles; i++) {
+        total += bins[i];
+        bins[i] = total;
+    }
+    bins[tiles] = total;
+    raster.binned.resize(total);
+    for (size_t i = raster.entries.size(); i-- > 0;) {
+        const RasterBinEntry& entry = raster.entries[i];
+        raster.binned[--bins[entry.tile]] = entry.primitive;
+    }
+    raster.binEntries += total;
+
+    int helpers = std::min(raster.threads - 1, tiles - 1);
+    raster.nextTile.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < helpers; i++) submitJob(raster.workers[i], rasterJob, &raster);
+    rasterJob(&raster);
+    for (int i = 0; i < helpers; i++) waitForWorker(raster.workers[i]);
+
+    raster.entries.clear();
+    raster.primitives.clear();
+    raster.clearColorPending = false;
+    raster.clearDepthPending = false;
+    raster.flushes++;
+    raster.flushMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void readRasterPixels(SoftRaster& raster, int x, int y, int width, int height, unsigned char* rgb) {
+    flushRaster(raster);
+    const RasterTarget& t = *raster.target;
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            unsigned char* out = rgb + ((size_t)row * width + col) * 3;
+            int sx = x + col, sy = y + row;
+            unsigned pixel = sx >= 0 && sx < t.width && sy >= 0 && sy < t.height ? t.color[(size_t)sy * t.stride + sx] : 0;
+            out[0] = pixel & 0xff;
+            out[1] = (pixel >> 8) & 0xff;
+            out[2] = (pixel >> 16) & 0xff;
+        }
+    }
+}
+
+void copyRasterTarget(SoftRaster& raster, int texture, int width, int height) {
+    flushRaster(raster);
+    const RasterTarget& t = *raster.target;
+    RasterTexture& out = raster.textures[texture];
+    width = std::min(width, t.width);
+    height = std::min(height, t.height);
+    out.width = width;
+    out.height = height;
+    out.texels.resize((size_t)width * height);
+    for (int row = 0; row < height; row++) {
+        const unsigned* in = &t.color[(size_t)row * t.stride];
+        unsigned* texel = &out.texels[(size_t)row * width];
+        for (int col = 0; col < width; col++) texel[col] = in[col] | 0xff000000u;
+    }
+}
+
+void reportRasterStats(SoftRaster& raster, unsigned frames) {
+    if (frames == 0) return;
+    std::cerr << "software raster: " << raster.threads << " threads, " << (double)raster.triangles / frames
+              << " triangles, " << (double)raster.glyphs / frames << " glyphs and " << (double)raster.binEntries / frames
+              << " tile entries per frame, " << (double)raster.flushes / frames << " flushes taking "
+              << raster.flushMs / frames << " ms";
+    if (raster.fullFlushes > 0) std::cerr << " (" << raster.fullFlushes << " forced by a full queue)";
+    std::cerr << std::endl;
+    raster.triangles = 0;
+    raster.glyphs = 0;
+    raster.binEntries = 0;
+    raster.flushes = 0;
+    raster.fullFlushes = 0;
+    raster.flushMs = 0;
+}
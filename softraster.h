@@ -0,0 +1,178 @@
+#ifndef SOFTRASTER_H
+#define SOFTRASTER_H
+
+#include "worker.h"
+#include <atomic>
+#include <vector>
+
+// Tile-based CPU rasterizer behind the renderer's software backend, for
+// machines without a GPU. Primitives arrive in window coordinates and are
+// binned into RASTER_TILE_SIZE square tiles; a flush then rasterizes the
+// tiles in parallel, each tile drawing its primitives in submission order,
+// so blending and depth results match a serial rasterizer exactly. Edge
+// functions, depth test, interpolation and blending run four pixels at a
+// time with SSE2 where available.
+
+const int RASTER_TILE_SIZE = 64;
+const int MAX_RASTER_THREADS = 32;
+
+// The queue never grows past these; a primitive that would not fit flushes
+// what is queued first, which draws the same pixels in the same order
+const int RASTER_MAX_PRIMITIVES = 16384;
+const int RASTER_MAX_BIN_ENTRIES = 65536;
+
+enum RasterFlags {
+    RASTER_DEPTH_TEST = 1,        // GL_LESS, and write depth where it passes
+    RASTER_BLEND = 2,             // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+    RASTER_ALPHA_CUTOUT = 4       // discard texels below half alpha
+};
+
+enum RasterPrimitiveKind {
+    RASTER_TRIANGLE = 0,
+    RASTER_GLYPH,
+    RASTER_BLIT
+};
+
+// Vertex after the viewport transform: window pixels with y up, depth in
+// [0, 1] and 1/w for perspective-correct colour and texture coordinates
+struct RasterVertex {
+    float x, y, z, invW;
+    float r, g, b, a;
+    float u, v;
+};
+
+// Attributes are planes over the window, anchored at the first vertex:
+// value(x, y) = base + dx * (x - originX) + dy * (y - originY)
+struct RasterPlane {
+    float base, dx, dy;
+};
+
+const int RASTER_Z = 0;
+const int RASTER_INV_W = 1;
+const int RASTER_PLANES = 8;        // z, 1/w, then r g b a u v divided by w
+
+struct RasterPrimitive {
+    int kind;
+    int flags;
+    int texture;                    // -1 for untextured
+    int x0, y0, x1, y1;             // covered pixels, half-open
+    float originX, originY;
+
+    // Triangles: edge functions with the interior on the positive side
+    float edgeA[3], edgeB[3], edgeC[3];
+    int topLeft;                    // bit per edge: pixels exactly on it are inside
+    RasterPlane planes[RASTER_PLANES];
+
+    // Glyphs: a cell of the software font in a flat colour. Blits: the
+    // texture scaled to x1 x y1.
+    int glyph;
+    float color[4];
+};
+
+struct RasterTexture {
+    int width, height;
+    std::vector<unsigned> texels;   // RGBA8 with red in the low byte, bottom row first
+};
+
+// One primitive overlapping one tile
+struct RasterBinEntry {
+    int tile;
+    int primitive;
+};
+
+// A colour + depth framebuffer split into tiles
+struct RasterTarget {
+    int width, height;
+    int stride;                     // pixels per row, a multiple of 4
+    int tilesX, tilesY;
+    std::vector<unsigned> color;    // RGBA8 with red in the low byte, bottom row first
+    std::vector<float> depth;
+
+    RasterTarget() : width(0), height(0), stride(0), tilesX(0), tilesY(0) {}
+};
+
+struct SoftRaster {
+    RasterTarget* target;
+    std::vector<RasterPrimitive> primitives;
+    std::vector<RasterTexture> textures;
+
+    // Binning appends to one list in submission order; a flush sorts it by
+    // tile (stably, so each tile keeps that order) into binned, with tile
+    // t's primitives at [binStart[t], binStart[t + 1]). Flat lists only
+    // grow with the total, not with whichever tile is busiest.
+    std::vector<RasterBinEntry> entries;
+    std::vector<int> binStart;
+    std::vector<int> binned;
+
+    // A clear is deferred to the next flush, where each tile clears itself
+    // before drawing
+    bool clearColorPending, clearDepthPending;
+    unsigned clearColor;
+    float clearDepth;
+
+    int threads;
+    BackgroundWorker workers[MAX_RASTER_THREADS - 1];
+    std::atomic<int> nextTile;
+
+    // Totals since the last report
+    unsigned long long triangles;
+    unsigned long long glyphs;
+    unsigned long long binEntries;
+    unsigned long long flushes;
+    unsigned long long fullFlushes;   // of them, forced by a full queue
+    double flushMs;
+
+    SoftRaster() : target(0), clearColorPending(false), clearDepthPending(false), clearColor(0), clearDepth(1.0f),
+                   threads(1), nextTile(0), triangles(0), glyphs(0), binEntries(0), flushes(0), fullFlushes(0),
+                   flushMs(0) {}
+};
+
+// Size the target's buffers; its contents are undefined afterwards
+void resizeRasterTarget(RasterTarget& target, int width, int height);
+
+// Size the queue for its limits and the bins for target's tiles, so that
+// drawing into it never allocates. Call whenever a target is sized.
+void reserveRasterQueue(SoftRaster& raster, const RasterTarget& target);
+
+// Flushes whatever was drawn into the previous target first
+void setRasterTarget(SoftRaster& raster, RasterTarget* target);
+
+// Rasterize with this many threads, the calling one included. Helper
+// threads are started on first use and kept until stopRasterThreads().
+void setRasterThreads(SoftRaster& raster, int threads);
+void stopRasterThreads(SoftRaster& raster);
+
+// Returns the index of the new texture
+int createRasterTexture(SoftRaster& raster, int width, int height, const unsigned char* rgba);
+
+void rasterClear(SoftRaster& raster, bool color, const float rgba[4], bool depth, float z);
+
+// Queue a triangle, drawn only inside the scissor rectangle (half-open)
+void rasterTriangle(SoftRaster& raster, const RasterVertex& a, const RasterVertex& b, const RasterVertex& c,
+                    int flags, int texture, const int scissor[4]);
+
+// Queue a character of the software font with its cell's bottom-left
+// corner at (x, y)
+void rasterGlyph(SoftRaster& raster, int x, int y, char c, const float color[4], int flags, const int scissor[4]);
+
+// Rasterize everything queued; the target is complete when this returns
+void flushRaster(SoftRaster& raster);
+
+// Copy a rectangle of the target as tightly packed RGB rows, bottom row
+// first like glReadPixels. Flushes first.
+void readRasterPixels(SoftRaster& raster, int x, int y, int width, int height, unsigned char* rgb);
+
+// Copy the target's bottom-left width x height pixels into a texture,
+// resized to match and fully opaque. Flushes first.
+void copyRasterTarget(SoftRaster& raster, int texture, int width, int height);
+
+// The reverse: queue a texture stretched over the target's bottom-left
+// width x height pixels, bilinear filtered, on top of whatever was queued
+// before and leaving depth alone. A texture of that exact size is copied.
+void rasterBlit(SoftRaster& raster, int texture, int width, int height);
+
+// Primitives, flushes and rasterizing time per frame since the last
+// report, to stderr
+void reportRasterStats(SoftRaster& raster, unsigned frames);
+
+#endif
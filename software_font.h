@@ -0,0 +1,114 @@
+#ifndef SOFTWARE_FONT_H
+#define SOFTWARE_FONT_H
+
+// Bitmap font for the software renderer's text: the X11 misc-fixed 9x15
+// font (public domain), which freeglut also ships as GLUT_BITMAP_9_BY_15.
+// One glyph per printable ASCII character from ' ' to '~'. Rows run from
+// the bottom of the cell up, with the baseline SOFTWARE_FONT_BASELINE rows
+// above the bottom; bit x of a row is column x from the left.
+
+const int SOFTWARE_FONT_FIRST = 32;
+const int SOFTWARE_FONT_GLYPHS = 95;
+const int SOFTWARE_FONT_WIDTH = 9;
+const int SOFTWARE_FONT_HEIGHT = 16;
+const int SOFTWARE_FONT_BASELINE = 4;
+
+const unsigned short SOFTWARE_FONT[SOFTWARE_FONT_GLYPHS][SOFTWARE_FONT_HEIGHT] = {
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // space
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x000},   // !
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x048, 0x048, 0x048, 0x000, 0x000},   // "
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x024, 0x024, 0x07e, 0x024, 0x024, 0x07e, 0x024, 0x024, 0x000, 0x000, 0x000},   // #
+    {0x000, 0x000, 0x000, 0x010, 0x07c, 0x092, 0x090, 0x090, 0x050, 0x038, 0x014, 0x012, 0x092, 0x07c, 0x010, 0x000},   // $
+    {0x000, 0x000, 0x000, 0x000, 0x042, 0x0a4, 0x0a4, 0x048, 0x010, 0x010, 0x024, 0x04a, 0x04a, 0x084, 0x000, 0x000},   // %
+    {0x000, 0x000, 0x000, 0x000, 0x08c, 0x052, 0x022, 0x052, 0x08c, 0x00c, 0x012, 0x012, 0x012, 0x00c, 0x000, 0x000},   // &
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x008, 0x010, 0x020, 0x060, 0x000, 0x000},   // '
+    {0x000, 0x000, 0x000, 0x020, 0x010, 0x010, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x010, 0x010, 0x020, 0x000},   // (
+    {0x000, 0x000, 0x000, 0x008, 0x010, 0x010, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x010, 0x010, 0x008, 0x000},   // )
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x010, 0x092, 0x054, 0x038, 0x054, 0x092, 0x010, 0x000, 0x000, 0x000, 0x000},   // *
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x0fe, 0x010, 0x010, 0x010, 0x000, 0x000, 0x000, 0x000},   // +
+    {0x000, 0x010, 0x020, 0x020, 0x030, 0x030, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // ,
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x0fe, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // -
+    {0x000, 0x000, 0x000, 0x000, 0x030, 0x030, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // .
+    {0x000, 0x000, 0x000, 0x000, 0x002, 0x004, 0x004, 0x008, 0x010, 0x010, 0x020, 0x040, 0x040, 0x080, 0x000, 0x000},   // /
+    {0x000, 0x000, 0x000, 0x000, 0x038, 0x044, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x044, 0x038, 0x000, 0x000},   // 0
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x010, 0x010, 0x010, 0x010, 0x010, 0x012, 0x014, 0x018, 0x010, 0x000, 0x000},   // 1
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x002, 0x004, 0x008, 0x010, 0x020, 0x040, 0x082, 0x082, 0x07c, 0x000, 0x000},   // 2
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x080, 0x080, 0x080, 0x070, 0x020, 0x040, 0x080, 0x0fe, 0x000, 0x000},   // 3
+    {0x000, 0x000, 0x000, 0x000, 0x040, 0x040, 0x040, 0x0fe, 0x042, 0x044, 0x048, 0x050, 0x060, 0x040, 0x000, 0x000},   // 4
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x080, 0x080, 0x080, 0x086, 0x07a, 0x002, 0x002, 0x0fe, 0x000, 0x000},   // 5
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x086, 0x07a, 0x002, 0x002, 0x004, 0x078, 0x000, 0x000},   // 6
+    {0x000, 0x000, 0x000, 0x000, 0x004, 0x004, 0x008, 0x008, 0x010, 0x020, 0x040, 0x080, 0x080, 0x0fe, 0x000, 0x000},   // 7
+    {0x000, 0x000, 0x000, 0x000, 0x038, 0x044, 0x082, 0x082, 0x044, 0x038, 0x044, 0x082, 0x044, 0x038, 0x000, 0x000},   // 8
+    {0x000, 0x000, 0x000, 0x000, 0x03c, 0x040, 0x080, 0x080, 0x0bc, 0x0c2, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000},   // 9
+    {0x000, 0x000, 0x000, 0x000, 0x030, 0x030, 0x000, 0x000, 0x000, 0x030, 0x030, 0x000, 0x000, 0x000, 0x000, 0x000},   // :
+    {0x000, 0x010, 0x020, 0x020, 0x030, 0x030, 0x000, 0x000, 0x000, 0x030, 0x030, 0x000, 0x000, 0x000, 0x000, 0x000},   // ;
+    {0x000, 0x000, 0x000, 0x000, 0x040, 0x020, 0x010, 0x008, 0x004, 0x004, 0x008, 0x010, 0x020, 0x040, 0x000, 0x000},   // <
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x0fe, 0x000, 0x000, 0x0fe, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // =
+    {0x000, 0x000, 0x000, 0x000, 0x004, 0x008, 0x010, 0x020, 0x040, 0x040, 0x020, 0x010, 0x008, 0x004, 0x000, 0x000},   // >
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x000, 0x010, 0x010, 0x020, 0x040, 0x080, 0x082, 0x082, 0x07c, 0x000, 0x000},   // ?
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x002, 0x002, 0x0b2, 0x0ca, 0x08a, 0x0f2, 0x082, 0x082, 0x07c, 0x000, 0x000},   // @
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x0fe, 0x082, 0x082, 0x082, 0x044, 0x028, 0x010, 0x000, 0x000},   // A
+    {0x000, 0x000, 0x000, 0x000, 0x07e, 0x084, 0x084, 0x084, 0x084, 0x07e, 0x084, 0x084, 0x084, 0x07e, 0x000, 0x000},   // B
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x002, 0x002, 0x002, 0x002, 0x002, 0x002, 0x082, 0x07c, 0x000, 0x000},   // C
+    {0x000, 0x000, 0x000, 0x000, 0x07e, 0x084, 0x084, 0x084, 0x084, 0x084, 0x084, 0x084, 0x084, 0x07e, 0x000, 0x000},   // D
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x004, 0x004, 0x004, 0x004, 0x03c, 0x004, 0x004, 0x004, 0x0fe, 0x000, 0x000},   // E
+    {0x000, 0x000, 0x000, 0x000, 0x004, 0x004, 0x004, 0x004, 0x004, 0x03c, 0x004, 0x004, 0x004, 0x0fe, 0x000, 0x000},   // F
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x0e2, 0x002, 0x002, 0x002, 0x082, 0x07c, 0x000, 0x000},   // G
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x082, 0x082, 0x0fe, 0x082, 0x082, 0x082, 0x082, 0x000, 0x000},   // H
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x07c, 0x000, 0x000},   // I
+    {0x000, 0x000, 0x000, 0x000, 0x03c, 0x042, 0x040, 0x040, 0x040, 0x040, 0x040, 0x040, 0x040, 0x1f0, 0x000, 0x000},   // J
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x042, 0x022, 0x012, 0x00a, 0x00e, 0x012, 0x022, 0x042, 0x082, 0x000, 0x000},   // K
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x002, 0x002, 0x002, 0x002, 0x002, 0x002, 0x002, 0x002, 0x002, 0x000, 0x000},   // L
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x092, 0x092, 0x0aa, 0x0aa, 0x0c6, 0x082, 0x082, 0x000, 0x000},   // M
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x0c2, 0x0a2, 0x092, 0x08a, 0x086, 0x082, 0x082, 0x000, 0x000},   // N
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000},   // O
+    {0x000, 0x000, 0x000, 0x000, 0x002, 0x002, 0x002, 0x002, 0x002, 0x07e, 0x082, 0x082, 0x082, 0x07e, 0x000, 0x000},   // P
+    {0x000, 0x000, 0x0c0, 0x020, 0x07c, 0x092, 0x08a, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000},   // Q
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x042, 0x022, 0x012, 0x07e, 0x082, 0x082, 0x082, 0x07e, 0x000, 0x000},   // R
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x080, 0x060, 0x01c, 0x002, 0x082, 0x082, 0x07c, 0x000, 0x000},   // S
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x0fe, 0x000, 0x000},   // T
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x082, 0x000, 0x000},   // U
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x028, 0x028, 0x028, 0x044, 0x044, 0x044, 0x082, 0x082, 0x082, 0x000, 0x000},   // V
+    {0x000, 0x000, 0x000, 0x000, 0x044, 0x0aa, 0x092, 0x092, 0x092, 0x092, 0x082, 0x082, 0x082, 0x082, 0x000, 0x000},   // W
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x044, 0x028, 0x010, 0x010, 0x028, 0x044, 0x082, 0x082, 0x000, 0x000},   // X
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x028, 0x044, 0x082, 0x082, 0x000, 0x000},   // Y
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x002, 0x002, 0x004, 0x008, 0x010, 0x020, 0x040, 0x080, 0x0fe, 0x000, 0x000},   // Z
+    {0x000, 0x000, 0x000, 0x078, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x008, 0x078, 0x000},   // [
+    {0x000, 0x000, 0x000, 0x000, 0x080, 0x040, 0x040, 0x020, 0x010, 0x010, 0x008, 0x004, 0x004, 0x002, 0x000, 0x000},   // backslash
+    {0x000, 0x000, 0x000, 0x03c, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x020, 0x03c, 0x000},   // ]
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x082, 0x044, 0x028, 0x010, 0x000, 0x000},   // ^
+    {0x000, 0x000, 0x000, 0x0ff, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000},   // _
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x020, 0x010, 0x008, 0x00c, 0x000},   // `
+    {0x000, 0x000, 0x000, 0x000, 0x0bc, 0x0c2, 0x082, 0x0fc, 0x080, 0x080, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // a
+    {0x000, 0x000, 0x000, 0x000, 0x07a, 0x086, 0x082, 0x082, 0x082, 0x086, 0x07a, 0x002, 0x002, 0x002, 0x000, 0x000},   // b
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x002, 0x002, 0x002, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // c
+    {0x000, 0x000, 0x000, 0x000, 0x0bc, 0x0c2, 0x082, 0x082, 0x082, 0x0c2, 0x0bc, 0x080, 0x080, 0x080, 0x000, 0x000},   // d
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x002, 0x002, 0x0fe, 0x082, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // e
+    {0x000, 0x000, 0x000, 0x000, 0x008, 0x008, 0x008, 0x008, 0x03e, 0x008, 0x008, 0x088, 0x088, 0x070, 0x000, 0x000},   // f
+    {0x000, 0x07c, 0x082, 0x082, 0x07c, 0x002, 0x03c, 0x042, 0x042, 0x042, 0x0bc, 0x000, 0x000, 0x000, 0x000, 0x000},   // g
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x082, 0x082, 0x086, 0x07a, 0x002, 0x002, 0x002, 0x000, 0x000},   // h
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x010, 0x010, 0x010, 0x010, 0x010, 0x01c, 0x000, 0x000, 0x018, 0x000, 0x000},   // i
+    {0x000, 0x03c, 0x042, 0x042, 0x042, 0x040, 0x040, 0x040, 0x040, 0x040, 0x070, 0x000, 0x000, 0x060, 0x000, 0x000},   // j
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x062, 0x01a, 0x006, 0x01a, 0x062, 0x082, 0x002, 0x002, 0x002, 0x000, 0x000},   // k
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x01c, 0x000, 0x000},   // l
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x092, 0x092, 0x092, 0x092, 0x092, 0x06e, 0x000, 0x000, 0x000, 0x000, 0x000},   // m
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x082, 0x082, 0x082, 0x082, 0x086, 0x07a, 0x000, 0x000, 0x000, 0x000, 0x000},   // n
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x082, 0x082, 0x082, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // o
+    {0x000, 0x002, 0x002, 0x002, 0x07a, 0x086, 0x082, 0x082, 0x082, 0x086, 0x07a, 0x000, 0x000, 0x000, 0x000, 0x000},   // p
+    {0x000, 0x080, 0x080, 0x080, 0x0bc, 0x0c2, 0x082, 0x082, 0x082, 0x0c2, 0x0bc, 0x000, 0x000, 0x000, 0x000, 0x000},   // q
+    {0x000, 0x000, 0x000, 0x000, 0x004, 0x004, 0x004, 0x004, 0x084, 0x08c, 0x072, 0x000, 0x000, 0x000, 0x000, 0x000},   // r
+    {0x000, 0x000, 0x000, 0x000, 0x07c, 0x082, 0x080, 0x07c, 0x002, 0x082, 0x07c, 0x000, 0x000, 0x000, 0x000, 0x000},   // s
+    {0x000, 0x000, 0x000, 0x000, 0x070, 0x088, 0x008, 0x008, 0x008, 0x008, 0x07e, 0x008, 0x008, 0x000, 0x000, 0x000},   // t
+    {0x000, 0x000, 0x000, 0x000, 0x0bc, 0x042, 0x042, 0x042, 0x042, 0x042, 0x042, 0x000, 0x000, 0x000, 0x000, 0x000},   // u
+    {0x000, 0x000, 0x000, 0x000, 0x010, 0x028, 0x028, 0x044, 0x044, 0x082, 0x082, 0x000, 0x000, 0x000, 0x000, 0x000},   // v
+    {0x000, 0x000, 0x000, 0x000, 0x044, 0x0aa, 0x092, 0x092, 0x092, 0x082, 0x082, 0x000, 0x000, 0x000, 0x000, 0x000},   // w
+    {0x000, 0x000, 0x000, 0x000, 0x082, 0x044, 0x028, 0x010, 0x028, 0x044, 0x082, 0x000, 0x000, 0x000, 0x000, 0x000},   // x
+    {0x000, 0x03c, 0x042, 0x040, 0x05c, 0x062, 0x042, 0x042, 0x042, 0x042, 0x042, 0x000, 0x000, 0x000, 0x000, 0x000},   // y
+    {0x000, 0x000, 0x000, 0x000, 0x0fe, 0x004, 0x008, 0x010, 0x020, 0x040, 0x0fe, 0x000, 0x000, 0x000, 0x000, 0x000},   // z
+    {0x000, 0x000, 0x000, 0x0e0, 0x010, 0x010, 0x010, 0x020, 0x018, 0x018, 0x020, 0x010, 0x010, 0x010, 0x0e0, 0x000},   // {
+    {0x000, 0x000, 0x000, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x010, 0x000},   // |
+    {0x000, 0x000, 0x000, 0x00e, 0x010, 0x010, 0x010, 0x008, 0x030, 0x030, 0x008, 0x010, 0x010, 0x010, 0x00e, 0x000},   // }
+    {0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x062, 0x092, 0x08c, 0x000, 0x000}    // ~
+};
+
+#endif
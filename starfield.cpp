@@ -0,0 +1,85 @@
+#include "starfield.h"
+#include <cmath>
+#include <iostream>
+
+// Integer hash with full avalanche, so neighbouring bands share no pattern
+static unsigned hashTile(int index) {
+    unsigned h = (unsigned)index * 0x9e3779b9u + 0x7f4a7c15u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h ? h : 1;
+}
+
+// xorshift32 step, returned as a float in [0, 1)
+static float nextUnit(unsigned& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+// Same spread as the old fixed field: x in [-1000, 1000), z in [-500, 500),
+// brightness in [0.3, 1), and a tint that warms over every run of ten stars
+static void generateTile(StarTile& tile, int index) {
+    unsigned state = hashTile(index);
+    float bottom = index * STAR_TILE_HEIGHT;
+    for (int i = 0; i < STARS_PER_TILE; i++) {
+        MeshVertex& v = tile.vertices[i];
+        v.x = nextUnit(state) * 2000.0f - 1000.0f;
+        v.y = bottom + nextUnit(state) * STAR_TILE_HEIGHT;
+        v.z = nextUnit(state) * 1000.0f - 500.0f;
+        v.nx = 0.0f;
+        v.ny = 0.0f;
+        v.nz = 1.0f;
+
+        float brightness = 0.3f + nextUnit(state) * 0.7f;
+        float warmth = 0.1f + (i % 10) * 0.05f;
+        v.r = brightness + warmth;
+        v.g = brightness + warmth * 0.8f;
+        v.b = brightness + warmth * 0.6f;
+        v.a = 1.0f;
+    }
+    tile.index = index;
+    tile.valid = true;
+}
+
+static StarTile& fetchTile(StarField& field, int index) {
+    StarTile* victim = 0;
+    for (int i = 0; i < STAR_TILE_CACHE; i++) {
+        StarTile& tile = field.tiles[i];
+        if (tile.valid && tile.index == index) {
+            field.hits++;
+            tile.lastUsed = field.frame;
+            return tile;
+        }
+        // Empty slots first, then the least recently used band
+        if (!victim || (victim->valid && (!tile.valid || tile.lastUsed < victim->lastUsed))) victim = &tile;
+    }
+
+    if (victim->valid) field.evicted++;
+    field.generated++;
+    generateTile(*victim, index);
+    victim->lastUsed = field.frame;
+    return *victim;
+}
+
+int gatherStarTiles(StarField& field, float minY, float maxY, const StarTile* out[STAR_TILE_CACHE]) {
+    // Start at 1 so lastUsed 0 always means older than this frame
+    field.frame++;
+    int first = (int)std::floor(minY / STAR_TILE_HEIGHT);
+    int last = (int)std::floor(maxY / STAR_TILE_HEIGHT);
+    if (last - first >= STAR_TILE_CACHE) last = first + STAR_TILE_CACHE - 1;
+
+    int count = 0;
+    for (int index = first; index <= last; index++) out[count++] = &fetchTile(field, index);
+    return count;
+}
+
+void reportStarFieldStats(const StarField& field) {
+    if (field.frame == 0) return;
+    std::cerr << "starfield: " << field.generated << " bands generated (" << field.evicted << " evicted), "
+              << field.hits << " cache hits over " << field.frame << " frames" << std::endl;
+}
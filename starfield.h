@@ -0,0 +1,50 @@
+#ifndef STARFIELD_H
+#define STARFIELD_H
+
+#include "renderer.h"
+
+// Endless background starfield. The sky is cut into horizontal bands of
+// STAR_TILE_HEIGHT units; each band's stars come from a hash of its index,
+// so a band looks the same every time it is generated and the density is
+// the same at any height. Bands are generated when they come into view and
+// kept in a fixed LRU cache, so memory stays bounded however far the prince
+// climbs and nothing is allocated after startup.
+
+const float STAR_TILE_HEIGHT = 500.0f;
+const int STARS_PER_TILE = 25;        // the old 200 stars over 4000 units
+const int STAR_TILE_CACHE = 8;
+
+struct StarTile {
+    int index;                        // band covering [index, index + 1) * STAR_TILE_HEIGHT
+    bool valid;
+    unsigned lastUsed;                // StarField::frame when last gathered
+    MeshVertex vertices[STARS_PER_TILE];   // points with their untwinkled colour
+};
+
+struct StarField {
+    StarTile tiles[STAR_TILE_CACHE];
+    unsigned frame;
+
+    unsigned long long hits;          // bands found in the cache
+    unsigned long long generated;     // bands built, evictions included
+    unsigned long long evicted;
+
+    StarField() : frame(0), hits(0), generated(0), evicted(0) {
+        for (int i = 0; i < STAR_TILE_CACHE; i++) {
+            tiles[i].index = 0;
+            tiles[i].valid = false;
+            tiles[i].lastUsed = 0;
+        }
+    }
+};
+
+// Bring every band overlapping [minY, maxY] into the cache, evicting the
+// least recently used ones, and list them in out bottom to top. At most
+// STAR_TILE_CACHE bands are returned; the pointers stay valid until the
+// next call.
+int gatherStarTiles(StarField& field, float minY, float maxY, const StarTile* out[STAR_TILE_CACHE]);
+
+// Cache hits and generated bands so far, to stderr
+void reportStarFieldStats(const StarField& field);
+
+#endif
@@ -0,0 +1,187 @@
+#include "telemetry.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+const size_t TELEMETRY_RING_SIZE = 16384;     // power of two
+const int TELEMETRY_FIELDS = 4;
+
+// Single producer (game thread), single consumer (writer thread)
+struct TelemetryRing {
+    TelemetryEvent events[TELEMETRY_RING_SIZE];
+    std::atomic<size_t> head;                 // next slot to write, owned by the producer
+    std::atomic<size_t> tail;                 // next slot to read, owned by the consumer
+
+    TelemetryRing() : head(0), tail(0) {}
+};
+
+static TelemetryRing ring;
+static FILE* output = 0;
+static std::thread writer;
+static std::atomic<bool> stopping(false);
+static unsigned long long dropped = 0;
+static unsigned long long written = 0;
+
+static void putVarint(std::vector<unsigned char>& out, unsigned value) {
+    while (value >= 0x80) {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+static unsigned zigzag(int v) {
+    return ((unsigned)v << 1) ^ (unsigned)(v >> 31);
+}
+
+static int fieldCount(int type) {
+    switch (type) {
+        case TELEMETRY_LANDING: return 4;
+        case TELEMETRY_LEVEL_COMPLETE: return 2;
+        default: return 1;
+    }
+}
+
+static void encodeEvent(std::vector<unsigned char>& out, const TelemetryEvent& e, unsigned& lastTick) {
+    out.push_back(e.type);
+    putVarint(out, e.player);
+    putVarint(out, zigzag((int)(e.tick - lastTick)));
+    lastTick = e.tick;
+
+    const int fields[TELEMETRY_FIELDS] = {e.a, e.b, e.c, e.d};
+    for (int i = 0; i < fieldCount(e.type); i++) {
+        putVarint(out, zigzag(fields[i]));
+    }
+}
+
+// Drain whatever is in the ring, write it in one call, then nap briefly
+// when there was nothing to do
+static void writerLoop() {
+    std::vector<unsigned char> buffer;
+    buffer.reserve(64 * 1024);
+    unsigned lastTick = 0;
+
+    for (;;) {
+        bool finishing = stopping.load(std::memory_order_acquire);
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        size_t head = ring.head.load(std::memory_order_acquire);
+
+        buffer.clear();
+        while (tail != head) {
+            encodeEvent(buffer, ring.events[tail & (TELEMETRY_RING_SIZE - 1)], lastTick);
+            tail++;
+            written++;
+        }
+        ring.tail.store(tail, std::memory_order_release);
+
+        if (!buffer.empty()) {
+            fwrite(&buffer[0], 1, buffer.size(), output);
+        } else if (finishing) {
+            break;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    fflush(output);
+}
+
+bool telemetryStart(const char* path) {
+    if (output) return true;
+    output = fopen(path, "wb");
+    if (!output) return false;
+
+    fwrite(TELEMETRY_MAGIC, 1, sizeof(TELEMETRY_MAGIC), output);
+    fputc(TELEMETRY_VERSION, output);
+    stopping.store(false);
+    writer = std::thread(writerLoop);
+    return true;
+}
+
+bool telemetryEnabled() {
+    return output != 0;
+}
+
+void telemetryEvent(int type, int player, unsigned tick, int a, int b, int c, int d) {
+    if (!output) return;
+
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == TELEMETRY_RING_SIZE) {
+        dropped++;
+        return;
+    }
+
+    TelemetryEvent& e = ring.events[head & (TELEMETRY_RING_SIZE - 1)];
+    e.type = (unsigned char)type;
+    e.player = (unsigned short)player;
+    e.tick = tick;
+    e.a = a;
+    e.b = b;
+    e.c = c;
+    e.d = d;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void telemetryStop() {
+    if (!output) return;
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+    fclose(output);
+    output = 0;
+}
+
+unsigned long long telemetryDropped() {
+    return dropped;
+}
+
+unsigned long long telemetryWritten() {
+    return written;
+}
+
+static bool getVarint(FILE* file, unsigned& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int b = fgetc(file);
+        if (b == EOF) return false;
+        value |= (unsigned)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static int unzigzag(unsigned v) {
+    return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+bool telemetryReadHeader(FILE* file) {
+    char magic[4];
+    if (fread(magic, 1, 4, file) != 4) return false;
+    for (int i = 0; i < 4; i++) {
+        if (magic[i] != TELEMETRY_MAGIC[i]) return false;
+    }
+    return fgetc(file) == TELEMETRY_VERSION;
+}
+
+bool telemetryReadEvent(FILE* file, TelemetryEvent& event, unsigned& lastTick) {
+    int type = fgetc(file);
+    if (type == EOF || type <= 0 || type >= TELEMETRY_EVENT_TYPES) return false;
+
+    unsigned player, tickDelta;
+    if (!getVarint(file, player) || !getVarint(file, tickDelta)) return false;
+    event.type = (unsigned char)type;
+    event.player = (unsigned short)player;
+    event.tick = lastTick + unzigzag(tickDelta);
+    lastTick = event.tick;
+
+    int fields[TELEMETRY_FIELDS] = {0, 0, 0, 0};
+    for (int i = 0; i < fieldCount(type); i++) {
+        unsigned v;
+        if (!getVarint(file, v)) return false;
+        fields[i] = unzigzag(v);
+    }
+    event.a = fields[0];
+    event.b = fields[1];
+    event.c = fields[2];
+    event.d = fields[3];
+    return true;
+}
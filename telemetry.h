@@ -0,0 +1,51 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstdio>
+
+// Gameplay telemetry. The game thread pushes fixed-size events into a
+// lock-free single-producer ring; a writer thread drains it, encodes the
+// events compactly and owns all file I/O. A full ring drops events (and
+// counts them) rather than ever making the game wait.
+
+enum TelemetryEventType {
+    TELEMETRY_LANDING = 1,        // a: planet index, b: planets jumped, c: combo, d: points
+    TELEMETRY_EXPLORATION_BONUS,  // a: bonus points
+    TELEMETRY_LEVEL_COMPLETE,     // a: chapter completed, b: bonus points
+    TELEMETRY_GAME_OVER,          // a: GameOverCause
+    TELEMETRY_FRAME,              // a: frame time in microseconds
+    TELEMETRY_EVENT_TYPES
+};
+
+enum GameOverCause {
+    GAME_OVER_DRIFTED = 0,        // too long without landing
+    GAME_OVER_FELL,               // fell below the camera
+    GAME_OVER_SUNK,               // standing on a planet that scrolled out of view
+    GAME_OVER_CAUSES
+};
+
+struct TelemetryEvent {
+    unsigned char type;
+    unsigned short player;
+    unsigned tick;
+    int a, b, c, d;
+};
+
+// File layout: "PPTL", a version byte, then per event a type byte, the
+// player and tick delta as varints and the type's fields as zigzag varints
+const char TELEMETRY_MAGIC[4] = {'P', 'P', 'T', 'L'};
+const unsigned char TELEMETRY_VERSION = 1;
+
+bool telemetryStart(const char* path);
+bool telemetryEnabled();
+void telemetryEvent(int type, int player, unsigned tick, int a = 0, int b = 0, int c = 0, int d = 0);
+void telemetryStop();                 // drains the ring and joins the writer
+unsigned long long telemetryDropped();
+unsigned long long telemetryWritten();
+
+// Reading, for the offline tools. Returns false at end of file or on a
+// damaged stream.
+bool telemetryReadHeader(FILE* file);
+bool telemetryReadEvent(FILE* file, TelemetryEvent& event, unsigned& lastTick);
+
+#endif
@@ -0,0 +1,100 @@
+// Summarize one or more telemetry files written with --telemetry=<file>
+//
+//   g++ -std=c++14 -O2 -I.. telemetry_summary.cpp ../telemetry.cpp -o telemetry_summary -pthread
+//   ./telemetry_summary session1.bin session2.bin ...
+
+#include "telemetry.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const char* CAUSE_NAMES[GAME_OVER_CAUSES] = {"drifted into space", "fell behind", "planet sank"};
+static const int MAX_JUMP_BUCKET = 8;
+
+static double percentile(const std::vector<int>& sorted, int p) {
+    if (sorted.empty()) return 0;
+    return sorted[sorted.size() * p / 100] / 1000.0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <telemetry file>...\n", argv[0]);
+        return 1;
+    }
+
+    int sessions = 0;
+    int damaged = 0;
+    unsigned long long events = 0;
+    unsigned long long landings = 0;
+    unsigned long long jumpCounts[MAX_JUMP_BUCKET + 1] = {0};
+    unsigned long long landingPoints = 0;
+    int maxCombo = 0;
+    unsigned long long bonuses = 0;
+    unsigned long long levelsCompleted[16] = {0};
+    unsigned long long gameOvers[GAME_OVER_CAUSES] = {0};
+    std::vector<int> frameMicros;
+
+    for (int i = 1; i < argc; i++) {
+        FILE* file = fopen(argv[i], "rb");
+        if (!file || !telemetryReadHeader(file)) {
+            fprintf(stderr, "%s: not a telemetry file\n", argv[i]);
+            if (file) fclose(file);
+            damaged++;
+            continue;
+        }
+        sessions++;
+
+        TelemetryEvent e;
+        unsigned lastTick = 0;
+        while (telemetryReadEvent(file, e, lastTick)) {
+            events++;
+            switch (e.type) {
+                case TELEMETRY_LANDING:
+                    landings++;
+                    jumpCounts[std::min(e.b, MAX_JUMP_BUCKET)]++;
+                    landingPoints += e.d;
+                    maxCombo = std::max(maxCombo, e.c);
+                    break;
+                case TELEMETRY_EXPLORATION_BONUS:
+                    bonuses++;
+                    break;
+                case TELEMETRY_LEVEL_COMPLETE:
+                    if (e.a >= 0 && e.a < 16) levelsCompleted[e.a]++;
+                    break;
+                case TELEMETRY_GAME_OVER:
+                    if (e.a >= 0 && e.a < GAME_OVER_CAUSES) gameOvers[e.a]++;
+                    break;
+                case TELEMETRY_FRAME:
+                    frameMicros.push_back(e.a);
+                    break;
+            }
+        }
+        if (!feof(file)) damaged++;
+        fclose(file);
+    }
+
+    printf("%d sessions, %llu events", sessions, events);
+    if (damaged > 0) printf(" (%d files unreadable or truncated)", damaged);
+    printf("\n\nlandings: %llu, %llu points, best combo x%d\n", landings, landingPoints, maxCombo);
+    for (int j = 1; j <= MAX_JUMP_BUCKET; j++) {
+        if (jumpCounts[j] == 0) continue;
+        printf("  %s%d planets jumped: %llu (%.1f%%)\n", j == MAX_JUMP_BUCKET ? ">=" : "", j, jumpCounts[j],
+               100.0 * jumpCounts[j] / landings);
+    }
+    printf("exploration bonuses: %llu\n", bonuses);
+    for (int l = 1; l < 16; l++) {
+        if (levelsCompleted[l] > 0) printf("chapter %d completed: %llu\n", l, levelsCompleted[l]);
+    }
+    printf("game overs:\n");
+    for (int c = 0; c < GAME_OVER_CAUSES; c++) {
+        printf("  %s: %llu\n", CAUSE_NAMES[c], gameOvers[c]);
+    }
+
+    if (!frameMicros.empty()) {
+        std::sort(frameMicros.begin(), frameMicros.end());
+        printf("frames: %zu, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n", frameMicros.size(),
+               percentile(frameMicros, 50), percentile(frameMicros, 95), percentile(frameMicros, 99),
+               frameMicros.back() / 1000.0);
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "transform.h"
+
+void clearTransforms(TransformTree& tree) {
+    tree.nodes.clear();
+}
+
+int addTransform(TransformTree& tree, int parent, const Mat4& local) {
+    TransformNode node;
+    node.parent = parent;
+    node.local = local;
+    node.world = local;
+    node.version = 0;
+    node.parentVersion = 0;
+    node.dirty = true;
+    tree.nodes.push_back(node);
+    return (int)tree.nodes.size() - 1;
+}
+
+void setTransform(TransformTree& tree, int node, const Mat4& local) {
+    TransformNode& n = tree.nodes[node];
+    n.local = local;
+    n.dirty = true;
+}
+
+void updateTransforms(TransformTree& tree, int first, int count) {
+    TransformNode* nodes = &tree.nodes[0];
+    for (int i = first; i < first + count; i++) {
+        TransformNode& n = nodes[i];
+        if (n.parent < 0) {
+            if (!n.dirty) {
+                tree.reuses++;
+                continue;
+            }
+            n.world = n.local;
+        } else {
+            const TransformNode& parent = nodes[n.parent];
+            if (!n.dirty && n.parentVersion == parent.version) {
+                tree.reuses++;
+                continue;
+            }
+            n.world = mat4Multiply(parent.world, n.local);
+            n.parentVersion = parent.version;
+        }
+        n.dirty = false;
+        n.version++;
+        tree.evaluations++;
+    }
+}
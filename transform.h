@@ -0,0 +1,39 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "renderer.h"
+#include <vector>
+
+// CPU-side transform hierarchy with cached world matrices. Nodes are stored
+// parents first, so one forward pass over a range brings it up to date; a
+// node is only re-evaluated when its local matrix was set or its parent's
+// world matrix changed since it was last computed.
+
+struct TransformNode {
+    int parent;               // -1 for roots
+    Mat4 local;
+    Mat4 world;
+    unsigned version;         // bumped every time world is recomputed
+    unsigned parentVersion;   // parent's version when world was computed
+    bool dirty;               // local changed since world was computed
+};
+
+struct TransformTree {
+    std::vector<TransformNode> nodes;
+    unsigned long long evaluations;   // world matrices recomputed
+    unsigned long long reuses;        // world matrices found up to date
+
+    TransformTree() : evaluations(0), reuses(0) {}
+};
+
+void clearTransforms(TransformTree& tree);
+
+// Parent must already be in the tree. Returns the new node's index.
+int addTransform(TransformTree& tree, int parent, const Mat4& local);
+void setTransform(TransformTree& tree, int node, const Mat4& local);
+
+// Refresh world matrices of nodes first..first+count-1. Parents outside the
+// range must already be up to date.
+void updateTransforms(TransformTree& tree, int first, int count);
+
+#endif
@@ -0,0 +1,61 @@
+#include "worker.h"
+
+static void workerLoop(BackgroundWorker* worker) {
+    for (;;) {
+        void (*job)(void*);
+        void* arg;
+        {
+            std::unique_lock<std::mutex> lock(worker->mutex);
+            while (!worker->job && !worker->stopping) worker->wake.wait(lock);
+            if (!worker->job) return;
+            job = worker->job;
+            arg = worker->arg;
+        }
+
+        job(arg);
+
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->job = 0;
+            worker->busy.store(false, std::memory_order_release);
+        }
+        worker->wake.notify_all();
+    }
+}
+
+void startWorker(BackgroundWorker& worker) {
+    if (worker.thread.joinable()) return;
+    worker.stopping = false;
+    worker.thread = std::thread(workerLoop, &worker);
+}
+
+bool submitJob(BackgroundWorker& worker, void (*job)(void*), void* arg) {
+    if (worker.busy.load(std::memory_order_acquire)) return false;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.job = job;
+        worker.arg = arg;
+        worker.busy.store(true, std::memory_order_relaxed);
+    }
+    worker.wake.notify_all();
+    return true;
+}
+
+bool workerIdle(const BackgroundWorker& worker) {
+    return !worker.busy.load(std::memory_order_acquire);
+}
+
+void waitForWorker(BackgroundWorker& worker) {
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    while (worker.busy.load(std::memory_order_relaxed)) worker.wake.wait(lock);
+}
+
+void stopWorker(BackgroundWorker& worker) {
+    if (!worker.thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.stopping = true;
+    }
+    worker.wake.notify_all();
+    worker.thread.join();
+}
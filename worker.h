@@ -0,0 +1,35 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// One background thread that runs one job at a time. The game thread hands
+// a job over and later polls whether it is done; everything the job wrote
+// is visible to the game thread once workerIdle() has returned true.
+// Handing over and finishing a job never allocates.
+struct BackgroundWorker {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    void (*job)(void* arg);
+    void* arg;
+    bool stopping;
+    std::atomic<bool> busy;          // set when a job is handed over, cleared when it is done
+
+    BackgroundWorker() : job(0), arg(0), stopping(false), busy(false) {}
+};
+
+void startWorker(BackgroundWorker& worker);
+
+// Returns false (and does nothing) while the previous job is still running
+bool submitJob(BackgroundWorker& worker, void (*job)(void* arg), void* arg);
+bool workerIdle(const BackgroundWorker& worker);
+void waitForWorker(BackgroundWorker& worker);
+
+// Finishes the current job, then joins the thread
+void stopWorker(BackgroundWorker& worker);
+
+#endif